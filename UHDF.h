@@ -6,5 +6,13 @@
 #include "UHDF_Dataset.h"
 #include "UHDF_Group.h"
 #include "UHDF_File.h"
+#include "UHDF_Shared.h"
+#include "UHDF_Stream.h"
+#include "UHDF_ProcessPool.h"
+#include "UHDF_DatasetCollection.h"
+#include "UHDF_ReadPlan.h"
+#include "UHDF_TypedDataset.h"
+#include "UHDF_ChunkWriter.h"
+#include "UHDF_Catalog.h"
 
 #endif
@@ -4,10 +4,12 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <utility>
 #include <iostream>
 
 #include "UHDF_Types.h"
 #include "UHDF_H5Holder.h"
+#include "UHDF_Convert.h"
 
 class UHDF_Attribute
 {
@@ -30,6 +32,33 @@ public:
         }
     }
 
+    // movable but not copyable, like UHDF_Dataset
+    UHDF_Attribute( UHDF_Attribute &&other) noexcept :
+        UHDF_Attribute()
+    {
+        swap(other);
+    }
+
+    UHDF_Attribute &operator=( UHDF_Attribute &&other) noexcept
+    {
+        UHDF_Attribute moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    UHDF_Attribute( const UHDF_Attribute &) = delete;
+    UHDF_Attribute &operator=( const UHDF_Attribute &) = delete;
+
+    void swap( UHDF_Attribute &other) noexcept
+    {
+        std::swap(fileType, other.fileType);
+        std::swap(owner, other.owner);
+        std::swap(id, other.id);
+        std::swap(attributename, other.attributename);
+        std::swap(datatype, other.datatype);
+        std::swap(numElements, other.numElements);
+    }
+
     const std::string &getName() const
     {
         return attributename;
@@ -63,81 +92,74 @@ public:
         std::vector<T> data;
         data.resize(numElements);
 
-        switch(fileType)
+        if (fileType == UHDF_HDF5 && datatype == UHDF_REFERENCE)
         {
-        case UHDF_HDF4:
+            data.clear();
+            return data;
+        }
+
+        if (fileType == UHDF_HDF5 && datatype == UHDF_STRING)
         {
-            T *buffer = data.data();
+            UHDF_TypeHolder type(H5Tcopy(H5T_C_S1));
 
-            const UHDF_DataType outputType = getUHDFType<T>();
-            if (datatype != outputType)
-            {  // conversion needed
-                if (SDreadattr(owner.h4id, id.h4id, buffer) < 0)
-                    throw UHDF_Exception("Error reading attribute '" + attributename + "'");
-            }
-            else
-            {  // need to convert from the field's type to the return type
-                switch(datatype)
-                {
-                case UHDF_UINT8:
-                    convertH4<uint8, T>(buffer);
-                    break;
-                case UHDF_INT8:
-                    convertH4<int8, T>(buffer);
-                    break;
-                case UHDF_UINT16:
-                    convertH4<uint16, T>(buffer);
-                    break;
-                case UHDF_INT16:
-                    convertH4<int16, T>(buffer);
-                    break;
-                case UHDF_UINT32:
-                    convertH4<uint32, T>(buffer);
-                    break;
-                case UHDF_INT32:
-                    convertH4<int32, T>(buffer);
-                    break;
-                case UHDF_FLOAT32:
-                    convertH4<float, T>(buffer);
-                    break;
-                case UHDF_FLOAT64:
-                    convertH4<double, T>(buffer);
-                    break;
-                default:
-                    throw UHDF_Exception("Unsupported datatype when doing conversion in read of dataset '" + attributename + "'");
-                }
-            }
-            break;
+            data.resize(numElements + 1);
+            if (H5Tset_size(type.get(), numElements + 1) < 0)
+                throw UHDF_Exception("Error setting type size when reading string attribute '" + attributename + "'");
+            if (H5Tset_strpad(type.get(), H5T_STR_NULLTERM) < 0)
+                throw UHDF_Exception("Error setting padding when reading string attribute '" + attributename + "'");
+            if (H5Tset_cset(type.get(), H5T_CSET_ASCII) < 0)
+                throw UHDF_Exception("Error setting ASCII encoding when reading string attribute '" + attributename + "'");
+
+            if (H5Aread(id.h5id, type.get(), data.data()) < 0)
+                throw UHDF_Exception("Error reading string attribute '" + attributename + "'");
+
+            return data;
         }
 
-        case UHDF_HDF5:
+        T *buffer = data.data();
+
+        const UHDF_DataType outputType = getUHDFType<T>();
+        if (datatype == outputType)
+        {  // no conversion needed
+            rawRead(buffer);
+            return data;
+        }
+
+        // need to convert from the field's type to the return type
+        switch(datatype)
         {
-            if (datatype == UHDF_REFERENCE)
-            {
-                data.clear();
-            }
-            else if (datatype == UHDF_STRING)
-            {
-                UHDF_TypeHolder type(H5Tcopy(H5T_C_S1));
-
-                data.resize(numElements + 1);
-                if (H5Tset_size(type.get(), numElements + 1) < 0)
-                    throw UHDF_Exception("Error setting type size when reading string attribute '" + attributename + "'");
-                if (H5Tset_strpad(type.get(), H5T_STR_NULLTERM) < 0)
-                    throw UHDF_Exception("Error setting padding when reading string attribute '" + attributename + "'");
-                if (H5Tset_cset(type.get(), H5T_CSET_ASCII) < 0)
-                    throw UHDF_Exception("Error setting ASCII encoding when reading string attribute '" + attributename + "'");
-
-                if (H5Aread(id.h5id, type.get(), data.data()) < 0)
-                    throw UHDF_Exception("Error reading string attribute '" + attributename + "'");
-            }
-            else
-            {
-                if (H5Aread(id.h5id, getH5Type<T>(), data.data()) < 0)
-                    throw UHDF_Exception("Error reading attribute '" + attributename + "'");
-            }
+        case UHDF_UINT8:
+            readConverted<uint8_t, T>(buffer);
             break;
-        }
+        case UHDF_INT8:
+            readConverted<int8_t, T>(buffer);
+            break;
+        case UHDF_UINT16:
+            readConverted<uint16_t, T>(buffer);
+            break;
+        case UHDF_INT16:
+            readConverted<int16_t, T>(buffer);
+            break;
+        case UHDF_UINT32:
+            readConverted<uint32_t, T>(buffer);
+            break;
+        case UHDF_INT32:
+            readConverted<int32_t, T>(buffer);
+            break;
+        case UHDF_UINT64:
+            readConverted<uint64_t, T>(buffer);
+            break;
+        case UHDF_INT64:
+            readConverted<int64_t, T>(buffer);
+            break;
+        case UHDF_FLOAT32:
+            readConverted<float, T>(buffer);
+            break;
+        case UHDF_FLOAT64:
+            readConverted<double, T>(buffer);
+            break;
+        default:
+            throw UHDF_Exception("Unsupported datatype when doing conversion in read of attribute '" + attributename + "'");
         }
 
         return data;
@@ -151,14 +173,26 @@ private:
     UHDF_DataType datatype;
     int numElements;
 
+    // an empty handle, for moving into
+    UHDF_Attribute() :
+        fileType (UHDF_HDF5),
+        datatype (UHDF_UNKNOWN),
+        numElements (0)
+    {
+        owner.h5id = -1;
+        id.h5id = -1;
+    }
+
+    // creates the attribute on ownerId, which must not already have one by that name; for
+    // strings (T = char), numElements is the length of the string
     template <typename T>
-    UHDF_Attribute (UDHF_FileType format, UHDF_Identifier ownerId, const std::string &attributeName, const size_t numElements, const T *const dataBuffer)
+    UHDF_Attribute (UHDF_FileType format, UHDF_Identifier ownerId, const std::string &attributeName, const size_t attributeElements, const T *const dataBuffer)
     {
         T dummy = 0;
-        T* buffer = dataBuffer;
+        const T* buffer = dataBuffer;
 
         // if 0-element attribute, create a fake 1st element to avoid an HDF4 bug
-        size_t numElems = numElements;
+        size_t numElems = attributeElements;
         if (numElems == 0)
         {
             numElems = 1;
@@ -174,7 +208,7 @@ private:
         switch (fileType)
         {
         case UHDF_HDF4:
-            if (SDsetattr(owner.h4id, attributename.c_str(), UHDFTypeToH4(datatype), numElems, buffer) < 0)
+            if (SDsetattr(owner.h4id, attributename.c_str(), UHDFTypeToH4(datatype), numElems, const_cast<T*>(buffer)) < 0)
                 throw UHDF_Exception("Error creating attribute '" + attributename + "'");
 
             id.h4id = SDfindattr(owner.h4id, attributename.c_str());
@@ -191,7 +225,7 @@ private:
             if (isString())
             {
                 // string attribute: space is 1, type is numElems-length string
-                if (H5Tset_size(type.get(), numElements) < 0)
+                if (H5Tset_size(type.get(), numElems) < 0)
                     throw UHDF_Exception("Error setting size of attribute '" + attributename + "'");
 
                 const hsize_t spaceElems = 1;
@@ -199,12 +233,13 @@ private:
             }
             else
             {
+                const hsize_t elems = numElems;
                 space.reset(new UHDF_SpaceHolder(H5Screate_simple(1, &elems, NULL)));
             }
 
-            id.h5id = H5Acreate2(ownerId.h5id, attributename.c_str(), type.get(), space.get(), H5P_DEFAULT, H5P_DEFAULT);
+            id.h5id = H5Acreate2(ownerId.h5id, attributename.c_str(), type.get(), space->get(), H5P_DEFAULT, H5P_DEFAULT);
             if (id.h5id < 0)
-                throw UHDF_Exeception("Error creating attribute '" + attributename + "'");
+                throw UHDF_Exception("Error creating attribute '" + attributename + "'");
 
             if (H5Awrite(id.h5id, type.get(), buffer) < 0)
                 throw UHDF_Exception("Error writing data to newly-created attribute '" + attributename + "'");
@@ -216,7 +251,7 @@ private:
 
     UHDF_Attribute (UHDF_FileType format, UHDF_Identifier ownerId, const std::string &attributeName)
     {
-        fileType = type;
+        fileType = format;
         attributename = attributeName;
         owner = ownerId;
 
@@ -266,16 +301,30 @@ private:
         }
     }
 
-    template<typename FILE_T, typename MEM_T>
-    void convertH4 (MEM_T* buffer) const
+    // reads every element in the attribute's own type
+    void rawRead( void *buffer) const
     {
-        std::unique_ptr<FILE_T[]> unconverted(new FILE_T[numElements]);
-
-        if (SDreadattr(owner.h4id, id.h4id, unconverted.get()) < 0)
-            throw UHDF_Exception("Error reading attribute '" + attributename + "'");
+        switch(fileType)
+        {
+        case UHDF_HDF4:
+            if (SDreadattr(owner.h4id, id.h4id, buffer) < 0)
+                throw UHDF_Exception("Error reading attribute '" + attributename + "'");
+            break;
+        case UHDF_HDF5:
+            if (H5Aread(id.h5id, UHDFTypeToH5(datatype), buffer) < 0)
+                throw UHDF_Exception("Error reading attribute '" + attributename + "'");
+            break;
+        }
+    }
 
-        for (size_t i = 0; i < numElements; i++)
-            buffer[i] = static_cast<MEM_T>(unconverted[i]);
+    template<typename FILE_T, typename MEM_T>
+    void readConverted (MEM_T* buffer) const
+    {
+        UHDF_readConverted<FILE_T, MEM_T>(numElements, buffer,
+            [this](void *rawBuffer)
+            {
+                rawRead(rawBuffer);
+            });
     }
 };
 
@@ -0,0 +1,448 @@
+#ifndef UHDF_ATTRIBUTEMAP_H
+#define UHDF_ATTRIBUTEMAP_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <utility>
+#include <exception>
+#include <cstring>
+
+#include "UHDF_Types.h"
+#include "UHDF_H5Holder.h"
+#include "UHDF_Convert.h"
+
+#include <boost/lexical_cast.hpp>
+
+// An attribute's type and value, read in full.  Numeric values are kept in the attribute's
+// own type and converted on request; string attributes hold one string per element.
+class UHDF_AttributeValue
+{
+public:
+    UHDF_AttributeValue() :
+        datatype (UHDF_UNKNOWN),
+        numElements (0)
+    {}
+
+    // numeric values, numValues of type valueType packed in rawValues
+    UHDF_AttributeValue( const UHDF_DataType valueType, const size_t numValues, std::vector<char> &&rawValues) :
+        datatype (valueType),
+        numElements (numValues),
+        bytes (std::move(rawValues))
+    {}
+
+    explicit UHDF_AttributeValue( std::vector<std::string> &&values) :
+        datatype (UHDF_STRING),
+        numElements (values.size()),
+        strings (std::move(values))
+    {}
+
+    UHDF_DataType getType() const
+    {
+        return datatype;
+    }
+
+    // number of values, or of strings for string attributes
+    size_t getNumElements() const
+    {
+        return numElements;
+    }
+
+    bool isString() const
+    {
+        return datatype == UHDF_STRING;
+    }
+
+    // raw values in the attribute's own type
+    const void *data() const
+    {
+        return bytes.data();
+    }
+
+    // the first string of a string attribute
+    std::string asString() const
+    {
+        if (!isString())
+            throw UHDF_Exception("Attribute of type " + UHDFTypeName(datatype) + " isn't a string");
+
+        return strings.empty() ? std::string() : strings.front();
+    }
+
+    const std::vector<std::string> &asStrings() const
+    {
+        if (!isString())
+            throw UHDF_Exception("Attribute of type " + UHDFTypeName(datatype) + " isn't a string");
+
+        return strings;
+    }
+
+    // numeric values converted to T, saturating where T can't hold them
+    template<typename T>
+    std::vector<T> as() const
+    {
+        std::vector<T> values(numElements);
+        if (numElements == 0)
+            return values;
+
+        T *out = values.data();
+
+        if (datatype == getUHDFType<T>())
+        {
+            memcpy(out, bytes.data(), numElements * sizeof(T));
+            return values;
+        }
+
+        switch(datatype)
+        {
+        case UHDF_UINT8:
+            UHDF_convert(reinterpret_cast<const uint8_t*>(bytes.data()), out, numElements);
+            break;
+        case UHDF_INT8:
+            UHDF_convert(reinterpret_cast<const int8_t*>(bytes.data()), out, numElements);
+            break;
+        case UHDF_UINT16:
+            UHDF_convert(reinterpret_cast<const uint16_t*>(bytes.data()), out, numElements);
+            break;
+        case UHDF_INT16:
+            UHDF_convert(reinterpret_cast<const int16_t*>(bytes.data()), out, numElements);
+            break;
+        case UHDF_UINT32:
+            UHDF_convert(reinterpret_cast<const uint32_t*>(bytes.data()), out, numElements);
+            break;
+        case UHDF_INT32:
+            UHDF_convert(reinterpret_cast<const int32_t*>(bytes.data()), out, numElements);
+            break;
+        case UHDF_UINT64:
+            UHDF_convert(reinterpret_cast<const uint64_t*>(bytes.data()), out, numElements);
+            break;
+        case UHDF_INT64:
+            UHDF_convert(reinterpret_cast<const int64_t*>(bytes.data()), out, numElements);
+            break;
+        case UHDF_FLOAT32:
+            UHDF_convert(reinterpret_cast<const float*>(bytes.data()), out, numElements);
+            break;
+        case UHDF_FLOAT64:
+            UHDF_convert(reinterpret_cast<const double*>(bytes.data()), out, numElements);
+            break;
+        default:
+            throw UHDF_Exception("Can't convert attribute of type " + UHDFTypeName(datatype) + " to " + UHDFTypeName(getUHDFType<T>()));
+        }
+
+        return values;
+    }
+
+    // the first value, converted to T
+    template<typename T>
+    T asScalar() const
+    {
+        if (numElements == 0 || isString())
+            throw UHDF_Exception("Attribute has no numeric value");
+
+        return as<T>().front();
+    }
+
+private:
+    UHDF_DataType datatype;
+    size_t numElements;
+    std::vector<char> bytes;
+    std::vector<std::string> strings;
+};
+
+// Every attribute of an object by name, stored as one sorted array.
+class UHDF_AttributeMap
+{
+public:
+    typedef std::pair<std::string, UHDF_AttributeValue> Entry;
+    typedef std::vector<Entry>::const_iterator const_iterator;
+
+    UHDF_AttributeMap()
+    {}
+
+    explicit UHDF_AttributeMap( std::vector<Entry> &&attributes) :
+        entries (std::move(attributes))
+    {
+        std::stable_sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b)
+            {
+                return a.first < b.first;
+            });
+    }
+
+    // NULL if there's no attribute with that name
+    const UHDF_AttributeValue *find( const std::string &name) const
+    {
+        const auto iter = std::lower_bound(entries.begin(), entries.end(), name,
+            [](const Entry &entry, const std::string &key)
+            {
+                return entry.first < key;
+            });
+
+        if (iter == entries.end() || iter->first != name)
+            return NULL;
+        return &iter->second;
+    }
+
+    const UHDF_AttributeValue &at( const std::string &name) const
+    {
+        const UHDF_AttributeValue *value = find(name);
+        if (value == NULL)
+            throw UHDF_Exception("No attribute named '" + name + "'");
+        return *value;
+    }
+
+    bool contains( const std::string &name) const
+    {
+        return find(name) != NULL;
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    bool empty() const
+    {
+        return entries.empty();
+    }
+
+    const_iterator begin() const
+    {
+        return entries.begin();
+    }
+
+    const_iterator end() const
+    {
+        return entries.end();
+    }
+
+private:
+    std::vector<Entry> entries;
+};
+
+// Attributes read by readAllAttributes, loaded on first use.  Handles on the same open
+// object share one cache.
+class UHDF_AttributeCache
+{
+public:
+    UHDF_AttributeCache() :
+        loaded (false)
+    {}
+
+    template<typename LOAD>
+    const UHDF_AttributeMap &get( LOAD load)
+    {
+        if (!loaded)
+        {
+            attributes = load();
+            loaded = true;
+        }
+        return attributes;
+    }
+
+    void clear()
+    {
+        attributes = UHDF_AttributeMap();
+        loaded = false;
+    }
+
+private:
+    UHDF_AttributeMap attributes;
+    bool loaded;
+};
+
+//--------------------------------
+// HDF5
+
+static inline UHDF_AttributeValue UHDF_readH5AttributeValue( const hid_t ownerId, const char *name)
+{
+    const UHDF_AttrHolder attr(H5Aopen(ownerId, name, H5P_DEFAULT));
+    const UHDF_SpaceHolder space(H5Aget_space(attr.get()));
+    const UHDF_TypeHolder type(H5Aget_type(attr.get()));
+
+    const hssize_t numPoints = H5Sget_simple_extent_npoints(space.get());
+    if (numPoints < 0)
+        throw UHDF_Exception("Error getting number of elements in attribute '" + std::string(name) + "'");
+
+    UHDF_DataType datatype;
+    try
+    {
+        datatype = H5TypeToUHDF(type.get());
+    }
+    catch (const UHDF_Exception &)
+    {
+        // still listed, so the names are complete, but without a value
+        return UHDF_AttributeValue();
+    }
+
+    if (datatype == UHDF_REFERENCE)
+        return UHDF_AttributeValue(UHDF_REFERENCE, 0, std::vector<char>());
+
+    if (datatype == UHDF_STRING)
+    {
+        std::vector<std::string> strings;
+        strings.reserve(numPoints);
+
+        UHDF_TypeHolder memType(H5Tcopy(H5T_C_S1));
+        if (H5Tset_cset(memType.get(), H5Tget_cset(type.get())) < 0)
+            throw UHDF_Exception("Error setting encoding when reading string attribute '" + std::string(name) + "'");
+
+        if (H5Tis_variable_str(type.get()) > 0)
+        {
+            if (H5Tset_size(memType.get(), H5T_VARIABLE) < 0)
+                throw UHDF_Exception("Error setting type size when reading string attribute '" + std::string(name) + "'");
+
+            std::vector<char*> pointers(numPoints, NULL);
+            if (numPoints > 0 && H5Aread(attr.get(), memType.get(), pointers.data()) < 0)
+                throw UHDF_Exception("Error reading string attribute '" + std::string(name) + "'");
+
+            for (auto p : pointers)
+                strings.push_back(p == NULL ? std::string() : std::string(p));
+
+            if (numPoints > 0)
+            {
+#if H5_VERSION_GE(1,12,0)
+                H5Treclaim(memType.get(), space.get(), H5P_DEFAULT, pointers.data());
+#else
+                H5Dvlen_reclaim(memType.get(), space.get(), H5P_DEFAULT, pointers.data());
+#endif
+            }
+        }
+        else
+        {
+            // one extra byte per string, so a string filling its whole length still gets a terminator
+            const size_t length = H5Tget_size(type.get()) + 1;
+            if (H5Tset_size(memType.get(), length) < 0 || H5Tset_strpad(memType.get(), H5T_STR_NULLTERM) < 0)
+                throw UHDF_Exception("Error setting type size when reading string attribute '" + std::string(name) + "'");
+
+            std::vector<char> text(numPoints * length + 1, 0);
+            if (numPoints > 0 && H5Aread(attr.get(), memType.get(), text.data()) < 0)
+                throw UHDF_Exception("Error reading string attribute '" + std::string(name) + "'");
+
+            for (hssize_t i = 0; i < numPoints; i++)
+                strings.push_back(std::string(text.data() + i * length));
+        }
+
+        return UHDF_AttributeValue(std::move(strings));
+    }
+
+    std::vector<char> values(numPoints * UHDFTypeSize(datatype));
+    if (numPoints > 0 && H5Aread(attr.get(), UHDFTypeToH5(datatype), values.data()) < 0)
+        throw UHDF_Exception("Error reading attribute '" + std::string(name) + "'");
+
+    return UHDF_AttributeValue(datatype, numPoints, std::move(values));
+}
+
+struct UHDF_H5AttributeContext
+{
+    std::vector<UHDF_AttributeMap::Entry> entries;
+    std::list<std::string> names;
+    bool namesOnly;
+    std::exception_ptr error;
+};
+
+static inline herr_t UHDF_h5AttributeCallback( hid_t ownerId, const char *name, const H5A_info_t *, void *opData)
+{
+    UHDF_H5AttributeContext *context = static_cast<UHDF_H5AttributeContext*>(opData);
+
+    // exceptions can't pass through the library's C stack frames
+    try
+    {
+        if (context->namesOnly)
+            context->names.push_back(std::string(name));
+        else
+            context->entries.push_back(std::make_pair(std::string(name), UHDF_readH5AttributeValue(ownerId, name)));
+    }
+    catch (...)
+    {
+        context->error = std::current_exception();
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline void UHDF_iterateH5Attributes( const hid_t ownerId, const std::string &ownerName, UHDF_H5AttributeContext &context)
+{
+    hsize_t position = 0;
+    herr_t status;
+
+    H5E_BEGIN_TRY
+    {
+        status = H5Aiterate2(ownerId, H5_INDEX_NAME, H5_ITER_INC, &position, UHDF_h5AttributeCallback, &context);
+    }
+    H5E_END_TRY;
+
+    if (context.error)
+        std::rethrow_exception(context.error);
+    if (status < 0)
+        throw UHDF_Exception("Error iterating over attributes of '" + ownerName + "'");
+}
+
+// every attribute of an HDF5 object in one pass
+static inline UHDF_AttributeMap UHDF_readH5Attributes( const hid_t ownerId, const std::string &ownerName)
+{
+    UHDF_H5AttributeContext context;
+    context.namesOnly = false;
+
+    UHDF_iterateH5Attributes(ownerId, ownerName, context);
+    return UHDF_AttributeMap(std::move(context.entries));
+}
+
+static inline std::list<std::string> UHDF_listH5AttributeNames( const hid_t ownerId, const std::string &ownerName)
+{
+    UHDF_H5AttributeContext context;
+    context.namesOnly = true;
+
+    UHDF_iterateH5Attributes(ownerId, ownerName, context);
+    return context.names;
+}
+
+//--------------------------------
+// HDF4
+
+// every attribute of an SD file or dataset; ownerId is the SD interface or SDS id
+static inline UHDF_AttributeMap UHDF_readH4Attributes( const int32 ownerId, const int32 numAttributes, const std::string &ownerName)
+{
+    std::vector<UHDF_AttributeMap::Entry> entries;
+    entries.reserve(numAttributes);
+
+    for (int32 i = 0; i < numAttributes; i++)
+    {
+        char name[MAX_NC_NAME + 1];
+        int32 attType;
+        int32 attCount;
+
+        memset(name, 0, MAX_NC_NAME + 1);
+        if (SDattrinfo(ownerId, i, name, &attType, &attCount) < 0)
+            throw UHDF_Exception("Error getting info for attribute " + boost::lexical_cast<std::string>(i) + " of '" + ownerName + "'");
+
+        const UHDF_DataType datatype = UHDF_lookupH4Type(attType);
+        if (datatype == UHDF_UNKNOWN)
+        {
+            entries.push_back(std::make_pair(std::string(name), UHDF_AttributeValue()));
+            continue;
+        }
+
+        std::vector<char> values(attCount * UHDFTypeSize(datatype) + 1, 0);
+
+        if (attCount > 0 && SDreadattr(ownerId, i, values.data()) < 0)
+            throw UHDF_Exception("Error reading attribute '" + std::string(name) + "' of '" + ownerName + "'");
+
+        if (datatype == UHDF_STRING)
+        {
+            // character attributes are often stored with their terminator
+            std::vector<std::string> strings(1, std::string(values.data(), strnlen(values.data(), attCount)));
+            entries.push_back(std::make_pair(std::string(name), UHDF_AttributeValue(std::move(strings))));
+        }
+        else
+        {
+            values.pop_back();
+            entries.push_back(std::make_pair(std::string(name), UHDF_AttributeValue(datatype, attCount, std::move(values))));
+        }
+    }
+
+    return UHDF_AttributeMap(std::move(entries));
+}
+
+#endif // UHDF_ATTRIBUTEMAP_H
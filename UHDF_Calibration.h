@@ -0,0 +1,212 @@
+#ifndef UHDF_CALIBRATION_H
+#define UHDF_CALIBRATION_H
+
+#include <limits>
+#include <cmath>
+#include <cstddef>
+
+#include "UHDF_Types.h"
+#include "UHDF_Convert.h"
+
+// How stored values map to physical ones: physical = stored * scale + offset.  Stored values
+// equal to the fill value or outside [validMin, validMax] (both in stored units) have no
+// physical value and read as NaN.
+struct UHDF_Calibration
+{
+    UHDF_Calibration() :
+        scale (1),
+        offset (0),
+        hasFillValue (false),
+        fillValue (0),
+        validMin (-std::numeric_limits<double>::infinity()),
+        validMax (std::numeric_limits<double>::infinity())
+    {}
+
+    double scale;
+    double offset;
+    bool hasFillValue;
+    double fillValue;
+    double validMin;
+    double validMax;
+};
+
+// vector pass of the decoding kernel; returns the number of values decoded and the scalar
+// loop finishes the rest.  Types without a vector pass decode nothing here.
+template<typename FROM, typename TO>
+struct UHDF_SimdCalibrate
+{
+    static inline size_t run( const FROM *, TO *, const size_t,
+                              const FROM, const FROM, const bool, const FROM, const TO, const TO)
+    {
+        return 0;
+    }
+};
+
+#ifdef UHDF_HAVE_X86_SIMD
+
+// integers that widen exactly to 32 bits, decoded to float: the checks compare the widened
+// integers, and the mask picks between the scaled value and NaN
+template<typename FROM>
+static inline size_t UHDF_simdCalibrateSSE2( const FROM *in, float *out, const size_t n,
+                                             const FROM low, const FROM high, const bool hasFill, const FROM fill,
+                                             const float scale, const float offset)
+{
+    const __m128i lowV = _mm_set1_epi32(low);
+    const __m128i highV = _mm_set1_epi32(high);
+    const __m128i fillV = _mm_set1_epi32(fill);
+    const __m128i fillMask = _mm_set1_epi32(hasFill ? -1 : 0);
+    const __m128 scaleV = _mm_set1_ps(scale);
+    const __m128 offsetV = _mm_set1_ps(offset);
+    const __m128 nan = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+
+    const size_t width = UHDF_SimdLoad<FROM>::WIDTH_SSE2;
+    size_t i = 0;
+    for (; i + width <= n; i += width)
+    {
+        const __m128i v = UHDF_SimdLoad<FROM>::sse2(in + i);
+        const __m128i invalid = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(v, lowV), _mm_cmpgt_epi32(v, highV)),
+                                             _mm_and_si128(fillMask, _mm_cmpeq_epi32(v, fillV)));
+        const __m128 decoded = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(v), scaleV), offsetV);
+        const __m128 invalidF = _mm_castsi128_ps(invalid);
+        _mm_storeu_ps(out + i, _mm_or_ps(_mm_andnot_ps(invalidF, decoded), _mm_and_ps(invalidF, nan)));
+    }
+    return i;
+}
+
+template<typename FROM>
+__attribute__((target("avx2")))
+static size_t UHDF_simdCalibrateAVX2( const FROM *in, float *out, const size_t n,
+                                      const FROM low, const FROM high, const bool hasFill, const FROM fill,
+                                      const float scale, const float offset)
+{
+    const __m256i lowV = _mm256_set1_epi32(low);
+    const __m256i highV = _mm256_set1_epi32(high);
+    const __m256i fillV = _mm256_set1_epi32(fill);
+    const __m256i fillMask = _mm256_set1_epi32(hasFill ? -1 : 0);
+    const __m256 scaleV = _mm256_set1_ps(scale);
+    const __m256 offsetV = _mm256_set1_ps(offset);
+    const __m256 nan = _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN());
+
+    const size_t width = UHDF_SimdLoad<FROM>::WIDTH_AVX2;
+    size_t i = 0;
+    for (; i + width <= n; i += width)
+    {
+        const __m256i v = UHDF_SimdLoad<FROM>::avx2(in + i);
+        const __m256i invalid = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi32(lowV, v), _mm256_cmpgt_epi32(v, highV)),
+                                                _mm256_and_si256(fillMask, _mm256_cmpeq_epi32(v, fillV)));
+        const __m256 decoded = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(v), scaleV), offsetV);
+        _mm256_storeu_ps(out + i, _mm256_blendv_ps(decoded, nan, _mm256_castsi256_ps(invalid)));
+    }
+    return i;
+}
+
+template<typename FROM>
+struct UHDF_SimdCalibrateToFloat
+{
+    static inline size_t run( const FROM *in, float *out, const size_t n,
+                              const FROM low, const FROM high, const bool hasFill, const FROM fill,
+                              const float scale, const float offset)
+    {
+        if (UHDF_cpuHasAVX2())
+            return UHDF_simdCalibrateAVX2(in, out, n, low, high, hasFill, fill, scale, offset);
+        return UHDF_simdCalibrateSSE2(in, out, n, low, high, hasFill, fill, scale, offset);
+    }
+};
+
+template<> struct UHDF_SimdCalibrate<uint8_t, float> : UHDF_SimdCalibrateToFloat<uint8_t> {};
+template<> struct UHDF_SimdCalibrate<int8_t, float> : UHDF_SimdCalibrateToFloat<int8_t> {};
+template<> struct UHDF_SimdCalibrate<uint16_t, float> : UHDF_SimdCalibrateToFloat<uint16_t> {};
+template<> struct UHDF_SimdCalibrate<int16_t, float> : UHDF_SimdCalibrateToFloat<int16_t> {};
+template<> struct UHDF_SimdCalibrate<int32_t, float> : UHDF_SimdCalibrateToFloat<int32_t> {};
+
+#endif // UHDF_HAVE_X86_SIMD
+
+// Fused decoding kernel: range check, fill check and scaling in one pass.  8 to 32 bit
+// integers decoded to float use the SSE2/AVX2 pass above; other types use the scalar loop,
+// which has no branches so the compiler can vectorize it.  The limits are converted to the
+// stored type once, so the checks compare stored values exactly.
+template<typename FROM, typename TO>
+class UHDF_CalibrationKernel
+{
+public:
+    UHDF_CalibrationKernel( const UHDF_Calibration &calibration) :
+        scale (static_cast<TO>(calibration.scale)),
+        offset (static_cast<TO>(calibration.offset)),
+        hasFill (false),
+        fill (0),
+        low (lowest()),
+        high (highest())
+    {
+        const bool integral = std::numeric_limits<FROM>::is_integer;
+        const double minStored = static_cast<double>(std::numeric_limits<FROM>::lowest());
+        const double maxStored = static_cast<double>(std::numeric_limits<FROM>::max());
+
+        if (integral)
+        {
+            const double lo = std::ceil(calibration.validMin);
+            const double hi = std::floor(calibration.validMax);
+
+            if (lo > maxStored || hi < minStored || lo > hi)
+            {
+                // nothing is valid
+                low = highest();
+                high = lowest();
+            }
+            else
+            {
+                if (lo > minStored)
+                    low = static_cast<FROM>(lo);
+                if (hi < maxStored)
+                    high = static_cast<FROM>(hi);
+            }
+
+            // a fill value the stored type can't hold can't match anything
+            if (calibration.hasFillValue && calibration.fillValue == std::floor(calibration.fillValue) &&
+                calibration.fillValue >= minStored && calibration.fillValue <= maxStored)
+            {
+                hasFill = true;
+                fill = static_cast<FROM>(calibration.fillValue);
+            }
+        }
+        else
+        {
+            low = static_cast<FROM>(calibration.validMin);
+            high = static_cast<FROM>(calibration.validMax);
+            hasFill = calibration.hasFillValue;
+            fill = static_cast<FROM>(calibration.fillValue);
+        }
+    }
+
+    void operator()( const FROM *in, TO *out, const size_t n) const
+    {
+        const TO nan = std::numeric_limits<TO>::quiet_NaN();
+
+        for (size_t i = UHDF_SimdCalibrate<FROM, TO>::run(in, out, n, low, high, hasFill, fill, scale, offset); i < n; i++)
+        {
+            const FROM v = in[i];
+            const bool valid = (v >= low) & (v <= high) & !(hasFill & (v == fill));
+            out[i] = valid ? static_cast<TO>(v) * scale + offset : nan;
+        }
+    }
+
+private:
+    TO scale;
+    TO offset;
+    bool hasFill;
+    FROM fill;
+    FROM low;
+    FROM high;
+
+    // NaN fails both range checks, so it stays NaN
+    static FROM lowest()
+    {
+        return std::numeric_limits<FROM>::has_infinity ? -std::numeric_limits<FROM>::infinity() : std::numeric_limits<FROM>::lowest();
+    }
+
+    static FROM highest()
+    {
+        return std::numeric_limits<FROM>::has_infinity ? std::numeric_limits<FROM>::infinity() : std::numeric_limits<FROM>::max();
+    }
+};
+
+#endif // UHDF_CALIBRATION_H
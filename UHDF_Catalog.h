@@ -0,0 +1,1107 @@
+#ifndef UHDF_CATALOG_H
+#define UHDF_CATALOG_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <utility>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include "UHDF_File.h"
+#include "UHDF_MappedView.h"
+
+#include <sys/stat.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define UHDF_HAVE_DIRENT 1
+#include <dirent.h>
+#endif
+
+#include <boost/lexical_cast.hpp>
+
+// A catalog records what a set of files holds: every object's path and type, each dataset's
+// shape, type and chunking, and every attribute's value.  It's written once by
+// UHDF_CatalogBuilder and then read, mapped into memory, by UHDF_Catalog, which answers
+// metadata queries without opening the files.  Each file is keyed by its path, size and
+// modification time, so a file changed since the catalog was built isn't answered for.
+//
+// The catalog file is a header followed by arrays of fixed-size records (files sorted by
+// path, each file's objects sorted by path, each object's attributes sorted by name), an
+// array of dimension sizes, and the bytes of every name, path and attribute value.  Numbers
+// are in the byte order of the machine that wrote it.
+
+static const char UHDF_CATALOG_MAGIC[8] = { 'U', 'H', 'D', 'F', 'C', 'A', 'T', 0 };
+static const uint32_t UHDF_CATALOG_VERSION = 2;  // 2: modification times in nanoseconds
+static const uint32_t UHDF_CATALOG_BYTE_ORDER = 0x01020304;
+
+struct UHDF_CatalogHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t numFiles;
+    uint64_t numObjects;
+    uint64_t numAttributes;
+    uint64_t numSizes;
+    uint64_t filesOffset;
+    uint64_t objectsOffset;
+    uint64_t attributesOffset;
+    uint64_t sizesOffset;
+    uint64_t bytesOffset;
+    uint64_t bytesSize;
+};
+
+struct UHDF_CatalogFileRecord
+{
+    uint64_t pathOffset;
+    uint32_t pathLength;
+    uint32_t fileType;
+    uint64_t fileSize;
+    int64_t modifiedTime;  // nanoseconds since the epoch
+    uint64_t firstObject;
+    uint64_t numObjects;
+    uint64_t firstAttribute;  // the file's own (the root group's, for HDF5)
+    uint64_t numAttributes;
+};
+
+struct UHDF_CatalogObjectRecord
+{
+    uint64_t pathOffset;
+    uint32_t pathLength;
+    uint32_t objectType;
+    uint32_t dataType;
+    uint32_t layout;
+    uint32_t rank;
+    uint32_t numAttributes;
+    uint64_t firstSize;  // rank dimensions, then rank chunk dimensions if chunked
+    uint64_t firstAttribute;
+};
+
+struct UHDF_CatalogAttributeRecord
+{
+    uint64_t nameOffset;
+    uint32_t nameLength;
+    uint32_t dataType;
+    uint64_t numElements;
+    uint64_t valueOffset;  // strings are each a uint32_t length followed by the characters
+    uint64_t valueSize;
+};
+
+static_assert(sizeof(UHDF_CatalogHeader) == 96, "catalog header isn't packed as written");
+static_assert(sizeof(UHDF_CatalogFileRecord) == 64, "catalog file record isn't packed as written");
+static_assert(sizeof(UHDF_CatalogObjectRecord) == 48, "catalog object record isn't packed as written");
+static_assert(sizeof(UHDF_CatalogAttributeRecord) == 40, "catalog attribute record isn't packed as written");
+
+// size and modification time (in nanoseconds since the epoch) of a file; false if it can't
+// be found.  Whole seconds would miss a file rewritten at the same size within a second.
+static inline bool UHDF_statCatalogFile( const std::string &fileName, uint64_t &fileSize, int64_t &modifiedTime)
+{
+    struct stat fileInfo;
+    if (stat(fileName.c_str(), &fileInfo) < 0)
+        return false;
+
+    fileSize = fileInfo.st_size;
+#if defined(__APPLE__)
+    modifiedTime = static_cast<int64_t>(fileInfo.st_mtimespec.tv_sec) * 1000000000 + fileInfo.st_mtimespec.tv_nsec;
+#elif defined(__unix__)
+    modifiedTime = static_cast<int64_t>(fileInfo.st_mtim.tv_sec) * 1000000000 + fileInfo.st_mtim.tv_nsec;
+#else
+    modifiedTime = static_cast<int64_t>(fileInfo.st_mtime) * 1000000000;
+#endif
+    return true;
+}
+
+// orders text in the catalog against a key, like std::string::compare
+static inline int UHDF_compareCatalogText( const char *text, const uint32_t length, const std::string &key)
+{
+    const int result = memcmp(text, key.data(), std::min<size_t>(length, key.size()));
+    if (result != 0)
+        return result;
+    return (length < key.size()) ? -1 : (length > key.size()) ? 1 : 0;
+}
+
+class UHDF_Catalog;
+
+// A group, dataset or other object as the catalog recorded it.  Like every view into a
+// catalog, it's valid as long as the UHDF_Catalog it came from.
+class UHDF_CatalogObject
+{
+    friend class UHDF_CatalogFile;
+    friend class UHDF_CatalogBuilder;
+
+public:
+    std::string getName() const
+    {
+        const std::string path = getPath();
+        return path.substr(path.rfind('/') + 1);
+    }
+
+    // full path of the object within its file
+    std::string getPath() const;
+
+    UHDF_ObjectType getObjectType() const
+    {
+        return static_cast<UHDF_ObjectType>(record->objectType);
+    }
+
+    UHDF_ObjectInfo getInfo() const
+    {
+        UHDF_ObjectInfo info;
+        info.path = getPath();
+        info.name = info.path.substr(info.path.rfind('/') + 1);
+        info.type = getObjectType();
+        info.numAttributes = record->numAttributes;
+        return info;
+    }
+
+    // the rest describe datasets; other objects have rank 0 and type UHDF_UNKNOWN
+
+    std::vector<size_t> getDimensions() const;
+
+    size_t getRank() const
+    {
+        return record->rank;
+    }
+
+    size_t getNumElements() const
+    {
+        size_t elems = 1;
+        for (auto n : getDimensions())
+        {
+            elems *= n;
+        }
+        return elems;
+    }
+
+    UHDF_DataType getType() const
+    {
+        return static_cast<UHDF_DataType>(record->dataType);
+    }
+
+    UHDF_StorageLayout getLayout() const
+    {
+        return static_cast<UHDF_StorageLayout>(record->layout);
+    }
+
+    bool isChunked() const
+    {
+        return getLayout() == UHDF_CHUNKED;
+    }
+
+    // empty unless the dataset is chunked
+    std::vector<size_t> getChunkDimensions() const;
+
+    // every attribute with its value, as readAllAttributes on the object would give
+    UHDF_AttributeMap readAllAttributes() const;
+
+private:
+    const UHDF_Catalog *catalog;
+    const UHDF_CatalogObjectRecord *record;
+
+    UHDF_CatalogObject( const UHDF_Catalog *owner, const UHDF_CatalogObjectRecord *objectRecord) :
+        catalog (owner),
+        record (objectRecord)
+    {}
+};
+
+// What the catalog recorded about one file; the metadata queries of UHDF_File, answered
+// without opening it.
+class UHDF_CatalogFile
+{
+    friend class UHDF_Catalog;
+    friend class UHDF_CatalogBuilder;
+
+public:
+    std::string getFileName() const;
+
+    UHDF_FileType getFileType() const
+    {
+        return static_cast<UHDF_FileType>(record->fileType);
+    }
+
+    // size and modification time (in nanoseconds since the epoch) of the file when it was
+    // cataloged
+    uint64_t getFileSize() const
+    {
+        return record->fileSize;
+    }
+
+    int64_t getModifiedTime() const
+    {
+        return record->modifiedTime;
+    }
+
+    size_t getNumObjects() const
+    {
+        return record->numObjects;
+    }
+
+    // members of a group (the root group by default; every dataset, for HDF4) with their types
+    std::vector<UHDF_ObjectInfo> getChildren( const std::string &groupPath = "") const
+    {
+        std::vector<UHDF_ObjectInfo> children;
+        const std::string path = (!groupPath.empty() && groupPath[0] == '/') ? groupPath.substr(1) : groupPath;
+        const std::string prefix = path.empty() ? path : path + "/";
+
+        // paths sort after their parent's prefix, with their own descendants among them
+        for (size_t i = lowerBound(prefix); i < record->numObjects; i++)
+        {
+            const UHDF_CatalogObject object(catalog, objects + i);
+            const std::string childPath = object.getPath();
+            if (childPath.compare(0, prefix.size(), prefix) != 0)
+                break;
+            if (childPath.find('/', prefix.size()) == std::string::npos)
+                children.push_back(object.getInfo());
+        }
+
+        return children;
+    }
+
+    // calls visitor for every object in the file, parents before children, until it returns
+    // false; like UHDF_File::visit, links that weren't followed are left out
+    void visit( const UHDF_Visitor &visitor) const
+    {
+        for (size_t i = 0; i < record->numObjects; i++)
+        {
+            if (objects[i].objectType == UHDF_OBJ_LINK)
+                continue;
+            if (!visitor(UHDF_CatalogObject(catalog, objects + i).getInfo()))
+                break;
+        }
+    }
+
+    std::vector<std::string> getDatasetNames() const
+    {
+        return getChildNames(UHDF_OBJ_DATASET);
+    }
+
+    std::vector<std::string> getGroupNames() const
+    {
+        return getChildNames(UHDF_OBJ_GROUP);
+    }
+
+    bool hasObject( const std::string &objectPath) const
+    {
+        return findObject(objectPath) != NULL;
+    }
+
+    bool hasDataset( const std::string &datasetPath) const
+    {
+        const UHDF_CatalogObjectRecord *found = findObject(datasetPath);
+        return found != NULL && found->objectType == UHDF_OBJ_DATASET;
+    }
+
+    // the object at a path, which may start with '/'
+    UHDF_CatalogObject getObject( const std::string &objectPath) const
+    {
+        const UHDF_CatalogObjectRecord *found = findObject(objectPath);
+        if (found == NULL)
+            throw UHDF_Exception("Catalog has no object '" + objectPath + "' in " + getFileName());
+        return UHDF_CatalogObject(catalog, found);
+    }
+
+    // every attribute of the file (the root group's, for HDF5)
+    UHDF_AttributeMap readAllAttributes() const;
+
+private:
+    const UHDF_Catalog *catalog;
+    const UHDF_CatalogFileRecord *record;
+    const UHDF_CatalogObjectRecord *objects;
+
+    UHDF_CatalogFile( const UHDF_Catalog *owner, const UHDF_CatalogFileRecord *fileRecord);
+
+    // first object whose path isn't before key
+    size_t lowerBound( const std::string &key) const;
+
+    const UHDF_CatalogObjectRecord *findObject( const std::string &objectPath) const;
+
+    std::vector<std::string> getChildNames( const UHDF_ObjectType objType) const
+    {
+        std::vector<std::string> names;
+        for (const auto &child : getChildren())
+        {
+            if (child.type == objType)
+                names.push_back(child.name);
+        }
+        return names;
+    }
+};
+
+// A catalog file, mapped read-only.  Processes that open the same catalog share the page
+// cache's copy of it, and nothing is read from it until it's looked at, so opening one that
+// covers millions of files is cheap.  Move-only; views from it stay valid while it lives.
+class UHDF_Catalog
+{
+    friend class UHDF_CatalogObject;
+    friend class UHDF_CatalogFile;
+
+public:
+    explicit UHDF_Catalog( const std::string &catalogName) :
+        filename (catalogName),
+        mapping (NULL),
+        mappingSize (0),
+        header (NULL)
+    {
+#ifdef UHDF_HAVE_MMAP
+        const int fd = open(catalogName.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw UHDF_Exception("Couldn't open catalog " + catalogName + ": " + strerror(errno));
+
+        struct stat fileInfo;
+        if (fstat(fd, &fileInfo) < 0 || static_cast<size_t>(fileInfo.st_size) < sizeof(UHDF_CatalogHeader))
+        {
+            close(fd);
+            throw UHDF_Exception(catalogName + " is too short to be a catalog");
+        }
+        mappingSize = fileInfo.st_size;
+
+        void *mapped = mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            const int err = errno;
+            close(fd);
+            throw UHDF_Exception("Couldn't map catalog " + catalogName + ": " + strerror(err));
+        }
+        close(fd);
+
+        mapping = mapped;
+        header = static_cast<const UHDF_CatalogHeader*>(mapping);
+
+        try
+        {
+            checkHeader();
+        }
+        catch (...)
+        {
+            release();
+            throw;
+        }
+#else
+        throw UHDF_Exception("Catalogs aren't supported on this platform");
+#endif
+    }
+
+    ~UHDF_Catalog()
+    {
+        release();
+    }
+
+    UHDF_Catalog( const UHDF_Catalog &) = delete;
+    UHDF_Catalog &operator=( const UHDF_Catalog &) = delete;
+
+    UHDF_Catalog( UHDF_Catalog &&other) :
+        mapping (NULL),
+        mappingSize (0),
+        header (NULL)
+    {
+        swap(other);
+    }
+
+    UHDF_Catalog &operator=( UHDF_Catalog &&other)
+    {
+        if (this != &other)
+        {
+            release();
+            swap(other);
+        }
+        return *this;
+    }
+
+    void swap( UHDF_Catalog &other)
+    {
+        std::swap(filename, other.filename);
+        std::swap(mapping, other.mapping);
+        std::swap(mappingSize, other.mappingSize);
+        std::swap(header, other.header);
+    }
+
+    const std::string &getCatalogName() const
+    {
+        return filename;
+    }
+
+    size_t getNumFiles() const
+    {
+        return header->numFiles;
+    }
+
+    // every cataloged file, in path order
+    std::vector<std::string> getFileNames() const
+    {
+        std::vector<std::string> names;
+        names.reserve(header->numFiles);
+        for (size_t i = 0; i < header->numFiles; i++)
+            names.push_back(UHDF_CatalogFile(this, files() + i).getFileName());
+        return names;
+    }
+
+    // true if the file is cataloged and hasn't changed size or modification time since
+    bool isCurrent( const std::string &fileName) const
+    {
+        const UHDF_CatalogFileRecord *found = findFile(fileName);
+        if (found == NULL)
+            return false;
+
+        uint64_t fileSize;
+        int64_t modifiedTime;
+        return UHDF_statCatalogFile(fileName, fileSize, modifiedTime) &&
+               fileSize == found->fileSize && modifiedTime == found->modifiedTime;
+    }
+
+    // What the catalog holds about a file, which must be named by the same path it was
+    // cataloged under; fails if it isn't cataloged or has changed since (see isCurrent).
+    UHDF_CatalogFile openFile( const std::string &fileName) const
+    {
+        const UHDF_CatalogFileRecord *found = findFile(fileName);
+        if (found == NULL)
+            throw UHDF_Exception(fileName + " isn't in catalog " + filename);
+        if (!isCurrent(fileName))
+            throw UHDF_Exception(fileName + " has changed since catalog " + filename + " was built");
+
+        return UHDF_CatalogFile(this, found);
+    }
+
+    // Files holding a dataset at datasetPath, as they were when the catalog was built; one
+    // search per file, without looking at the files themselves.
+    std::vector<std::string> getFilesWithDataset( const std::string &datasetPath) const
+    {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < header->numFiles; i++)
+        {
+            const UHDF_CatalogFile file(this, files() + i);
+            if (file.hasDataset(datasetPath))
+                names.push_back(file.getFileName());
+        }
+        return names;
+    }
+
+private:
+    std::string filename;
+    const void *mapping;
+    size_t mappingSize;
+    const UHDF_CatalogHeader *header;
+
+    void release()
+    {
+#ifdef UHDF_HAVE_MMAP
+        if (mapping != NULL)
+            munmap(const_cast<void*>(mapping), mappingSize);
+#endif
+        mapping = NULL;
+        mappingSize = 0;
+        header = NULL;
+    }
+
+    // every section has to lie within the catalog, so records can be used without checks
+    void checkSection( const uint64_t offset, const uint64_t count, const uint64_t recordSize) const
+    {
+        if (offset % sizeof(uint64_t) != 0 || offset > mappingSize || count > (mappingSize - offset) / recordSize)
+            throw UHDF_Exception(filename + " is corrupt (a section extends past its end)");
+    }
+
+    void checkHeader() const
+    {
+        if (memcmp(header->magic, UHDF_CATALOG_MAGIC, sizeof(UHDF_CATALOG_MAGIC)) != 0)
+            throw UHDF_Exception(filename + " is not a catalog");
+        if (header->byteOrder != UHDF_CATALOG_BYTE_ORDER)
+            throw UHDF_Exception("Catalog " + filename + " was written on a machine with a different byte order");
+        if (header->version != UHDF_CATALOG_VERSION)
+            throw UHDF_Exception("Catalog " + filename + " has version " + boost::lexical_cast<std::string>(header->version) +
+                                 ", not " + boost::lexical_cast<std::string>(UHDF_CATALOG_VERSION));
+
+        checkSection(header->filesOffset, header->numFiles, sizeof(UHDF_CatalogFileRecord));
+        checkSection(header->objectsOffset, header->numObjects, sizeof(UHDF_CatalogObjectRecord));
+        checkSection(header->attributesOffset, header->numAttributes, sizeof(UHDF_CatalogAttributeRecord));
+        checkSection(header->sizesOffset, header->numSizes, sizeof(uint64_t));
+        checkSection(header->bytesOffset, header->bytesSize, 1);
+    }
+
+    const char *base() const
+    {
+        return static_cast<const char*>(mapping);
+    }
+
+    const UHDF_CatalogFileRecord *files() const
+    {
+        return reinterpret_cast<const UHDF_CatalogFileRecord*>(base() + header->filesOffset);
+    }
+
+    // the rest check the ranges in a record, which aren't checked when the catalog is opened
+
+    const UHDF_CatalogObjectRecord *objects( const uint64_t first, const uint64_t count) const
+    {
+        if (first > header->numObjects || count > header->numObjects - first)
+            throw UHDF_Exception(filename + " is corrupt (objects out of range)");
+        return reinterpret_cast<const UHDF_CatalogObjectRecord*>(base() + header->objectsOffset) + first;
+    }
+
+    const UHDF_CatalogAttributeRecord *attributes( const uint64_t first, const uint64_t count) const
+    {
+        if (first > header->numAttributes || count > header->numAttributes - first)
+            throw UHDF_Exception(filename + " is corrupt (attributes out of range)");
+        return reinterpret_cast<const UHDF_CatalogAttributeRecord*>(base() + header->attributesOffset) + first;
+    }
+
+    const uint64_t *sizes( const uint64_t first, const uint64_t count) const
+    {
+        if (first > header->numSizes || count > header->numSizes - first)
+            throw UHDF_Exception(filename + " is corrupt (dimensions out of range)");
+        return reinterpret_cast<const uint64_t*>(base() + header->sizesOffset) + first;
+    }
+
+    const char *bytes( const uint64_t offset, const uint64_t length) const
+    {
+        if (offset > header->bytesSize || length > header->bytesSize - offset)
+            throw UHDF_Exception(filename + " is corrupt (names or values out of range)");
+        return base() + header->bytesOffset + offset;
+    }
+
+    std::string text( const uint64_t offset, const uint32_t length) const
+    {
+        return std::string(bytes(offset, length), length);
+    }
+
+    const UHDF_CatalogFileRecord *findFile( const std::string &fileName) const
+    {
+        const UHDF_CatalogFileRecord *first = files();
+        const UHDF_CatalogFileRecord *last = first + header->numFiles;
+
+        const UHDF_CatalogFileRecord *found = std::lower_bound(first, last, fileName,
+            [this](const UHDF_CatalogFileRecord &entry, const std::string &key)
+            {
+                return UHDF_compareCatalogText(bytes(entry.pathOffset, entry.pathLength), entry.pathLength, key) < 0;
+            });
+
+        if (found == last || UHDF_compareCatalogText(bytes(found->pathOffset, found->pathLength), found->pathLength, fileName) != 0)
+            return NULL;
+        return found;
+    }
+
+    UHDF_AttributeMap readAttributes( const uint64_t first, const uint64_t count) const
+    {
+        const UHDF_CatalogAttributeRecord *records = attributes(first, count);
+
+        std::vector<UHDF_AttributeMap::Entry> entries;
+        entries.reserve(count);
+
+        for (uint64_t i = 0; i < count; i++)
+        {
+            const UHDF_CatalogAttributeRecord &attribute = records[i];
+            const char *value = bytes(attribute.valueOffset, attribute.valueSize);
+            const UHDF_DataType datatype = static_cast<UHDF_DataType>(attribute.dataType);
+
+            UHDF_AttributeValue converted;
+            if (datatype == UHDF_STRING)
+            {
+                std::vector<std::string> strings;
+                strings.reserve(attribute.numElements);
+
+                uint64_t position = 0;
+                for (uint64_t s = 0; s < attribute.numElements; s++)
+                {
+                    uint32_t length;
+                    if (attribute.valueSize - position < sizeof(length))
+                        throw UHDF_Exception(filename + " is corrupt (string attribute too short)");
+                    memcpy(&length, value + position, sizeof(length));
+                    position += sizeof(length);
+
+                    if (attribute.valueSize - position < length)
+                        throw UHDF_Exception(filename + " is corrupt (string attribute too short)");
+                    strings.push_back(std::string(value + position, length));
+                    position += length;
+                }
+
+                converted = UHDF_AttributeValue(std::move(strings));
+            }
+            else if (datatype != UHDF_UNKNOWN)
+            {
+                converted = UHDF_AttributeValue(datatype, attribute.numElements, std::vector<char>(value, value + attribute.valueSize));
+            }
+
+            entries.push_back(std::make_pair(text(attribute.nameOffset, attribute.nameLength), std::move(converted)));
+        }
+
+        return UHDF_AttributeMap(std::move(entries));
+    }
+};
+
+inline std::string UHDF_CatalogObject::getPath() const
+{
+    return catalog->text(record->pathOffset, record->pathLength);
+}
+
+inline std::vector<size_t> UHDF_CatalogObject::getDimensions() const
+{
+    const uint64_t *dims = catalog->sizes(record->firstSize, record->rank);
+    return std::vector<size_t>(dims, dims + record->rank);
+}
+
+inline std::vector<size_t> UHDF_CatalogObject::getChunkDimensions() const
+{
+    if (!isChunked())
+        return std::vector<size_t>();
+
+    const uint64_t *chunkDims = catalog->sizes(record->firstSize + record->rank, record->rank);
+    return std::vector<size_t>(chunkDims, chunkDims + record->rank);
+}
+
+inline UHDF_AttributeMap UHDF_CatalogObject::readAllAttributes() const
+{
+    return catalog->readAttributes(record->firstAttribute, record->numAttributes);
+}
+
+inline UHDF_CatalogFile::UHDF_CatalogFile( const UHDF_Catalog *owner, const UHDF_CatalogFileRecord *fileRecord) :
+    catalog (owner),
+    record (fileRecord),
+    objects (owner->objects(fileRecord->firstObject, fileRecord->numObjects))
+{}
+
+inline std::string UHDF_CatalogFile::getFileName() const
+{
+    return catalog->text(record->pathOffset, record->pathLength);
+}
+
+inline size_t UHDF_CatalogFile::lowerBound( const std::string &key) const
+{
+    const UHDF_CatalogObjectRecord *last = objects + record->numObjects;
+    const UHDF_Catalog *owner = catalog;
+
+    return std::lower_bound(objects, last, key,
+        [owner](const UHDF_CatalogObjectRecord &entry, const std::string &path)
+        {
+            return UHDF_compareCatalogText(owner->bytes(entry.pathOffset, entry.pathLength), entry.pathLength, path) < 0;
+        }) - objects;
+}
+
+inline const UHDF_CatalogObjectRecord *UHDF_CatalogFile::findObject( const std::string &objectPath) const
+{
+    // paths are recorded as visit reports them, without a leading '/'
+    const std::string path = (!objectPath.empty() && objectPath[0] == '/') ? objectPath.substr(1) : objectPath;
+
+    const size_t i = lowerBound(path);
+    if (i == record->numObjects)
+        return NULL;
+
+    const UHDF_CatalogObjectRecord *found = objects + i;
+    if (UHDF_compareCatalogText(catalog->bytes(found->pathOffset, found->pathLength), found->pathLength, path) != 0)
+        return NULL;
+    return found;
+}
+
+inline UHDF_AttributeMap UHDF_CatalogFile::readAllAttributes() const
+{
+    return catalog->readAttributes(record->firstAttribute, record->numAttributes);
+}
+
+//--------------------------------
+// building
+
+// Scans files and writes a catalog of them.  Given the previous catalog, files that haven't
+// changed since it was built are copied from it instead of opened again, so rebuilding
+// after new files arrive only opens those.
+class UHDF_CatalogBuilder
+{
+public:
+    explicit UHDF_CatalogBuilder( const UHDF_Catalog *previousCatalog = NULL) :
+        previous (previousCatalog),
+        numReused (0)
+    {}
+
+    // Catalogs one file, under the path it's named by; fails if it isn't an HDF4 or HDF5
+    // file or can't be read.  A file added twice is cataloged once.
+    void addFile( const std::string &fileName)
+    {
+        Entry entry;
+        entry.path = fileName;
+
+        if (!UHDF_statCatalogFile(fileName, entry.fileSize, entry.modifiedTime))
+            throw UHDF_Exception("Couldn't find " + fileName + " to catalog");
+
+        if (previous != NULL && previous->isCurrent(fileName))
+        {
+            copyEntry(previous->openFile(fileName), entry);
+            numReused++;
+        }
+        else
+        {
+            scanEntry(entry);
+        }
+
+        entries.push_back(std::move(entry));
+    }
+
+    // Catalogs the files in a directory, and in its subdirectories if recursive; files that
+    // can't be cataloged are skipped and listed by getSkippedFiles.  Returns the number of
+    // files cataloged.
+    size_t addDirectory( const std::string &directory, const bool recursive = true)
+    {
+#ifdef UHDF_HAVE_DIRENT
+        DIR *dir = opendir(directory.c_str());
+        if (dir == NULL)
+            throw UHDF_Exception("Couldn't open directory " + directory + ": " + strerror(errno));
+
+        std::vector<std::string> names;
+        for (struct dirent *item = readdir(dir); item != NULL; item = readdir(dir))
+        {
+            if (strcmp(item->d_name, ".") != 0 && strcmp(item->d_name, "..") != 0)
+                names.push_back(item->d_name);
+        }
+        closedir(dir);
+
+        // in name order, so the same directory always scans the same way
+        std::sort(names.begin(), names.end());
+
+        size_t numAdded = 0;
+        for (const auto &name : names)
+        {
+            const std::string path = (!directory.empty() && directory[directory.size() - 1] == '/') ? directory + name : directory + "/" + name;
+
+            // symbolic links to directories aren't followed, so links can't make a cycle
+            struct stat linkInfo;
+            if (lstat(path.c_str(), &linkInfo) < 0)
+                continue;
+
+            if (S_ISDIR(linkInfo.st_mode))
+            {
+                if (recursive)
+                    numAdded += addDirectory(path, recursive);
+                continue;
+            }
+
+            try
+            {
+                addFile(path);
+                numAdded++;
+            }
+            catch (const UHDF_Exception &)
+            {
+                skipped.push_back(path);
+            }
+        }
+
+        return numAdded;
+#else
+        throw UHDF_Exception("Scanning directories isn't supported on this platform");
+#endif
+    }
+
+    size_t getNumFiles() const
+    {
+        return entries.size();
+    }
+
+    // files copied from the previous catalog rather than opened
+    size_t getNumReused() const
+    {
+        return numReused;
+    }
+
+    const std::vector<std::string> &getSkippedFiles() const
+    {
+        return skipped;
+    }
+
+    // Writes the catalog, replacing any file of that name only once it's complete, so
+    // processes with the old catalog open keep reading it unchanged.
+    void write( const std::string &catalogName)
+    {
+        // sorted for searching; the first of two entries for the same file is kept
+        std::stable_sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b)
+            {
+                return a.path < b.path;
+            });
+        entries.erase(std::unique(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b)
+            {
+                return a.path == b.path;
+            }), entries.end());
+
+        std::vector<UHDF_CatalogFileRecord> fileRecords;
+        std::vector<UHDF_CatalogObjectRecord> objectRecords;
+        std::vector<UHDF_CatalogAttributeRecord> attributeRecords;
+        std::vector<uint64_t> sizes;
+        std::vector<char> bytes;
+
+        fileRecords.reserve(entries.size());
+
+        for (const auto &entry : entries)
+        {
+            UHDF_CatalogFileRecord fileRecord = UHDF_CatalogFileRecord();
+            fileRecord.pathOffset = addBytes(bytes, entry.path.data(), entry.path.size());
+            fileRecord.pathLength = entry.path.size();
+            fileRecord.fileType = entry.fileType;
+            fileRecord.fileSize = entry.fileSize;
+            fileRecord.modifiedTime = entry.modifiedTime;
+            fileRecord.firstAttribute = attributeRecords.size();
+            fileRecord.numAttributes = entry.attributes.size();
+            addAttributes(entry.attributes, attributeRecords, bytes);
+
+            fileRecord.firstObject = objectRecords.size();
+            fileRecord.numObjects = entry.objects.size();
+
+            for (const auto &object : entry.objects)
+            {
+                UHDF_CatalogObjectRecord objectRecord = UHDF_CatalogObjectRecord();
+                objectRecord.pathOffset = addBytes(bytes, object.path.data(), object.path.size());
+                objectRecord.pathLength = object.path.size();
+                objectRecord.objectType = object.type;
+                objectRecord.dataType = object.dataType;
+                objectRecord.layout = object.layout;
+                objectRecord.rank = object.dimensions.size();
+                objectRecord.firstSize = sizes.size();
+                sizes.insert(sizes.end(), object.dimensions.begin(), object.dimensions.end());
+                if (object.layout == UHDF_CHUNKED)
+                    sizes.insert(sizes.end(), object.chunkDimensions.begin(), object.chunkDimensions.end());
+
+                objectRecord.firstAttribute = attributeRecords.size();
+                objectRecord.numAttributes = object.attributes.size();
+                addAttributes(object.attributes, attributeRecords, bytes);
+
+                objectRecords.push_back(objectRecord);
+            }
+
+            fileRecords.push_back(fileRecord);
+        }
+
+        UHDF_CatalogHeader header = UHDF_CatalogHeader();
+        memcpy(header.magic, UHDF_CATALOG_MAGIC, sizeof(UHDF_CATALOG_MAGIC));
+        header.version = UHDF_CATALOG_VERSION;
+        header.byteOrder = UHDF_CATALOG_BYTE_ORDER;
+        header.numFiles = fileRecords.size();
+        header.numObjects = objectRecords.size();
+        header.numAttributes = attributeRecords.size();
+        header.numSizes = sizes.size();
+        header.filesOffset = sizeof(header);
+        header.objectsOffset = header.filesOffset + fileRecords.size() * sizeof(UHDF_CatalogFileRecord);
+        header.attributesOffset = header.objectsOffset + objectRecords.size() * sizeof(UHDF_CatalogObjectRecord);
+        header.sizesOffset = header.attributesOffset + attributeRecords.size() * sizeof(UHDF_CatalogAttributeRecord);
+        header.bytesOffset = header.sizesOffset + sizes.size() * sizeof(uint64_t);
+        header.bytesSize = bytes.size();
+
+        const std::string partialName = catalogName + ".partial";
+        {
+            std::ofstream out(partialName.c_str(), std::ios::binary | std::ios::trunc);
+            if (!out)
+                throw UHDF_Exception("Couldn't create catalog " + partialName);
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(fileRecords.data()), fileRecords.size() * sizeof(UHDF_CatalogFileRecord));
+            out.write(reinterpret_cast<const char*>(objectRecords.data()), objectRecords.size() * sizeof(UHDF_CatalogObjectRecord));
+            out.write(reinterpret_cast<const char*>(attributeRecords.data()), attributeRecords.size() * sizeof(UHDF_CatalogAttributeRecord));
+            out.write(reinterpret_cast<const char*>(sizes.data()), sizes.size() * sizeof(uint64_t));
+            out.write(bytes.data(), bytes.size());
+            out.close();
+
+            if (!out)
+            {
+                std::remove(partialName.c_str());
+                throw UHDF_Exception("Error writing catalog " + partialName);
+            }
+        }
+
+        if (std::rename(partialName.c_str(), catalogName.c_str()) != 0)
+        {
+            std::remove(partialName.c_str());
+            throw UHDF_Exception("Couldn't replace catalog " + catalogName + ": " + strerror(errno));
+        }
+    }
+
+private:
+    struct Object
+    {
+        Object() :
+            type (UHDF_OBJ_OTHER),
+            dataType (UHDF_UNKNOWN),
+            layout (UHDF_CONTIGUOUS)
+        {}
+
+        std::string path;
+        UHDF_ObjectType type;
+        UHDF_DataType dataType;
+        UHDF_StorageLayout layout;
+        std::vector<size_t> dimensions;
+        std::vector<size_t> chunkDimensions;
+        UHDF_AttributeMap attributes;
+    };
+
+    struct Entry
+    {
+        Entry() :
+            fileType (UHDF_HDF5),
+            fileSize (0),
+            modifiedTime (0)
+        {}
+
+        std::string path;
+        UHDF_FileType fileType;
+        uint64_t fileSize;
+        int64_t modifiedTime;
+        UHDF_AttributeMap attributes;
+        std::vector<Object> objects;
+    };
+
+    const UHDF_Catalog *previous;
+    std::vector<Entry> entries;
+    std::vector<std::string> skipped;
+    size_t numReused;
+
+    static void scanEntry( Entry &entry)
+    {
+        std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+
+        UHDF_File file(entry.path);
+        file.setHandleCacheSize(0);
+
+        entry.fileType = file.getFileType();
+        entry.attributes = file.readAllAttributes();
+
+        std::vector<UHDF_ObjectInfo> infos;
+        file.visit([&infos](const UHDF_ObjectInfo &info)
+        {
+            infos.push_back(info);
+            return true;
+        });
+
+        // links visit doesn't follow still show up among their group's children
+        if (entry.fileType == UHDF_HDF5)
+        {
+            std::vector<UHDF_ObjectInfo> links;
+            for (const auto &child : file.getChildren())
+            {
+                if (child.type == UHDF_OBJ_LINK)
+                    links.push_back(child);
+            }
+            for (const auto &info : infos)
+            {
+                if (info.type != UHDF_OBJ_GROUP)
+                    continue;
+                for (const auto &child : file.openGroup(info.path).getChildren())
+                {
+                    if (child.type == UHDF_OBJ_LINK)
+                        links.push_back(child);
+                }
+            }
+            infos.insert(infos.end(), links.begin(), links.end());
+        }
+
+        for (const auto &info : infos)
+        {
+            Object object;
+            object.path = info.path;
+            object.type = info.type;
+
+            if (info.type == UHDF_OBJ_DATASET)
+            {
+                const UHDF_Dataset dataset = file.openDataset(info.path);
+                object.dataType = dataset.getType();
+                object.layout = dataset.getLayout();
+                object.dimensions = dataset.getDimensions();
+                object.chunkDimensions = dataset.getChunkDimensions();
+                object.attributes = dataset.readAllAttributes();
+            }
+            else if (info.type == UHDF_OBJ_GROUP)
+            {
+                object.attributes = file.openGroup(info.path).readAllAttributes();
+            }
+
+            entry.objects.push_back(std::move(object));
+        }
+
+        sortObjects(entry);
+    }
+
+    static void copyEntry( const UHDF_CatalogFile &cataloged, Entry &entry)
+    {
+        entry.fileType = cataloged.getFileType();
+        entry.attributes = cataloged.readAllAttributes();
+
+        // every record, links included, already in order
+        for (size_t i = 0; i < cataloged.getNumObjects(); i++)
+        {
+            const UHDF_CatalogObject source(cataloged.catalog, cataloged.objects + i);
+
+            Object object;
+            object.path = source.getPath();
+            object.type = source.getObjectType();
+            object.dataType = source.getType();
+            object.layout = source.getLayout();
+            object.dimensions = source.getDimensions();
+            object.chunkDimensions = source.getChunkDimensions();
+            object.attributes = source.readAllAttributes();
+
+            entry.objects.push_back(std::move(object));
+        }
+    }
+
+    // by path, for searching; HDF4 files can repeat a name, and like SDnametoindex the
+    // first dataset with it wins
+    static void sortObjects( Entry &entry)
+    {
+        std::stable_sort(entry.objects.begin(), entry.objects.end(),
+            [](const Object &a, const Object &b)
+            {
+                return a.path < b.path;
+            });
+        entry.objects.erase(std::unique(entry.objects.begin(), entry.objects.end(),
+            [](const Object &a, const Object &b)
+            {
+                return a.path == b.path;
+            }), entry.objects.end());
+    }
+
+    static uint64_t addBytes( std::vector<char> &bytes, const void *data, const size_t numBytes)
+    {
+        const uint64_t offset = bytes.size();
+        const char *first = static_cast<const char*>(data);
+        bytes.insert(bytes.end(), first, first + numBytes);
+        return offset;
+    }
+
+    static void addAttributes( const UHDF_AttributeMap &attributes,
+                               std::vector<UHDF_CatalogAttributeRecord> &records,
+                               std::vector<char> &bytes)
+    {
+        for (const auto &attribute : attributes)
+        {
+            const UHDF_AttributeValue &value = attribute.second;
+
+            UHDF_CatalogAttributeRecord record = UHDF_CatalogAttributeRecord();
+            record.nameOffset = addBytes(bytes, attribute.first.data(), attribute.first.size());
+            record.nameLength = attribute.first.size();
+            record.dataType = value.getType();
+            record.numElements = value.getNumElements();
+            record.valueOffset = bytes.size();
+
+            switch(value.getType())
+            {
+            case UHDF_STRING:
+                for (const auto &s : value.asStrings())
+                {
+                    const uint32_t length = s.size();
+                    addBytes(bytes, &length, sizeof(length));
+                    addBytes(bytes, s.data(), s.size());
+                }
+                break;
+            case UHDF_REFERENCE:
+            case UHDF_UNKNOWN:
+                // recorded without a value, as they're read
+                record.numElements = 0;
+                break;
+            default:
+                addBytes(bytes, value.data(), value.getNumElements() * UHDFTypeSize(value.getType()));
+                break;
+            }
+
+            record.valueSize = bytes.size() - record.valueOffset;
+            records.push_back(record);
+        }
+    }
+};
+
+#endif // UHDF_CATALOG_H
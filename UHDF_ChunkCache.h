@@ -0,0 +1,108 @@
+#ifndef UHDF_CHUNKCACHE_H
+#define UHDF_CHUNKCACHE_H
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+#include "UHDF_Types.h"
+
+// most memory the automatic chunk cache grows to for one dataset
+static const size_t UHDF_DEFAULT_AUTO_CHUNK_CACHE_BYTES = 128 * 1024 * 1024;
+
+typedef enum
+{
+    UHDF_CACHE_DEFAULT,  // whatever the library gives (1 MB per dataset in HDF5)
+    UHDF_CACHE_FIXED,    // exactly numBytes
+    UHDF_CACHE_AUTO      // enough for one slab of chunks, grown to fit each read, up to numBytes
+} UHDF_ChunkCacheMode;
+
+// How much decoded chunk data each dataset keeps.  A read that needs a chunk the cache no
+// longer holds reads and decompresses it again, so a cache smaller than the chunks one
+// read touches makes every neighbouring read start over.  HDF4 caches whole chunks, so
+// numBytes is rounded down to a whole number of them (at least one).
+struct UHDF_ChunkCache
+{
+    UHDF_ChunkCache() :
+        mode (UHDF_CACHE_DEFAULT),
+        numBytes (0),
+        numSlots (0),
+        preemption (0.75)
+    {}
+
+    static UHDF_ChunkCache fixed( const size_t bytes, const size_t slots = 0, const double preemptionPolicy = 0.75)
+    {
+        UHDF_ChunkCache cache;
+        cache.mode = UHDF_CACHE_FIXED;
+        cache.numBytes = bytes;
+        cache.numSlots = slots;
+        cache.preemption = preemptionPolicy;
+        return cache;
+    }
+
+    static UHDF_ChunkCache automatic( const size_t maxBytes = UHDF_DEFAULT_AUTO_CHUNK_CACHE_BYTES)
+    {
+        UHDF_ChunkCache cache;
+        cache.mode = UHDF_CACHE_AUTO;
+        cache.numBytes = maxBytes;
+        return cache;
+    }
+
+    UHDF_ChunkCacheMode mode;
+    size_t numBytes;
+    size_t numSlots;    // HDF5 hash table size; 0 picks one from the number of chunks that fit
+    double preemption;  // HDF5 only: 0 evicts least recently used, 1 prefers chunks read completely
+};
+
+// HDF5 wants a prime number of hash slots, about 100 per chunk the cache holds
+static inline size_t UHDF_chunkCacheSlots( const size_t numChunks)
+{
+    size_t n = std::max<size_t>(521, numChunks * 100) | 1;
+
+    while (true)
+    {
+        bool prime = true;
+        for (size_t d = 3; d * d <= n && prime; d += 2)
+            prime = (n % d) != 0;
+
+        if (prime)
+            return n;
+        n += 2;
+    }
+}
+
+// the most chunks a selection of this stride and count can touch, wherever it starts
+static inline size_t UHDF_maxChunksTouched( const std::vector<size_t> &dimensions,
+                                            const std::vector<size_t> &chunkDimensions,
+                                            const int32 *const stride,
+                                            const int32 *const count)
+{
+    size_t chunks = 1;
+    for (size_t i = 0; i < chunkDimensions.size(); i++)
+    {
+        const size_t chunkLength = std::max<size_t>(1, chunkDimensions[i]);
+        const size_t chunksAlong = (dimensions[i] + chunkLength - 1) / chunkLength;
+
+        const size_t span = (count[i] > 0) ? static_cast<size_t>(count[i] - 1) * stride[i] + 1 : 0;
+        const size_t touched = (span == 0) ? 0 : (span + chunkLength - 2) / chunkLength + 1;
+
+        chunks *= std::min(std::max<size_t>(touched, 1), std::max<size_t>(chunksAlong, 1));
+    }
+    return chunks;
+}
+
+// chunks in one slab of whole chunks along the slowest dimension, which is what a scan
+// row by row through the dataset needs to keep
+static inline size_t UHDF_chunksPerSlab( const std::vector<size_t> &dimensions,
+                                         const std::vector<size_t> &chunkDimensions)
+{
+    size_t chunks = 1;
+    for (size_t i = 1; i < chunkDimensions.size(); i++)
+    {
+        const size_t chunkLength = std::max<size_t>(1, chunkDimensions[i]);
+        chunks *= std::max<size_t>(1, (dimensions[i] + chunkLength - 1) / chunkLength);
+    }
+    return chunks;
+}
+
+#endif // UHDF_CHUNKCACHE_H
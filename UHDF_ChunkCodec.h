@@ -0,0 +1,242 @@
+#ifndef UHDF_CHUNKCODEC_H
+#define UHDF_CHUNKCODEC_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include <zlib.h>
+
+#include "UHDF_Types.h"
+
+// Decoders for the filters HDF5 applies to chunks, so raw chunks fetched with H5Dread_chunk
+// can be decompressed outside the library, on as many threads as there are chunks.  Only
+// the filters built into every HDF5 install are handled: deflate, shuffle and fletcher32.
+
+// one stage of a dataset's filter pipeline, in the order it was applied when writing
+struct UHDF_ChunkFilter
+{
+    H5Z_filter_t id;
+    std::vector<unsigned> values;
+};
+
+// one chunk as stored in the file, before decoding
+struct UHDF_RawChunk
+{
+    UHDF_RawChunk() :
+        allocated (false),
+        filterMask (0)
+    {}
+
+    std::vector<int32> origin;  // position of the chunk's first element in the dataset
+    bool allocated;             // false for chunks never written, which have no data
+    unsigned filterMask;
+    std::vector<char> data;
+};
+
+static inline bool UHDF_isDecodableFilter( const H5Z_filter_t filter)
+{
+    return filter == H5Z_FILTER_DEFLATE || filter == H5Z_FILTER_SHUFFLE || filter == H5Z_FILTER_FLETCHER32;
+}
+
+// the filter pipeline of a dataset creation property list; false if any stage of it can't
+// be decoded here
+static inline bool UHDF_getChunkFilters( const hid_t createPlist, std::vector<UHDF_ChunkFilter> &pipeline)
+{
+    pipeline.clear();
+
+    const int numFilters = H5Pget_nfilters(createPlist);
+    if (numFilters < 0)
+        return false;
+
+    for (int i = 0; i < numFilters; i++)
+    {
+        UHDF_ChunkFilter filter;
+        unsigned flags = 0;
+        size_t numValues = 8;
+        unsigned filterConfig = 0;
+        filter.values.resize(numValues);
+
+        filter.id = H5Pget_filter2(createPlist, i, &flags, &numValues, filter.values.data(), 0, NULL, &filterConfig);
+        if (filter.id < 0 || !UHDF_isDecodableFilter(filter.id))
+            return false;
+
+        filter.values.resize(std::min<size_t>(numValues, filter.values.size()));
+        pipeline.push_back(filter);
+    }
+
+    return true;
+}
+
+// HDF5's checksum: Fletcher's algorithm over big-endian 16-bit words
+static inline uint32_t UHDF_fletcher32( const unsigned char *data, const size_t numBytes)
+{
+    size_t words = numBytes / 2;
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+
+    while (words > 0)
+    {
+        // few enough words that neither sum can overflow before it's folded
+        size_t block = std::min<size_t>(words, 360);
+        words -= block;
+
+        for (; block > 0; block--)
+        {
+            sum1 += (static_cast<uint32_t>(data[0]) << 8) | data[1];
+            sum2 += sum1;
+            data += 2;
+        }
+
+        sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+        sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+    }
+
+    if (numBytes % 2)
+    {
+        sum1 += static_cast<uint32_t>(data[0]) << 8;
+        sum2 += sum1;
+        sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+        sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+    }
+
+    sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+    sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+
+    return (sum2 << 16) | sum1;
+}
+
+// checks and strips the little-endian checksum at the end of data
+static inline void UHDF_undoFletcher32( std::vector<char> &data, const std::string &datasetName)
+{
+    if (data.size() < 4)
+        throw UHDF_Exception("Chunk too short for its checksum in dataset '" + datasetName + "'");
+
+    const size_t numBytes = data.size() - 4;
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data.data());
+
+    const uint32_t stored = bytes[numBytes] | (bytes[numBytes + 1] << 8) |
+                            (static_cast<uint32_t>(bytes[numBytes + 2]) << 16) | (static_cast<uint32_t>(bytes[numBytes + 3]) << 24);
+    const uint32_t computed = UHDF_fletcher32(bytes, numBytes);
+
+    // files written before HDF5 1.6.3 have the bytes of each half swapped, and HDF5 still
+    // accepts them
+    const uint32_t swapped = ((computed & 0x00ff00ff) << 8) | ((computed >> 8) & 0x00ff00ff);
+
+    if (stored != computed && stored != swapped)
+        throw UHDF_Exception("Checksum mismatch in chunk of dataset '" + datasetName + "'");
+
+    data.resize(numBytes);
+}
+
+// zlib stream to output, which is grown if expectedBytes turns out too small
+static inline void UHDF_undoDeflate( const std::vector<char> &input,
+                                     std::vector<char> &output,
+                                     const size_t expectedBytes,
+                                     const std::string &datasetName)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = input.size();
+
+    if (inflateInit(&stream) != Z_OK)
+        throw UHDF_Exception("Error starting decompression of chunk in dataset '" + datasetName + "'");
+
+    output.resize(std::max<size_t>(expectedBytes, 1));
+    size_t produced = 0;
+
+    while (true)
+    {
+        stream.next_out = reinterpret_cast<Bytef*>(output.data() + produced);
+        stream.avail_out = output.size() - produced;
+
+        const int status = inflate(&stream, Z_NO_FLUSH);
+        produced = output.size() - stream.avail_out;
+
+        if (status == Z_STREAM_END)
+            break;
+
+        if ((status == Z_OK || status == Z_BUF_ERROR) && stream.avail_out == 0)
+        {
+            output.resize(output.size() * 2);
+            continue;
+        }
+
+        inflateEnd(&stream);
+        throw UHDF_Exception("Error decompressing chunk in dataset '" + datasetName + "'");
+    }
+
+    inflateEnd(&stream);
+    output.resize(produced);
+}
+
+// byte k of every element was stored together, all the first bytes then all the second
+// bytes and so on; trailing bytes that don't make a whole element were left as they were
+static inline void UHDF_undoShuffle( const std::vector<char> &input,
+                                     std::vector<char> &output,
+                                     const size_t elementSize)
+{
+    output.resize(input.size());
+
+    const size_t numElements = (elementSize > 0) ? input.size() / elementSize : 0;
+    if (elementSize <= 1 || numElements <= 1)
+    {
+        memcpy(output.data(), input.data(), input.size());
+        return;
+    }
+
+    for (size_t k = 0; k < elementSize; k++)
+    {
+        const char *in = input.data() + k * numElements;
+        char *out = output.data() + k;
+
+        for (size_t e = 0; e < numElements; e++)
+            out[e * elementSize] = in[e];
+    }
+
+    const size_t whole = numElements * elementSize;
+    memcpy(output.data() + whole, input.data() + whole, input.size() - whole);
+}
+
+// Runs the pipeline backwards over one raw chunk, leaving chunkBytes decoded bytes in
+// data.  Stage i is skipped if bit i of filterMask is set, which is how HDF5 marks stages
+// that weren't applied to that chunk.  scratch is only working space.
+static inline void UHDF_decodeChunk( const std::vector<UHDF_ChunkFilter> &pipeline,
+                                     const unsigned filterMask,
+                                     const size_t chunkBytes,
+                                     const size_t elementSize,
+                                     std::vector<char> &data,
+                                     std::vector<char> &scratch,
+                                     const std::string &datasetName)
+{
+    for (size_t i = pipeline.size(); i-- > 0; )
+    {
+        if (filterMask & (1u << i))
+            continue;
+
+        switch (pipeline[i].id)
+        {
+        case H5Z_FILTER_FLETCHER32:
+            UHDF_undoFletcher32(data, datasetName);
+            break;
+        case H5Z_FILTER_DEFLATE:
+            // the checksum may have been added before compressing
+            UHDF_undoDeflate(data, scratch, chunkBytes + 4, datasetName);
+            data.swap(scratch);
+            break;
+        case H5Z_FILTER_SHUFFLE:
+            UHDF_undoShuffle(data, scratch, pipeline[i].values.empty() ? elementSize : pipeline[i].values[0]);
+            data.swap(scratch);
+            break;
+        default:
+            throw UHDF_Exception("Can't decode chunk filter of dataset '" + datasetName + "'");
+        }
+    }
+
+    if (data.size() != chunkBytes)
+        throw UHDF_Exception("Decoded chunk is the wrong size in dataset '" + datasetName + "'");
+}
+
+#endif // UHDF_CHUNKCODEC_H
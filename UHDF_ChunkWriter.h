@@ -0,0 +1,313 @@
+#ifndef UHDF_CHUNKWRITER_H
+#define UHDF_CHUNKWRITER_H
+
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "UHDF_Types.h"
+#include "UHDF_Tile.h"
+#include "UHDF_Dataset.h"
+
+// most memory a UHDF_ChunkWriter holds in incomplete chunks before writing some out
+static const size_t UHDF_DEFAULT_WRITE_BUFFER_BYTES = 64 * 1024 * 1024;
+
+// Write-behind buffer for a dataset written in many small pieces.  Writes are collected
+// into whole chunks (tiles, for datasets that aren't chunked), and each chunk is written in
+// one call as soon as every element of it has been given, so a compressed chunk is
+// compressed once instead of once per piece.  Chunks still incomplete when the buffer is
+// full, or at flush(), are written as just the elements they hold, in as few boxes as
+// cover them.
+//
+// The destructor flushes, but can't report errors, so call flush() when done writing.
+// The dataset must outlive the writer.
+template<typename T>
+class UHDF_ChunkWriter
+{
+public:
+    UHDF_ChunkWriter( const UHDF_Dataset &writeDataset, const size_t maxBufferBytes = UHDF_DEFAULT_WRITE_BUFFER_BYTES) :
+        dataset (writeDataset),
+        dimensions (writeDataset.getDimensions()),
+        tileDimensions (writeDataset.getTileDimensions()),
+        maxBytes (maxBufferBytes),
+        bufferedBytes (0),
+        useCounter (0)
+    {
+        if (dimensions.empty())
+            throw UHDF_Exception("Can't buffer writes to scalar dataset '" + dataset.getName() + "'");
+    }
+
+    ~UHDF_ChunkWriter()
+    {
+        try
+        {
+            flush();
+        }
+        catch (const UHDF_Exception &)
+        {
+        }
+    }
+
+    UHDF_ChunkWriter( const UHDF_ChunkWriter &) = delete;
+    UHDF_ChunkWriter &operator=( const UHDF_ChunkWriter &) = delete;
+
+    // buffer holds the selection packed in row-major order, as for UHDF_Dataset::write
+    void write( const int32 *const start,
+                const int32 *const count,
+                const T* buffer)
+    {
+        const size_t rank = dimensions.size();
+        const std::vector<int32> writeStart(start, start + rank);
+        const std::vector<int32> writeCount(count, count + rank);
+
+        for (const UHDF_Tile &tile : dataset.tiles(writeStart, writeCount))
+        {
+            const size_t key = chunkKey(tile);
+            PendingChunk &chunk = getChunk(key, tile);
+            chunk.lastUse = useCounter++;
+
+            copyTile(tile, start, count, buffer, chunk);
+
+            if (chunk.numWritten == chunk.values.size())
+                writeChunk(pending.find(key));
+        }
+
+        while (bufferedBytes > maxBytes && !pending.empty())
+            writeChunk(leastRecentlyUsed());
+    }
+
+    // writes every buffered chunk, complete or not
+    void flush()
+    {
+        while (!pending.empty())
+            writeChunk(pending.begin());
+    }
+
+    size_t getNumPendingChunks() const
+    {
+        return pending.size();
+    }
+
+private:
+    struct PendingChunk
+    {
+        std::vector<int32> start;
+        std::vector<int32> count;
+        std::vector<T> values;
+        std::vector<bool> written;
+        size_t numWritten;
+        uint64_t lastUse;
+    };
+
+    typedef typename std::map<size_t, PendingChunk>::iterator ChunkIterator;
+
+    const UHDF_Dataset &dataset;
+    std::vector<size_t> dimensions;
+    std::vector<size_t> tileDimensions;
+    size_t maxBytes;
+    size_t bufferedBytes;
+    uint64_t useCounter;
+
+    // keyed by the chunk's position in row-major order
+    std::map<size_t, PendingChunk> pending;
+
+    size_t chunkKey( const UHDF_Tile &tile) const
+    {
+        size_t key = 0;
+        for (size_t i = 0; i < dimensions.size(); i++)
+        {
+            const size_t chunksAlong = (dimensions[i] + tileDimensions[i] - 1) / tileDimensions[i];
+            key = key * chunksAlong + tile.getStart()[i] / tileDimensions[i];
+        }
+        return key;
+    }
+
+    PendingChunk &getChunk( const size_t key, const UHDF_Tile &tile)
+    {
+        const ChunkIterator found = pending.find(key);
+        if (found != pending.end())
+            return found->second;
+
+        PendingChunk &chunk = pending[key];
+        size_t elems = 1;
+        for (size_t i = 0; i < dimensions.size(); i++)
+        {
+            const size_t chunkStart = (tile.getStart()[i] / tileDimensions[i]) * tileDimensions[i];
+            chunk.start.push_back(chunkStart);
+            chunk.count.push_back(std::min(tileDimensions[i], dimensions[i] - chunkStart));
+            elems *= chunk.count.back();
+        }
+
+        chunk.values.resize(elems);
+        chunk.written.assign(elems, false);
+        chunk.numWritten = 0;
+        bufferedBytes += elems * sizeof(T);
+
+        return chunk;
+    }
+
+    // copies the part of the packed selection inside tile into the chunk holding it
+    void copyTile( const UHDF_Tile &tile,
+                   const int32 *const start,
+                   const int32 *const count,
+                   const T* buffer,
+                   PendingChunk &chunk)
+    {
+        const int rank = dimensions.size();
+        const int last = rank - 1;
+        const std::vector<int32> &tileStart = tile.getStart();
+        const std::vector<int32> &tileCount = tile.getCount();
+
+        std::vector<int32> index(rank, 0);
+
+        while (true)
+        {
+            size_t in = 0;
+            size_t out = 0;
+            for (int i = 0; i < rank; i++)
+            {
+                const size_t position = tileStart[i] + index[i];
+                in = in * count[i] + (position - start[i]);
+                out = out * chunk.count[i] + (position - chunk.start[i]);
+            }
+
+            for (int32 k = 0; k < tileCount[last]; k++)
+            {
+                chunk.values[out + k] = buffer[in + k];
+                if (!chunk.written[out + k])
+                {
+                    chunk.written[out + k] = true;
+                    chunk.numWritten++;
+                }
+            }
+
+            int dim = last - 1;
+            while (dim >= 0 && ++index[dim] >= tileCount[dim])
+                index[dim--] = 0;
+            if (dim < 0)
+                break;
+        }
+    }
+
+    ChunkIterator leastRecentlyUsed()
+    {
+        ChunkIterator oldest = pending.begin();
+        for (ChunkIterator iter = pending.begin(); iter != pending.end(); ++iter)
+        {
+            if (iter->second.lastUse < oldest->second.lastUse)
+                oldest = iter;
+        }
+        return oldest;
+    }
+
+    void writeChunk( const ChunkIterator iter)
+    {
+        const PendingChunk &chunk = iter->second;
+
+        if (chunk.numWritten == chunk.values.size())
+            dataset.write(chunk.start.data(), chunk.count.data(), chunk.values.data());
+        else
+            writeRuns(chunk);
+
+        bufferedBytes -= chunk.values.size() * sizeof(T);
+        pending.erase(iter);
+    }
+
+    // Writes the given elements of the chunk, leaving the rest of it as it is in the file,
+    // in as few boxes as it can: neighbouring slices along a dimension that hold the same
+    // pattern of given elements are written together, so rows given in full next to each
+    // other go in one call.
+    void writeRuns( const PendingChunk &chunk)
+    {
+        std::vector<int32> boxStart(chunk.start);
+        std::vector<int32> boxCount(dimensions.size(), 1);
+        std::vector<T> boxValues;
+        writeBoxes(chunk, 0, 0, boxStart, boxCount, boxValues);
+    }
+
+    // boxes of the slice of the chunk from element sliceOffset, along dimension dim and
+    // faster; boxStart and boxCount already hold the box along the slower dimensions
+    void writeBoxes( const PendingChunk &chunk,
+                     const int dim,
+                     const size_t sliceOffset,
+                     std::vector<int32> &boxStart,
+                     std::vector<int32> &boxCount,
+                     std::vector<T> &boxValues)
+    {
+        const int last = dimensions.size() - 1;
+        const size_t length = chunk.count[dim];
+
+        if (dim == last)
+        {
+            size_t k = 0;
+            while (k < length)
+            {
+                if (!chunk.written[sliceOffset + k])
+                {
+                    k++;
+                    continue;
+                }
+
+                const size_t first = k;
+                while (k < length && chunk.written[sliceOffset + k])
+                    k++;
+
+                boxStart[last] = chunk.start[last] + first;
+                boxCount[last] = k - first;
+                writeBox(chunk, boxStart, boxCount, boxValues);
+            }
+            return;
+        }
+
+        size_t sliceElems = 1;
+        for (int i = dim + 1; i <= last; i++)
+            sliceElems *= chunk.count[i];
+
+        size_t k = 0;
+        while (k < length)
+        {
+            const auto first = chunk.written.begin() + sliceOffset + k * sliceElems;
+
+            size_t same = 1;
+            while (k + same < length && std::equal(first, first + sliceElems, first + same * sliceElems))
+                same++;
+
+            boxStart[dim] = chunk.start[dim] + k;
+            boxCount[dim] = same;
+            writeBoxes(chunk, dim + 1, sliceOffset + k * sliceElems, boxStart, boxCount, boxValues);
+            k += same;
+        }
+    }
+
+    // gathers one box out of the chunk and writes it
+    void writeBox( const PendingChunk &chunk,
+                   const std::vector<int32> &boxStart,
+                   const std::vector<int32> &boxCount,
+                   std::vector<T> &boxValues)
+    {
+        const int rank = dimensions.size();
+        const int last = rank - 1;
+
+        boxValues.clear();
+        std::vector<int32> index(rank, 0);
+
+        while (true)
+        {
+            size_t offset = 0;
+            for (int i = 0; i < rank; i++)
+                offset = offset * chunk.count[i] + (boxStart[i] - chunk.start[i] + index[i]);
+
+            boxValues.insert(boxValues.end(), chunk.values.begin() + offset, chunk.values.begin() + offset + boxCount[last]);
+
+            int dim = last - 1;
+            while (dim >= 0 && ++index[dim] >= boxCount[dim])
+                index[dim--] = 0;
+            if (dim < 0)
+                break;
+        }
+
+        dataset.write(boxStart.data(), boxCount.data(), boxValues.data());
+    }
+};
+
+#endif // UHDF_CHUNKWRITER_H
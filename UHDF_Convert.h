@@ -0,0 +1,717 @@
+#ifndef UHDF_CONVERT_H
+#define UHDF_CONVERT_H
+
+#include <cstring>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include "UHDF_Types.h"
+
+// Conversion engine used by every read that returns a type other than the one stored in
+// the file, for both HDF4 and HDF5.  Values that don't fit in the output type saturate:
+//   - integers are clamped to the range of the output type
+//   - floating point values are truncated toward zero and clamped when converted to an
+//     integer type, and NaN becomes 0
+//   - finite doubles outside the range of float become +/-FLT_MAX, infinities and NaN
+//     are preserved
+// Widening conversions of the common types use SSE2/AVX2 kernels on x86, picked at runtime.
+// Define UHDF_NO_SIMD to always use the scalar loops.
+
+#if !defined(UHDF_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__SSE2__))
+#define UHDF_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// data is converted in blocks of about this size, so each block is still in cache when converted
+static const size_t UHDF_CONVERT_BLOCK_BYTES = 256 * 1024;
+
+//--------------------------------
+
+template<typename FROM, typename TO,
+         bool FROM_FLOAT = std::is_floating_point<FROM>::value,
+         bool TO_FLOAT = std::is_floating_point<TO>::value>
+struct UHDF_SaturateCast;
+
+// integer -> integer
+template<typename FROM, typename TO>
+struct UHDF_SaturateCast<FROM, TO, false, false>
+{
+    static inline TO apply( const FROM v)
+    {
+        typedef std::numeric_limits<TO> lim;
+
+        if (std::is_signed<FROM>::value)
+        {
+            const int64_t x = static_cast<int64_t>(v);
+            if (std::is_signed<TO>::value)
+            {
+                if (x < static_cast<int64_t>(lim::min()))
+                    return lim::min();
+                if (x > static_cast<int64_t>(lim::max()))
+                    return lim::max();
+            }
+            else
+            {
+                if (x < 0)
+                    return 0;
+                if (static_cast<uint64_t>(x) > static_cast<uint64_t>(lim::max()))
+                    return lim::max();
+            }
+        }
+        else
+        {
+            if (static_cast<uint64_t>(v) > static_cast<uint64_t>(lim::max()))
+                return lim::max();
+        }
+
+        return static_cast<TO>(v);
+    }
+};
+
+// floating point -> integer
+template<typename FROM, typename TO>
+struct UHDF_SaturateCast<FROM, TO, true, false>
+{
+    static inline TO apply( const FROM v)
+    {
+        typedef std::numeric_limits<TO> lim;
+
+        if (v != v)
+            return 0;
+        if (v <= static_cast<FROM>(lim::min()))
+            return lim::min();
+        if (v >= static_cast<FROM>(lim::max()))
+            return lim::max();
+
+        return static_cast<TO>(v);
+    }
+};
+
+// integer -> floating point, never out of range
+template<typename FROM, typename TO>
+struct UHDF_SaturateCast<FROM, TO, false, true>
+{
+    static inline TO apply( const FROM v)
+    {
+        return static_cast<TO>(v);
+    }
+};
+
+// floating point -> floating point
+template<typename FROM, typename TO>
+struct UHDF_SaturateCast<FROM, TO, true, true>
+{
+    static inline TO apply( const FROM v)
+    {
+        typedef std::numeric_limits<TO> lim;
+
+        if (sizeof(TO) < sizeof(FROM))
+        {
+            if (v > static_cast<FROM>(lim::max()))
+                return (v == std::numeric_limits<FROM>::infinity()) ? lim::infinity() : lim::max();
+            if (v < -static_cast<FROM>(lim::max()))
+                return (v == -std::numeric_limits<FROM>::infinity()) ? -lim::infinity() : -lim::max();
+        }
+
+        return static_cast<TO>(v);
+    }
+};
+
+template<typename FROM, typename TO>
+static inline TO UHDF_saturate( const FROM v)
+{
+    return UHDF_SaturateCast<FROM, TO>::apply(v);
+}
+
+//--------------------------------
+
+#ifdef UHDF_HAVE_X86_SIMD
+
+static inline bool UHDF_cpuHasAVX2()
+{
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    return hasAVX2;
+}
+
+// loads of 4 (SSE2) or 8 (AVX2) integers, widened to 32 bits
+template<typename FROM>
+struct UHDF_SimdLoad;
+
+template<>
+struct UHDF_SimdLoad<uint8_t>
+{
+    static const size_t WIDTH_SSE2 = 4;
+    static const size_t WIDTH_AVX2 = 8;
+
+    static inline __m128i sse2( const uint8_t *in)
+    {
+        int32_t packed;
+        memcpy(&packed, in, sizeof(packed));
+        const __m128i zero = _mm_setzero_si128();
+        return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i avx2( const uint8_t *in)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)));
+    }
+};
+
+template<>
+struct UHDF_SimdLoad<int8_t>
+{
+    static const size_t WIDTH_SSE2 = 4;
+    static const size_t WIDTH_AVX2 = 8;
+
+    static inline __m128i sse2( const int8_t *in)
+    {
+        int32_t packed;
+        memcpy(&packed, in, sizeof(packed));
+        const __m128i x = _mm_cvtsi32_si128(packed);
+        const __m128i x16 = _mm_unpacklo_epi8(x, x);
+        return _mm_srai_epi32(_mm_unpacklo_epi16(x16, x16), 24);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i avx2( const int8_t *in)
+    {
+        return _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)));
+    }
+};
+
+template<>
+struct UHDF_SimdLoad<uint16_t>
+{
+    static const size_t WIDTH_SSE2 = 4;
+    static const size_t WIDTH_AVX2 = 8;
+
+    static inline __m128i sse2( const uint16_t *in)
+    {
+        const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+        return _mm_unpacklo_epi16(x, _mm_setzero_si128());
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i avx2( const uint16_t *in)
+    {
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+    }
+};
+
+template<>
+struct UHDF_SimdLoad<int16_t>
+{
+    static const size_t WIDTH_SSE2 = 4;
+    static const size_t WIDTH_AVX2 = 8;
+
+    static inline __m128i sse2( const int16_t *in)
+    {
+        const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+        return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i avx2( const int16_t *in)
+    {
+        return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+    }
+};
+
+template<>
+struct UHDF_SimdLoad<int32_t>
+{
+    static const size_t WIDTH_SSE2 = 4;
+    static const size_t WIDTH_AVX2 = 8;
+
+    static inline __m128i sse2( const int32_t *in)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i avx2( const int32_t *in)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+    }
+};
+
+// stores of widened 32-bit integers as float or double
+template<typename TO>
+struct UHDF_SimdStore;
+
+template<>
+struct UHDF_SimdStore<float>
+{
+    static inline void sse2( float *out, const __m128i v)
+    {
+        _mm_storeu_ps(out, _mm_cvtepi32_ps(v));
+    }
+
+    __attribute__((target("avx2")))
+    static inline void avx2( float *out, const __m256i v)
+    {
+        _mm256_storeu_ps(out, _mm256_cvtepi32_ps(v));
+    }
+};
+
+template<>
+struct UHDF_SimdStore<double>
+{
+    static inline void sse2( double *out, const __m128i v)
+    {
+        _mm_storeu_pd(out, _mm_cvtepi32_pd(v));
+        _mm_storeu_pd(out + 2, _mm_cvtepi32_pd(_mm_srli_si128(v, 8)));
+    }
+
+    __attribute__((target("avx2")))
+    static inline void avx2( double *out, const __m256i v)
+    {
+        _mm256_storeu_pd(out, _mm256_cvtepi32_pd(_mm256_castsi256_si128(v)));
+        _mm256_storeu_pd(out + 4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)));
+    }
+};
+
+// each vector's loads happen before its stores, so in and out may be the same memory
+// as long as the output elements are no smaller than the input elements
+template<typename FROM, typename TO>
+static inline size_t UHDF_simdConvertSSE2( const FROM *in, TO *out, const size_t n)
+{
+    const size_t width = UHDF_SimdLoad<FROM>::WIDTH_SSE2;
+    size_t i = 0;
+    for (; i + width <= n; i += width)
+        UHDF_SimdStore<TO>::sse2(out + i, UHDF_SimdLoad<FROM>::sse2(in + i));
+    return i;
+}
+
+template<typename FROM, typename TO>
+__attribute__((target("avx2")))
+static size_t UHDF_simdConvertAVX2( const FROM *in, TO *out, const size_t n)
+{
+    const size_t width = UHDF_SimdLoad<FROM>::WIDTH_AVX2;
+    size_t i = 0;
+    for (; i + width <= n; i += width)
+        UHDF_SimdStore<TO>::avx2(out + i, UHDF_SimdLoad<FROM>::avx2(in + i));
+    return i;
+}
+
+// returns the number of elements converted; the caller finishes the remainder
+template<typename FROM, typename TO>
+static inline size_t UHDF_simdConvert( const FROM *in, TO *out, const size_t n)
+{
+    if (UHDF_cpuHasAVX2())
+        return UHDF_simdConvertAVX2(in, out, n);
+    return UHDF_simdConvertSSE2(in, out, n);
+}
+
+__attribute__((target("avx2")))
+static size_t UHDF_simdConvertFloatToDoubleAVX2( const float *in, double *out, const size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm_loadu_ps(in + i)));
+    return i;
+}
+
+static inline size_t UHDF_simdConvertFloatToDouble( const float *in, double *out, const size_t n)
+{
+    if (UHDF_cpuHasAVX2())
+        return UHDF_simdConvertFloatToDoubleAVX2(in, out, n);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 v = _mm_loadu_ps(in + i);
+        const __m128d lo = _mm_cvtps_pd(v);
+        const __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+        _mm_storeu_pd(out + i, lo);
+        _mm_storeu_pd(out + i + 2, hi);
+    }
+    return i;
+}
+
+#endif // UHDF_HAVE_X86_SIMD
+
+//--------------------------------
+
+// converts n values; in and out may alias when sizeof(TO) == sizeof(FROM)
+template<typename FROM, typename TO>
+struct UHDF_ConvertKernel
+{
+    static inline void convert( const FROM *in, TO *out, const size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+            out[i] = UHDF_saturate<FROM, TO>(in[i]);
+    }
+};
+
+#ifdef UHDF_HAVE_X86_SIMD
+
+template<typename FROM, typename TO>
+struct UHDF_SimdConvertKernel
+{
+    static inline void convert( const FROM *in, TO *out, const size_t n)
+    {
+        for (size_t i = UHDF_simdConvert(in, out, n); i < n; i++)
+            out[i] = static_cast<TO>(in[i]);
+    }
+};
+
+template<> struct UHDF_ConvertKernel<uint8_t, float> : UHDF_SimdConvertKernel<uint8_t, float> {};
+template<> struct UHDF_ConvertKernel<uint8_t, double> : UHDF_SimdConvertKernel<uint8_t, double> {};
+template<> struct UHDF_ConvertKernel<int8_t, float> : UHDF_SimdConvertKernel<int8_t, float> {};
+template<> struct UHDF_ConvertKernel<int8_t, double> : UHDF_SimdConvertKernel<int8_t, double> {};
+template<> struct UHDF_ConvertKernel<uint16_t, float> : UHDF_SimdConvertKernel<uint16_t, float> {};
+template<> struct UHDF_ConvertKernel<uint16_t, double> : UHDF_SimdConvertKernel<uint16_t, double> {};
+template<> struct UHDF_ConvertKernel<int16_t, float> : UHDF_SimdConvertKernel<int16_t, float> {};
+template<> struct UHDF_ConvertKernel<int16_t, double> : UHDF_SimdConvertKernel<int16_t, double> {};
+template<> struct UHDF_ConvertKernel<int32_t, float> : UHDF_SimdConvertKernel<int32_t, float> {};
+template<> struct UHDF_ConvertKernel<int32_t, double> : UHDF_SimdConvertKernel<int32_t, double> {};
+
+template<>
+struct UHDF_ConvertKernel<float, double>
+{
+    static inline void convert( const float *in, double *out, const size_t n)
+    {
+        for (size_t i = UHDF_simdConvertFloatToDouble(in, out, n); i < n; i++)
+            out[i] = in[i];
+    }
+};
+
+#endif // UHDF_HAVE_X86_SIMD
+
+template<typename FROM, typename TO>
+static inline void UHDF_convert( const FROM *in, TO *out, const size_t n)
+{
+    UHDF_ConvertKernel<FROM, TO>::convert(in, out, n);
+}
+
+// applies kernel(in, out, n), which turns n values of FROM into n values of TO, to the n
+// values at the start of buffer, in place; the output type must be at least as large as
+// the input type
+template<typename FROM, typename TO, typename KERNEL>
+static void UHDF_transformInPlace( void *buffer, const size_t n, KERNEL kernel)
+{
+    if (sizeof(TO) < sizeof(FROM))
+        throw UHDF_Exception("In-place conversion can't narrow");
+
+    TO *out = static_cast<TO*>(buffer);
+
+    if (sizeof(TO) == sizeof(FROM))
+    {
+        kernel(static_cast<const FROM*>(buffer), out, n);
+        return;
+    }
+
+    // walk backwards a block at a time; each block of input is copied aside before its
+    // output overwrites it, and the output never reaches the input of earlier blocks
+    const size_t blockElems = std::max<size_t>(1, UHDF_CONVERT_BLOCK_BYTES / sizeof(TO));
+    std::unique_ptr<FROM[]> block(new FROM[std::min(n, blockElems)]);
+
+    size_t end = n;
+    while (end > 0)
+    {
+        const size_t begin = (end > blockElems) ? end - blockElems : 0;
+        memcpy(block.get(), static_cast<const char*>(buffer) + begin * sizeof(FROM), (end - begin) * sizeof(FROM));
+        kernel(block.get(), out + begin, end - begin);
+        end = begin;
+    }
+}
+
+// converts n values of FROM at the start of buffer into n values of TO, in place
+template<typename FROM, typename TO>
+static void UHDF_convertInPlace( void *buffer, const size_t n)
+{
+    UHDF_transformInPlace<FROM, TO>(buffer, n, UHDF_convert<FROM, TO>);
+}
+
+//--------------------------------
+
+// Splits a hyperslab into blocks of about maxElements elements and calls
+//     fn(blockStart, blockStride, blockCount, blockOrigin)
+// for each one, where blockOrigin is where the block starts within the selection.  With
+// chunkDims (empty for unchunked data), no chunk is split between blocks along any
+// dimension, so each chunk is decoded or encoded once; a block is then at least one chunk
+// of the selection, however big that is.
+template<typename FUNC>
+static void UHDF_forEachBlock( const int rank,
+                               const int32 *const start,
+                               const int32 *const stride,
+                               const int32 *const count,
+                               const std::vector<size_t> &chunkDims,
+                               const size_t maxElements,
+                               FUNC fn)
+{
+    if (rank == 0)
+    {
+        fn(start, stride, count, start);
+        return;
+    }
+
+    // where blocks may start along each dimension, as selection indices: dimensions that
+    // fit whole aren't split, the first one that doesn't is cut into groups of chunks
+    // (or rows) that fit, and the ones above it into single chunks (or rows)
+    std::vector<std::vector<int32> > bounds(rank);
+    size_t elems = 1;
+    bool split = false;
+    for (int d = rank - 1; d >= 0; d--)
+    {
+        std::vector<int32> &b = bounds[d];
+        b.push_back(0);
+
+        if (!split && elems * count[d] <= maxElements)
+        {
+            elems *= count[d];
+            b.push_back(count[d]);
+            continue;
+        }
+
+        const size_t target = split ? 1 : std::max<size_t>(1, maxElements / elems);
+        split = true;
+
+        const size_t chunkLength = chunkDims.empty() ? 1 : std::max<size_t>(1, chunkDims[d]);
+        int32 groupStart = 0;
+        for (int32 k = 1; k < count[d]; k++)
+        {
+            const bool newChunk = (static_cast<size_t>(start[d]) + static_cast<size_t>(k) * stride[d]) / chunkLength !=
+                                  (static_cast<size_t>(start[d]) + static_cast<size_t>(k - 1) * stride[d]) / chunkLength;
+            if (newChunk && static_cast<size_t>(k - groupStart) >= target)
+            {
+                b.push_back(k);
+                groupStart = k;
+            }
+        }
+        b.push_back(count[d]);
+    }
+
+    std::vector<int32> blockStart(rank);
+    std::vector<int32> blockCount(rank);
+    std::vector<int32> blockOrigin(rank);
+    std::vector<size_t> index(rank, 0);
+
+    while (true)
+    {
+        for (int i = 0; i < rank; i++)
+        {
+            blockOrigin[i] = bounds[i][index[i]];
+            blockCount[i] = bounds[i][index[i] + 1] - blockOrigin[i];
+            blockStart[i] = start[i] + blockOrigin[i] * stride[i];
+        }
+
+        fn(blockStart.data(), stride, blockCount.data(), blockOrigin.data());
+
+        int dim = rank - 1;
+        while (dim >= 0 && ++index[dim] + 1 >= bounds[dim].size())
+            index[dim--] = 0;
+        if (dim < 0)
+            break;
+    }
+}
+
+// Calls fn(blockOffset, selectionOffset, n) for each run of a block (as given by
+// UHDF_forEachBlock) that is contiguous both in the packed block and in the packed selection.
+template<typename FUNC>
+static void UHDF_forEachBlockRun( const int rank,
+                                  const int32 *const count,
+                                  const int32 *const blockCount,
+                                  const int32 *const blockOrigin,
+                                  FUNC fn)
+{
+    if (rank == 0)
+    {
+        fn(0, 0, 1);
+        return;
+    }
+
+    std::vector<size_t> inner(rank, 1);
+    for (int i = rank - 1; i > 0; i--)
+        inner[i - 1] = inner[i] * count[i];
+
+    // dimensions from runDim down are whole in the block, apart from runDim itself
+    int runDim = rank - 1;
+    size_t runLength = blockCount[runDim];
+    while (runDim > 0 && blockCount[runDim] == count[runDim])
+    {
+        runDim--;
+        runLength *= blockCount[runDim];
+    }
+
+    std::vector<int32> index(runDim + 1, 0);
+    size_t blockOffset = 0;
+
+    while (true)
+    {
+        size_t selectionOffset = 0;
+        for (int i = 0; i <= runDim; i++)
+            selectionOffset += (blockOrigin[i] + index[i]) * inner[i];
+
+        fn(blockOffset, selectionOffset, runLength);
+        blockOffset += runLength;
+
+        int dim = runDim - 1;
+        while (dim >= 0 && ++index[dim] >= blockCount[dim])
+            index[dim--] = 0;
+        if (dim < 0)
+            break;
+    }
+}
+
+// the most elements in any block UHDF_forEachBlock makes
+static inline size_t UHDF_largestBlock( const int rank,
+                                        const int32 *const start,
+                                        const int32 *const stride,
+                                        const int32 *const count,
+                                        const std::vector<size_t> &chunkDims,
+                                        const size_t maxElements)
+{
+    size_t largest = 0;
+    UHDF_forEachBlock(rank, start, stride, count, chunkDims, maxElements,
+        [&](const int32 *, const int32 *, const int32 *blockCount, const int32 *)
+        {
+            size_t elems = 1;
+            for (int i = 0; i < rank; i++)
+                elems *= blockCount[i];
+            largest = std::max(largest, elems);
+        });
+    return largest;
+}
+
+// Reads a hyperslab with rawRead (which reads values in the file's type, FILE_T) and
+// turns it into values of MEM_T in buffer with kernel(in, out, n).  Widening kernels are
+// applied in place to data read straight into the caller's buffer; narrowing ones are
+// applied a block at a time, following the chunks in chunkDims (empty when the data isn't
+// chunked) so that no chunk is read, and decompressed, more than once.  Neither needs a
+// temporary the size of the selection.
+template<typename FILE_T, typename MEM_T, typename RAW_READ, typename KERNEL>
+static void UHDF_readTransformed( const int rank,
+                                  const int32 *const start,
+                                  const int32 *const stride,
+                                  const int32 *const count,
+                                  const std::vector<size_t> &chunkDims,
+                                  MEM_T *buffer,
+                                  RAW_READ rawRead,
+                                  KERNEL kernel)
+{
+    size_t numSelectedElements = 1;
+    for (int i = 0; i < rank; i++)
+    {
+        if (count[i] <= 0)
+            throw UHDF_Exception("Zero or negative count given when reading");
+
+        numSelectedElements *= count[i];
+    }
+
+    if (sizeof(MEM_T) >= sizeof(FILE_T))
+    {
+        rawRead(start, stride, count, static_cast<void*>(buffer));
+        UHDF_transformInPlace<FILE_T, MEM_T>(buffer, numSelectedElements, kernel);
+        return;
+    }
+
+    const size_t blockElems = std::max<size_t>(1, UHDF_CONVERT_BLOCK_BYTES / sizeof(FILE_T));
+    std::unique_ptr<FILE_T[]> block(new FILE_T[UHDF_largestBlock(rank, start, stride, count, chunkDims, blockElems)]);
+
+    UHDF_forEachBlock(rank, start, stride, count, chunkDims, blockElems,
+        [&](const int32 *blockStart, const int32 *blockStride, const int32 *blockCount, const int32 *blockOrigin)
+        {
+            rawRead(blockStart, blockStride, blockCount, static_cast<void*>(block.get()));
+            UHDF_forEachBlockRun(rank, count, blockCount, blockOrigin,
+                [&](const size_t blockOffset, const size_t selectionOffset, const size_t n)
+                {
+                    kernel(block.get() + blockOffset, buffer + selectionOffset, n);
+                });
+        });
+}
+
+// reads a hyperslab with rawRead and converts it from FILE_T into buffer
+template<typename FILE_T, typename MEM_T, typename RAW_READ>
+static void UHDF_readConverted( const int rank,
+                                const int32 *const start,
+                                const int32 *const stride,
+                                const int32 *const count,
+                                const std::vector<size_t> &chunkDims,
+                                MEM_T *buffer,
+                                RAW_READ rawRead)
+{
+    UHDF_readTransformed<FILE_T, MEM_T>(rank, start, stride, count, chunkDims, buffer, rawRead, UHDF_convert<FILE_T, MEM_T>);
+}
+
+// Converts buffer from MEM_T into FILE_T with kernel(in, out, n) a block at a time and
+// writes each block with rawWrite(start, stride, count, data), so writing in a type other
+// than the file's needs no temporary the size of the selection.  Blocks follow the chunks
+// in chunkDims as for UHDF_readTransformed, so no chunk is written, and compressed, twice.
+template<typename FILE_T, typename MEM_T, typename RAW_WRITE, typename KERNEL>
+static void UHDF_writeTransformed( const int rank,
+                                   const int32 *const start,
+                                   const int32 *const stride,
+                                   const int32 *const count,
+                                   const std::vector<size_t> &chunkDims,
+                                   const MEM_T *buffer,
+                                   RAW_WRITE rawWrite,
+                                   KERNEL kernel)
+{
+    for (int i = 0; i < rank; i++)
+    {
+        if (count[i] <= 0)
+            throw UHDF_Exception("Zero or negative count given when writing");
+    }
+
+    const size_t blockElems = std::max<size_t>(1, UHDF_CONVERT_BLOCK_BYTES / sizeof(FILE_T));
+    std::unique_ptr<FILE_T[]> block(new FILE_T[UHDF_largestBlock(rank, start, stride, count, chunkDims, blockElems)]);
+
+    UHDF_forEachBlock(rank, start, stride, count, chunkDims, blockElems,
+        [&](const int32 *blockStart, const int32 *blockStride, const int32 *blockCount, const int32 *blockOrigin)
+        {
+            UHDF_forEachBlockRun(rank, count, blockCount, blockOrigin,
+                [&](const size_t blockOffset, const size_t selectionOffset, const size_t n)
+                {
+                    kernel(buffer + selectionOffset, block.get() + blockOffset, n);
+                });
+            rawWrite(blockStart, blockStride, blockCount, static_cast<const void*>(block.get()));
+        });
+}
+
+template<typename FILE_T, typename MEM_T, typename RAW_WRITE>
+static void UHDF_writeConverted( const int rank,
+                                 const int32 *const start,
+                                 const int32 *const stride,
+                                 const int32 *const count,
+                                 const std::vector<size_t> &chunkDims,
+                                 const MEM_T *buffer,
+                                 RAW_WRITE rawWrite)
+{
+    UHDF_writeTransformed<FILE_T, MEM_T>(rank, start, stride, count, chunkDims, buffer, rawWrite, UHDF_convert<MEM_T, FILE_T>);
+}
+
+// same, for sources like attributes that can only be read all at once
+template<typename FILE_T, typename MEM_T, typename RAW_READ, typename KERNEL>
+static void UHDF_readTransformed( const size_t numElements,
+                                  MEM_T *buffer,
+                                  RAW_READ rawRead,
+                                  KERNEL kernel)
+{
+    if (sizeof(MEM_T) >= sizeof(FILE_T))
+    {
+        rawRead(static_cast<void*>(buffer));
+        UHDF_transformInPlace<FILE_T, MEM_T>(buffer, numElements, kernel);
+        return;
+    }
+
+    std::unique_ptr<FILE_T[]> unconverted(new FILE_T[numElements]);
+    rawRead(static_cast<void*>(unconverted.get()));
+    kernel(unconverted.get(), buffer, numElements);
+}
+
+template<typename FILE_T, typename MEM_T, typename RAW_READ>
+static void UHDF_readConverted( const size_t numElements,
+                                MEM_T *buffer,
+                                RAW_READ rawRead)
+{
+    UHDF_readTransformed<FILE_T, MEM_T>(numElements, buffer, rawRead, UHDF_convert<FILE_T, MEM_T>);
+}
+
+#endif // UHDF_CONVERT_H
@@ -0,0 +1,228 @@
+#ifndef UHDF_CREATE_H
+#define UHDF_CREATE_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include <boost/lexical_cast.hpp>
+
+#include "UHDF_Types.h"
+#include "UHDF_H5Holder.h"
+#include "UHDF_Convert.h"
+
+// How a new dataset is stored.  Compression, shuffle and checksums all need a chunk shape;
+// HDF4 has deflate but no shuffle or checksum filter.
+struct UHDF_DatasetOptions
+{
+    UHDF_DatasetOptions() :
+        deflateLevel (0),
+        shuffle (false),
+        checksum (false),
+        hasFillValue (false),
+        fillValue (0)
+    {}
+
+    std::vector<size_t> chunkDimensions;  // empty for contiguous storage
+    int deflateLevel;                     // 0 for none, 1 (fastest) to 9 (smallest)
+    bool shuffle;                         // byte shuffle before deflate, HDF5 only
+    bool checksum;                        // fletcher32 on every chunk, HDF5 only
+    bool hasFillValue;
+    double fillValue;                     // value of elements never written, converted to the dataset's type
+};
+
+static inline void UHDF_checkDatasetOptions( const UHDF_FileType format,
+                                             const std::string &datasetName,
+                                             const UHDF_DataType type,
+                                             const std::vector<size_t> &dims,
+                                             const UHDF_DatasetOptions &options)
+{
+    if (type == UHDF_STRING || type == UHDF_REFERENCE || type == UHDF_UNKNOWN)
+        throw UHDF_Exception("Can't create dataset '" + datasetName + "' of type " + UHDFTypeName(type));
+
+    if (dims.empty() || dims.size() > static_cast<size_t>(UHDF_MAX_RANK))
+        throw UHDF_Exception("Dataset '" + datasetName + "' needs between 1 and " + boost::lexical_cast<std::string>(UHDF_MAX_RANK) + " dimensions");
+
+    if (!options.chunkDimensions.empty())
+    {
+        if (options.chunkDimensions.size() != dims.size())
+            throw UHDF_Exception("Chunk shape doesn't match rank of dataset '" + datasetName + "'");
+
+        for (auto n : options.chunkDimensions)
+        {
+            if (n == 0)
+                throw UHDF_Exception("Zero chunk dimension given for dataset '" + datasetName + "'");
+        }
+    }
+    else if (options.deflateLevel > 0 || options.shuffle || options.checksum)
+    {
+        throw UHDF_Exception("Filters on dataset '" + datasetName + "' need a chunk shape");
+    }
+
+    if (options.deflateLevel < 0 || options.deflateLevel > 9)
+        throw UHDF_Exception("Deflate level for dataset '" + datasetName + "' must be from 0 to 9");
+
+    if (format == UHDF_HDF4 && (options.shuffle || options.checksum))
+        throw UHDF_Exception("HDF4 has no shuffle or checksum filter, for dataset '" + datasetName + "'");
+}
+
+// value converted to type, into out, which must hold one value of that type
+static inline void UHDF_castValue( const double value, const UHDF_DataType type, void *out)
+{
+    switch(type)
+    {
+    case UHDF_UINT8:
+        UHDF_convert(&value, static_cast<uint8_t*>(out), 1);
+        break;
+    case UHDF_INT8:
+        UHDF_convert(&value, static_cast<int8_t*>(out), 1);
+        break;
+    case UHDF_UINT16:
+        UHDF_convert(&value, static_cast<uint16_t*>(out), 1);
+        break;
+    case UHDF_INT16:
+        UHDF_convert(&value, static_cast<int16_t*>(out), 1);
+        break;
+    case UHDF_UINT32:
+        UHDF_convert(&value, static_cast<uint32_t*>(out), 1);
+        break;
+    case UHDF_INT32:
+        UHDF_convert(&value, static_cast<int32_t*>(out), 1);
+        break;
+    case UHDF_UINT64:
+        UHDF_convert(&value, static_cast<uint64_t*>(out), 1);
+        break;
+    case UHDF_INT64:
+        UHDF_convert(&value, static_cast<int64_t*>(out), 1);
+        break;
+    case UHDF_FLOAT32:
+        UHDF_convert(&value, static_cast<float*>(out), 1);
+        break;
+    case UHDF_FLOAT64:
+        UHDF_convert(&value, static_cast<double*>(out), 1);
+        break;
+    default:
+        throw UHDF_Exception("Can't convert a value to type " + UHDFTypeName(type));
+    }
+}
+
+// creates the dataset, with any missing groups along its path, and closes it again
+static inline void UHDF_createH5Dataset( const hid_t ownerId,
+                                         const std::string &datasetName,
+                                         const UHDF_DataType type,
+                                         const std::vector<size_t> &dims,
+                                         const UHDF_DatasetOptions &options)
+{
+    UHDF_checkDatasetOptions(UHDF_HDF5, datasetName, type, dims, options);
+
+    const int rank = dims.size();
+    hsize_t spaceDims[UHDF_MAX_RANK];
+    for (int i = 0; i < rank; i++)
+        spaceDims[i] = dims[i];
+
+    const UHDF_SpaceHolder space(H5Screate_simple(rank, spaceDims, NULL));
+    const UHDF_PlistHolder createPlist(H5Pcreate(H5P_DATASET_CREATE));
+    const UHDF_PlistHolder linkPlist(H5Pcreate(H5P_LINK_CREATE));
+
+    if (H5Pset_create_intermediate_group(linkPlist.get(), 1) < 0)
+        throw UHDF_Exception("Error setting up creation of dataset '" + datasetName + "'");
+
+    if (!options.chunkDimensions.empty())
+    {
+        hsize_t chunkDims[UHDF_MAX_RANK];
+        for (int i = 0; i < rank; i++)
+            chunkDims[i] = options.chunkDimensions[i];
+
+        if (H5Pset_chunk(createPlist.get(), rank, chunkDims) < 0)
+            throw UHDF_Exception("Error setting chunk shape of dataset '" + datasetName + "'");
+    }
+
+    // shuffle has to come before deflate, and the checksum after it, to do any good
+    if (options.shuffle && H5Pset_shuffle(createPlist.get()) < 0)
+        throw UHDF_Exception("Error setting shuffle filter on dataset '" + datasetName + "'");
+    if (options.deflateLevel > 0 && H5Pset_deflate(createPlist.get(), options.deflateLevel) < 0)
+        throw UHDF_Exception("Error setting deflate filter on dataset '" + datasetName + "'");
+    if (options.checksum && H5Pset_fletcher32(createPlist.get()) < 0)
+        throw UHDF_Exception("Error setting checksum filter on dataset '" + datasetName + "'");
+
+    if (options.hasFillValue)
+    {
+        uint64_t fill = 0;
+        UHDF_castValue(options.fillValue, type, &fill);
+        if (H5Pset_fill_value(createPlist.get(), UHDFTypeToH5(type), &fill) < 0)
+            throw UHDF_Exception("Error setting fill value of dataset '" + datasetName + "'");
+    }
+
+    const hid_t datasetId = H5Dcreate2(ownerId, datasetName.c_str(), UHDFTypeToH5(type), space.get(), linkPlist.get(), createPlist.get(), H5P_DEFAULT);
+    if (datasetId < 0)
+        throw UHDF_Exception("Couldn't create dataset '" + datasetName + "'");
+    H5Dclose(datasetId);
+}
+
+static inline void UHDF_createH5Group( const hid_t ownerId, const std::string &groupName)
+{
+    const UHDF_PlistHolder linkPlist(H5Pcreate(H5P_LINK_CREATE));
+    if (H5Pset_create_intermediate_group(linkPlist.get(), 1) < 0)
+        throw UHDF_Exception("Error setting up creation of group '" + groupName + "'");
+
+    const hid_t groupId = H5Gcreate2(ownerId, groupName.c_str(), linkPlist.get(), H5P_DEFAULT, H5P_DEFAULT);
+    if (groupId < 0)
+        throw UHDF_Exception("Couldn't create group '" + groupName + "'");
+    H5Gclose(groupId);
+}
+
+// creates the SDS and ends access to it again
+static inline void UHDF_createH4Dataset( const int32 fileId,
+                                         const std::string &datasetName,
+                                         const UHDF_DataType type,
+                                         const std::vector<size_t> &dims,
+                                         const UHDF_DatasetOptions &options)
+{
+    UHDF_checkDatasetOptions(UHDF_HDF4, datasetName, type, dims, options);
+
+    const int rank = dims.size();
+    int32 sdsDims[MAX_VAR_DIMS];
+    for (int i = 0; i < rank; i++)
+        sdsDims[i] = dims[i];
+
+    const int32 sdsId = SDcreate(fileId, datasetName.c_str(), UHDFTypeToH4(type), rank, sdsDims);
+    if (sdsId < 0)
+        throw UHDF_Exception("Couldn't create dataset '" + datasetName + "'");
+
+    intn status = SUCCEED;
+
+    // chunks are filled with the fill value set when the chunk layout is, so it goes first
+    if (options.hasFillValue)
+    {
+        uint64_t fill = 0;
+        UHDF_castValue(options.fillValue, type, &fill);
+        status = SDsetfillvalue(sdsId, &fill);
+    }
+
+    if (status != FAIL && !options.chunkDimensions.empty())
+    {
+        HDF_CHUNK_DEF chunkDef;
+        memset(&chunkDef, 0, sizeof(chunkDef));
+        int32 chunkFlags = HDF_CHUNK;
+
+        // chunk_lengths is at the start of every member of the union
+        for (int i = 0; i < rank; i++)
+            chunkDef.comp.chunk_lengths[i] = options.chunkDimensions[i];
+
+        if (options.deflateLevel > 0)
+        {
+            chunkFlags |= HDF_COMP;
+            chunkDef.comp.comp_type = COMP_CODE_DEFLATE;
+            chunkDef.comp.cinfo.deflate.level = options.deflateLevel;
+        }
+
+        status = SDsetchunk(sdsId, chunkDef, chunkFlags);
+    }
+
+    SDendaccess(sdsId);
+
+    if (status == FAIL)
+        throw UHDF_Exception("Error setting storage options of dataset '" + datasetName + "'");
+}
+
+#endif // UHDF_CREATE_H
@@ -3,6 +3,9 @@
 
 #include <string>
 #include <array>
+#include <type_traits>
+#include <deque>
+#include <utility>
 
 #include <boost/lexical_cast.hpp>
 #include <boost/multi_array.hpp>
@@ -10,11 +13,30 @@
 #include "UHDF_Types.h"
 #include "UHDF_H5Holder.h"
 #include "UHDF_Interfaces.h"
+#include "UHDF_Tile.h"
+#include "UHDF_Convert.h"
+#include "UHDF_ThreadPool.h"
+#include "UHDF_View.h"
+#include "UHDF_MappedView.h"
+#include "UHDF_AttributeMap.h"
+#include "UHDF_Reduce.h"
+#include "UHDF_Calibration.h"
+#include "UHDF_Selection.h"
+#include "UHDF_ChunkCodec.h"
+#include "UHDF_ChunkCache.h"
+#include "UHDF_IOStats.h"
+#include "UHDF_FileAccess.h"
+
+class UHDF_ProcessPool;
 
 class UHDF_Dataset// : public UHDF_AttributeHolder
 {
     friend class UHDF_File;
     friend class UHDF_Group;
+    friend class UHDF_ProcessPool;
+    friend class UHDF_DatasetCollection;
+    template<typename T> friend class UHDF_ReadPlan;
+    template<typename T, size_t RANK> friend class UHDF_TypedDataset;
 
 public:
     ~UHDF_Dataset()
@@ -30,6 +52,74 @@ public:
                 H5Dclose(id.h5id);
             break;
         }
+
+        if (ioCounters)
+            ioCounters->add(UHDF_IOCounters::CLOSES, 1);
+    }
+
+    // a handle owns its id, so it can be moved (into containers, or out of functions) but
+    // not copied; share() gives another handle on the same open dataset.  A handle that has
+    // been moved from can only be destroyed or assigned to
+    UHDF_Dataset( UHDF_Dataset &&other) noexcept :
+        UHDF_Dataset()
+    {
+        swap(other);
+    }
+
+    UHDF_Dataset &operator=( UHDF_Dataset &&other) noexcept
+    {
+        UHDF_Dataset moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    void swap( UHDF_Dataset &other) noexcept
+    {
+        std::swap(fileType, other.fileType);
+        std::swap(id, other.id);
+        std::swap(datasetname, other.datasetname);
+        std::swap(filename, other.filename);
+        std::swap(path, other.path);
+        std::swap(shapeInfo, other.shapeInfo);
+        std::swap(storageInfo, other.storageInfo);
+        std::swap(h4SdId, other.h4SdId);
+        std::swap(h4SdsIndex, other.h4SdsIndex);
+        std::swap(libraryLock, other.libraryLock);
+        std::swap(chunkCache, other.chunkCache);
+        std::swap(chunkCacheBytes, other.chunkCacheBytes);
+        std::swap(attributeCache, other.attributeCache);
+        std::swap(ioCounters, other.ioCounters);
+        std::swap(readerPool, other.readerPool);
+        std::swap(access, other.access);
+        std::swap(accessOptions, other.accessOptions);
+    }
+
+    // another handle on the same open dataset, with its metadata copied rather than queried
+    // again.  HDF5 ids are reference counted by the library, so the dataset stays open until
+    // the last handle on it closes; HDF4 has no such count, so the SDS is selected again,
+    // which doesn't touch the file
+    UHDF_Dataset share() const
+    {
+        UHDF_Dataset handle(*this);
+
+        switch(fileType)
+        {
+        case UHDF_HDF4:
+            handle.id.h4id = SDselect(h4SdId, h4SdsIndex);
+            if (handle.id.h4id < 0)
+                throw UHDF_Exception("Couldn't share handle of dataset '" + datasetname + "'");
+            break;
+        case UHDF_HDF5:
+            if (H5Iinc_ref(id.h5id) < 0)
+            {
+                handle.id.h5id = -1;
+                throw UHDF_Exception("Couldn't share handle of dataset '" + datasetname + "'");
+            }
+            break;
+        }
+        ioCounters->add(UHDF_IOCounters::OPENS, 1);
+
+        return handle;
     }
 
     const std::string &getName() const
@@ -37,20 +127,31 @@ public:
         return datasetname;
     }
 
+    // full path of the dataset within its file
+    const std::string &getPath() const
+    {
+        return path;
+    }
+
+    const std::string &getFileName() const
+    {
+        return filename;
+    }
+
     const std::vector<size_t> &getDimensions() const
     {
-        return dimensions;
+        return shape().dimensions;
     }
 
     const size_t getRank() const
     {
-        return dimensions.size();
+        return shape().dimensions.size();
     }
 
     const size_t getNumElements() const
     {
         size_t elems = 1;
-        for (auto n : dimensions)
+        for (auto n : shape().dimensions)
         {
             elems *= n;
         }
@@ -59,7 +160,134 @@ public:
 
     const UHDF_DataType getType() const
     {
-        return dataType;
+        return shape().dataType;
+    }
+
+    UHDF_StorageLayout getLayout() const
+    {
+        return storage().layout;
+    }
+
+    bool isChunked() const
+    {
+        return storage().layout == UHDF_CHUNKED;
+    }
+
+    // empty unless the dataset is chunked
+    const std::vector<size_t> &getChunkDimensions() const
+    {
+        return storage().chunkDimensions;
+    }
+
+    // the natural unit of work: the chunk shape if chunked, otherwise blocks of whole
+    // rows along the slowest dimension of about UHDF_DEFAULT_TILE_BYTES each
+    std::vector<size_t> getTileDimensions() const
+    {
+        if (storage().layout == UHDF_CHUNKED)
+            return storage().chunkDimensions;
+
+        std::vector<size_t> tileDims(shape().dimensions);
+        if (tileDims.empty())
+            return tileDims;
+
+        size_t rowBytes = (shape().dataType == UHDF_UNKNOWN || shape().dataType == UHDF_REFERENCE) ? 1 : UHDFTypeSize(shape().dataType);
+        for (size_t i = 1; i < tileDims.size(); i++)
+        {
+            if (tileDims[i] == 0)
+                tileDims[i] = 1;
+            rowBytes *= tileDims[i];
+        }
+
+        tileDims[0] = std::max<size_t>(1, std::min<size_t>(shape().dimensions[0], UHDF_DEFAULT_TILE_BYTES / rowBytes));
+        return tileDims;
+    }
+
+    // iterate over the whole dataset in chunk-aligned tiles, so each chunk is decoded once
+    UHDF_TileRange tiles() const
+    {
+        std::vector<int32> start(shape().rank, 0);
+        std::vector<int32> count(shape().dimensions.begin(), shape().dimensions.end());
+
+        return tiles(start, count);
+    }
+
+    // iterate over a region of the dataset, split on chunk boundaries
+    UHDF_TileRange tiles( const std::vector<int32> &start,
+                          const std::vector<int32> &count) const
+    {
+        if (start.size() != static_cast<size_t>(shape().rank) || count.size() != static_cast<size_t>(shape().rank))
+            throw UHDF_Exception("When tiling, provided dimensions don't match rank of dataset '" + datasetname + "'");
+
+        for (int i = 0; i < shape().rank; i++)
+        {
+            if (start[i] < 0 || count[i] < 0 || static_cast<size_t>(start[i]) + count[i] > shape().dimensions[i])
+                throw UHDF_Exception("When tiling, region is out of bounds of dataset '" + datasetname + "'");
+        }
+
+        return UHDF_TileRange(UHDF_TileGrid(getTileDimensions(), start, count));
+    }
+
+    // Sets how much decoded chunk data this handle keeps, see UHDF_ChunkCache.  Datasets
+    // that aren't chunked have no chunk cache, and ignore this.  HDF5 only takes cache
+    // settings when a dataset is opened, so this reopens it, and the new cache only takes
+    // effect if no other handle has the dataset open, including the file's handle cache;
+    // UHDF_File::setChunkCache sets it for datasets before they're opened.
+    void setChunkCache( const UHDF_ChunkCache &cache)
+    {
+        chunkCache = cache;
+
+        if (storage().layout == UHDF_CHUNKED)
+            configureChunkCache();
+    }
+
+    // Reader processes for readParallel to use instead of threads (NULL for threads); see
+    // UHDF_ProcessPool.  UHDF_File::setReaderPool sets it for datasets before they're opened.
+    void setReaderPool( const std::shared_ptr<UHDF_ProcessPool> &pool)
+    {
+        readerPool = pool;
+    }
+
+    const std::shared_ptr<UHDF_ProcessPool> &getReaderPool() const
+    {
+        return readerPool;
+    }
+
+    const UHDF_ChunkCache &getChunkCache() const
+    {
+        return chunkCache;
+    }
+
+    // bytes of chunks the cache can hold right now; 0 if the dataset isn't chunked
+    size_t getChunkCacheBytes() const
+    {
+        if (storage().layout != UHDF_CHUNKED)
+            return 0;
+
+        if (fileType == UHDF_HDF5 && chunkCacheBytes == 0)
+        {
+            size_t numSlots;
+            size_t numBytes = 0;
+            double preemption;
+            const UHDF_PlistHolder accessPlist(H5Dget_access_plist(id.h5id));
+            if (H5Pget_chunk_cache(accessPlist.get(), &numSlots, &numBytes, &preemption) < 0)
+                throw UHDF_Exception("Error getting chunk cache of HDF5 dataset '" + datasetname + "'");
+            return numBytes;
+        }
+
+        return chunkCacheBytes;
+    }
+
+    // I/O done through every handle on this dataset opened from the same file handle,
+    // including the workers of parallel reads; see UHDF_IOStatistics
+    UHDF_IOStatistics getIOStatistics() const
+    {
+        return ioCounters->snapshot();
+    }
+
+    // the file's totals are left alone
+    void resetIOStatistics() const
+    {
+        ioCounters->reset();
     }
 
     void rawRead( const int32 *const start,
@@ -67,11 +295,20 @@ public:
                   const int32 *const count,
                   void *buffer) const
     {
-        if (dataType == UHDF_UNKNOWN)
+        if (shape().dataType == UHDF_UNKNOWN)
         {
             throw UHDF_Exception("Can't read: unknown/unsupported datatype");
         }
 
+        std::unique_lock<std::recursive_mutex> guard;
+        if (libraryLock != NULL)
+            guard = std::unique_lock<std::recursive_mutex>(*libraryLock);
+
+        fitChunkCache(stride, count);
+
+        countRead(getSelectionSize(count));
+        const UHDF_IOTimer timer(*ioCounters, UHDF_IOCounters::LIBRARY_NANOSECONDS);
+
         switch(fileType)
         {
         case UHDF_HDF4:
@@ -82,27 +319,27 @@ public:
         }
         case UHDF_HDF5:
         {
-            const UHDF_SpaceHolder fileSpaceId(H5Scopy(H5Dget_space(id.h5id)));
+            const UHDF_SpaceHolder fileSpaceId(H5Dget_space(id.h5id));
 
-            if (sizeof(hsize_t) == sizeof(int32))
-            {
-                H5Sselect_hyperslab(fileSpaceId.get(), H5S_SELECT_SET, (hsize_t*)start, (hsize_t*)stride, (hsize_t*)count, NULL);
-            }
-            else
+            if (shape().rank > 0)
             {
-                std::unique_ptr<hsize_t[]> hstart(new hsize_t[rank]);
-                std::unique_ptr<hsize_t[]> hstride(new hsize_t[rank]);
-                std::unique_ptr<hsize_t[]> hcount(new hsize_t[rank]);
-                for (size_t i = 0; i < rank; i++)
+                hsize_t hstart[UHDF_MAX_RANK];
+                hsize_t hstride[UHDF_MAX_RANK];
+                hsize_t hcount[UHDF_MAX_RANK];
+                for (int i = 0; i < shape().rank; i++)
                 {
                     hstart[i] = start[i];
                     hstride[i] = stride[i];
                     hcount[i] = count[i];
                 }
-                H5Sselect_hyperslab(fileSpaceId.get(), H5S_SELECT_SET, hstart.get(), hstride.get(), hcount.get(), NULL);
+
+                if (H5Sselect_hyperslab(fileSpaceId.get(), H5S_SELECT_SET, hstart, hstride, hcount, NULL) < 0)
+                    throw UHDF_Exception("Error selecting region to read from HDF5 dataset '" + datasetname + "'");
             }
 
-            if (H5Dread(id.h5id, UHDFTypeToH5(dataType), H5S_ALL, fileSpaceId.get(), H5P_DEFAULT, buffer) < 0)
+            const UHDF_SpaceHolder memSpaceId(createH5MemSpace(count));
+
+            if (H5Dread(id.h5id, UHDFTypeToH5(shape().dataType), memSpaceId.get(), fileSpaceId.get(), H5P_DEFAULT, buffer) < 0)
                 throw UHDF_Exception("Error reading HDF5 dataset '" + datasetname + "'");
             break;
         }
@@ -113,11 +350,11 @@ public:
                   const int32 *const count,
                   void *buffer) const
     {
-        std::unique_ptr<int32[]> stride(new int32[rank]);
-        for (size_t i = 0; i < rank; i++)
+        int32 stride[UHDF_MAX_RANK];
+        for (int i = 0; i < shape().rank; i++)
             stride[i] = 1;
 
-        rawRead( start, stride.get(), count, buffer);
+        rawRead( start, stride, count, buffer);
     }
 
     template<typename T>
@@ -126,80 +363,53 @@ public:
                const int32 *const count,
                T* buffer) const
     {
-        if (dataType == UHDF_UNKNOWN)
+        if (shape().dataType == UHDF_UNKNOWN)
         {
             throw UHDF_Exception("Can't read: unknown/unsupported datatype");
         }
 
-        switch(fileType)
-        {
-        case UHDF_HDF4:
-        {
-            const UHDF_DataType outputType = getUHDFType<T>();
-            if (dataType == outputType)
-            {  // no conversion needed
-                rawRead(start, stride, count, buffer);
-            }
-            else
-            {  // need to convert from the field's type to the return type
-                switch(dataType)
-                {
-                case UHDF_UINT8:
-                    convertH4<uint8, T>(start, stride, count, buffer);
-                    break;
-                case UHDF_INT8:
-                    convertH4<int8, T>(start, stride, count, buffer);
-                    break;
-                case UHDF_UINT16:
-                    convertH4<uint16, T>(start, stride, count, buffer);
-                    break;
-                case UHDF_INT16:
-                    convertH4<int16, T>(start, stride, count, buffer);
-                    break;
-                case UHDF_UINT32:
-                    convertH4<uint32, T>(start, stride, count, buffer);
-                    break;
-                case UHDF_INT32:
-                    convertH4<int32, T>(start, stride, count, buffer);
-                    break;
-                case UHDF_FLOAT32:
-                    convertH4<float, T>(start, stride, count, buffer);
-                    break;
-                case UHDF_FLOAT64:
-                    convertH4<double, T>(start, stride, count, buffer);
-                    break;
-                default:
-                    throw UHDF_Exception("Unsupported datatype when doing conversion in read of dataset '" + datasetname + "'");
-                }
-            }
-            break;
+        const UHDF_DataType outputType = getUHDFType<T>();
+        if (shape().dataType == outputType)
+        {  // no conversion needed
+            rawRead(start, stride, count, buffer);
+            return;
         }
-        case UHDF_HDF5:
-        {
-            const UHDF_SpaceHolder fileSpaceId(H5Scopy(H5Dget_space(id.h5id)));
-
-            if (sizeof(hsize_t) == sizeof(int32))
-            {
-                H5Sselect_hyperslab(fileSpaceId.get(), H5S_SELECT_SET, (hsize_t*)start, (hsize_t*)stride, (hsize_t*)count, NULL);
-            }
-            else
-            {
-                std::unique_ptr<hsize_t[]> hstart(new hsize_t[rank]);
-                std::unique_ptr<hsize_t[]> hstride(new hsize_t[rank]);
-                std::unique_ptr<hsize_t[]> hcount(new hsize_t[rank]);
-                for (size_t i = 0; i < rank; i++)
-                {
-                    hstart[i] = start[i];
-                    hstride[i] = stride[i];
-                    hcount[i] = count[i];
-                }
-                H5Sselect_hyperslab(fileSpaceId.get(), H5S_SELECT_SET, hstart.get(), hstride.get(), hcount.get(), NULL);
-            }
 
-            if (H5Dread(id.h5id, getH5Type<T>(), H5S_ALL, fileSpaceId.get(), H5P_DEFAULT, buffer) < 0)
-                throw UHDF_Exception("Error reading HDF5 dataset '" + datasetname + "'");
+        // need to convert from the field's type to the return type
+        switch(shape().dataType)
+        {
+        case UHDF_UINT8:
+            readConverted<uint8_t, T>(start, stride, count, buffer);
             break;
-        }
+        case UHDF_INT8:
+            readConverted<int8_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_UINT16:
+            readConverted<uint16_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_INT16:
+            readConverted<int16_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_UINT32:
+            readConverted<uint32_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_INT32:
+            readConverted<int32_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_UINT64:
+            readConverted<uint64_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_INT64:
+            readConverted<int64_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_FLOAT32:
+            readConverted<float, T>(start, stride, count, buffer);
+            break;
+        case UHDF_FLOAT64:
+            readConverted<double, T>(start, stride, count, buffer);
+            break;
+        default:
+            throw UHDF_Exception("Unsupported datatype when doing conversion in read of dataset '" + datasetname + "'");
         }
     }
 
@@ -208,8 +418,8 @@ public:
                const int32 *const count,
                T* buffer) const
     {
-        std::unique_ptr<int32[]> stride(new int32[rank]);
-        for (size_t i = 0; i < rank; i++)
+        int32 stride[UHDF_MAX_RANK];
+        for (int i = 0; i < shape().rank; i++)
             stride[i] = 1;
 
         read (start, stride, count, buffer);
@@ -220,24 +430,258 @@ public:
                                       const std::array<int32, DIMS> &stride,
                                       const std::array<int32, DIMS> &count) const
     {
-        if (dimensions.size() != DIMS)
+        if (shape().dimensions.size() != DIMS)
             throw UHDF_Exception("When reading, provided dimensions don't match dataset rank");
 
-        boost::multi_array<T, DIMS> output (boost::extents(count));
+        boost::multi_array<T, DIMS> output (count);
 
-        read( start.get(), stride.get(), count.get(), output.data());
+        read( start.data(), stride.data(), count.data(), output.data());
 
         return output;
     }
 
     template <typename T, size_t DIMS>
     boost::multi_array<T, DIMS> read( const std::array<int32, DIMS> &start,
-                                      const std::array<int32, DIMS> &count)
+                                      const std::array<int32, DIMS> &count) const
     {
         std::array<int32, DIMS> stride;
         stride.fill(1);
 
-        return read(start, stride, count);
+        return read<T, DIMS>(start, stride, count);
+    }
+
+    // reads into caller-owned memory, which must hold at least bufferSize elements
+    template <typename T>
+    void readInto( const int32 *const start,
+                   const int32 *const stride,
+                   const int32 *const count,
+                   T* buffer,
+                   const size_t bufferSize) const
+    {
+        if (getSelectionSize(count) > bufferSize)
+            throw UHDF_Exception("Buffer is too small for the selection read from dataset '" + datasetname + "'");
+
+        read (start, stride, count, buffer);
+    }
+
+    // reads into a reusable buffer, growing it only if needed, and returns a view of the
+    // result shaped like the selection
+    template <typename T>
+    UHDF_View<T> readInto( const int32 *const start,
+                           const int32 *const stride,
+                           const int32 *const count,
+                           UHDF_Buffer<T> &buffer) const
+    {
+        buffer.resize(getSelectionSize(count));
+        read (start, stride, count, buffer.data());
+
+        return buffer.view(std::vector<size_t>(count, count + shape().rank));
+    }
+
+    template <typename T>
+    UHDF_View<T> readAllInto( UHDF_Buffer<T> &buffer) const
+    {
+        std::vector<int32> start(shape().rank, 0);
+        std::vector<int32> stride(shape().rank, 1);
+        std::vector<int32> count(shape().dimensions.begin(), shape().dimensions.end());
+
+        return readInto(start.data(), stride.data(), count.data(), buffer);
+    }
+
+    template <typename T>
+    void read( const UHDF_Tile &tile,
+               T* buffer) const
+    {
+        if (tile.getRank() != static_cast<size_t>(shape().rank))
+            throw UHDF_Exception("When reading, tile rank doesn't match rank of dataset '" + datasetname + "'");
+
+        if (tile.getNumElements() == 0)
+            return;
+
+        read (tile.getStart().data(), tile.getCount().data(), buffer);
+    }
+
+    // Reads the values at numPoints points in one call.  coords holds rank coordinates per
+    // point, and the values land in buffer in the order the points were given.
+    template <typename T>
+    void readPoints( const int32 *const coords,
+                     const size_t numPoints,
+                     T* buffer) const
+    {
+        readSelection(coords, NULL, numPoints, buffer);
+    }
+
+    // Reads numBoxes boxes in one call.  starts and counts hold rank values per box; each
+    // box lands in buffer packed in row-major order, one after another in the order given,
+    // so buffer must hold the sum of the boxes' sizes.  Boxes may overlap.
+    template <typename T>
+    void readBoxes( const int32 *const starts,
+                    const int32 *const counts,
+                    const size_t numBoxes,
+                    T* buffer) const
+    {
+        if (counts == NULL)
+            throw UHDF_Exception("No box counts given when reading dataset '" + datasetname + "'");
+
+        readSelection(starts, counts, numBoxes, buffer);
+    }
+
+    // Reads a hyperslab on a pool of numThreads workers (0 = one per core).  What actually
+    // runs in parallel depends on the dataset:
+    //   - with a reader pool set, the selection is split between its processes, which do
+    //     everything in parallel, decompression included; each piece comes back through
+    //     shared memory and is copied into buffer (UHDF_ProcessPool::readShared avoids the
+    //     copy).  numThreads is ignored.
+    //   - compressed (filtered) chunked HDF5 datasets read with a stride of 1 go through
+    //     readChunksDirect: chunks are fetched still compressed under UHDF_libraryMutex(),
+    //     and decompressed and converted in parallel outside it.
+    //   - anything else (HDF4, contiguous or unfiltered HDF5, strided selections) is split
+    //     along its slowest dimension on chunk boundaries between workers that each open
+    //     their own handle on the file.  Their library calls, and any decompression inside
+    //     them, run one at a time under UHDF_libraryMutex(); only conversion and copying
+    //     into buffer overlap.  Files in memory are read on the calling thread alone.
+    // Defined in UHDF_File.h, since the workers need to reopen the file.
+    template<typename T>
+    void readParallel( const int32 *const start,
+                       const int32 *const stride,
+                       const int32 *const count,
+                       T* buffer,
+                       unsigned numThreads = 0) const;
+
+    template <typename T>
+    std::vector<T> readAllParallel( unsigned numThreads = 0) const;
+
+    // Reads a hyperslab of a chunked HDF5 dataset by fetching each chunk it touches still
+    // compressed, with H5Dread_chunk, and decoding and copying it into buffer on a pool of
+    // numThreads workers (0 = one per core).  Only the fetches go through the library, one
+    // at a time under UHDF_libraryMutex(); decompression runs outside it, so it uses every
+    // core even when HDF5 can't.  Datasets whose chunks can't be decoded here (see
+    // canReadChunksDirect) are read with readParallel instead.
+    template <typename T>
+    void readChunksDirect( const int32 *const start,
+                           const int32 *const count,
+                           T* buffer,
+                           unsigned numThreads = 0) const
+    {
+        if (!canReadChunksDirect())
+        {
+            const std::vector<int32> stride(shape().rank, 1);
+            readParallel(start, stride.data(), count, buffer, numThreads);
+            return;
+        }
+
+        switch(shape().dataType)
+        {
+        case UHDF_UINT8:
+            readChunksDirectAs<uint8_t>(start, count, buffer, numThreads);
+            break;
+        case UHDF_INT8:
+            readChunksDirectAs<int8_t>(start, count, buffer, numThreads);
+            break;
+        case UHDF_UINT16:
+            readChunksDirectAs<uint16_t>(start, count, buffer, numThreads);
+            break;
+        case UHDF_INT16:
+            readChunksDirectAs<int16_t>(start, count, buffer, numThreads);
+            break;
+        case UHDF_UINT32:
+            readChunksDirectAs<uint32_t>(start, count, buffer, numThreads);
+            break;
+        case UHDF_INT32:
+            readChunksDirectAs<int32_t>(start, count, buffer, numThreads);
+            break;
+        case UHDF_UINT64:
+            readChunksDirectAs<uint64_t>(start, count, buffer, numThreads);
+            break;
+        case UHDF_INT64:
+            readChunksDirectAs<int64_t>(start, count, buffer, numThreads);
+            break;
+        case UHDF_FLOAT32:
+            readChunksDirectAs<float>(start, count, buffer, numThreads);
+            break;
+        case UHDF_FLOAT64:
+            readChunksDirectAs<double>(start, count, buffer, numThreads);
+            break;
+        default:
+            throw UHDF_Exception("Can't read chunks of dataset '" + datasetname + "' of type " + UHDFTypeName(shape().dataType));
+        }
+    }
+
+    template <typename T>
+    std::vector<T> readAllChunksDirect( unsigned numThreads = 0) const
+    {
+        std::vector<T> buffer;
+
+        buffer.resize(getNumElements(), 0);
+        std::vector<int32> start(shape().rank, 0);
+        std::vector<int32> count(shape().dimensions.begin(), shape().dimensions.end());
+
+        readChunksDirect(start.data(), count.data(), buffer.data(), numThreads);
+        return buffer;
+    }
+
+    // true for chunked HDF5 datasets stored in the machine's native numeric type, with no
+    // filters other than deflate, shuffle and fletcher32
+    bool canReadChunksDirect() const
+    {
+#if H5_VERSION_GE(1,10,5)
+        std::vector<UHDF_ChunkFilter> pipeline;
+        return getDirectChunkPipeline(pipeline);
+#else
+        return false;
+#endif
+    }
+
+    // Streams the whole dataset through accumulator one tile at a time, in the dataset's own
+    // type, on numThreads workers (0 = one per core) that each hold one tile's worth of
+    // memory.  ACCUMULATOR needs add(const T*, size_t) for the dataset's type and
+    // merge(const ACCUMULATOR&), see UHDF_Reduce.h; each worker starts from a copy of
+    // initial, which shouldn't hold any values yet.  Partial results are merged in whatever
+    // order the workers finish, so floating-point totals can differ in their last bits from
+    // run to run.  Defined in UHDF_File.h, since the workers need to reopen the file.
+    template<typename ACCUMULATOR>
+    ACCUMULATOR reduce( const ACCUMULATOR &initial, unsigned numThreads = 0) const;
+
+    UHDF_Statistics computeStatistics( unsigned numThreads = 0) const
+    {
+        return reduce(UHDF_Statistics(), numThreads);
+    }
+
+    UHDF_Histogram computeHistogram( const double low, const double high, const size_t numBins, unsigned numThreads = 0) const
+    {
+        return reduce(UHDF_Histogram(low, high, numBins), numThreads);
+    }
+
+    // Reads a hyperslab on the I/O thread (UHDF_ioThread()) while the caller carries on, and
+    // returns a future that is ready once buffer is filled; read errors are rethrown from its
+    // get().  The dataset and buffer must outlive the read.  The read holds
+    // UHDF_libraryMutex(), so the caller must hold it too for any other library calls it
+    // makes before the future is ready.
+    template <typename T>
+    std::future<void> readAsync( const int32 *const start,
+                                 const int32 *const stride,
+                                 const int32 *const count,
+                                 T* buffer) const
+    {
+        const std::vector<int32> readStart(start, start + shape().rank);
+        const std::vector<int32> readStride(stride, stride + shape().rank);
+        const std::vector<int32> readCount(count, count + shape().rank);
+
+        return UHDF_ioThread().submit([this, readStart, readStride, readCount, buffer]()
+        {
+            std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+            read(readStart.data(), readStride.data(), readCount.data(), buffer);
+        });
+    }
+
+    template <typename T>
+    std::future<std::vector<T>> readAllAsync() const
+    {
+        return UHDF_ioThread().submit([this]()
+        {
+            std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+            return readAll<T>();
+        });
     }
 
     template <typename T>
@@ -246,194 +690,1341 @@ public:
         std::vector<T> buffer;
 
         buffer.resize(getNumElements(), 0);
-        std::unique_ptr<int32[]> start( new int32[rank]);
-        std::unique_ptr<int32[]> stride( new int32[rank]);
-        std::unique_ptr<int32[]> count( new int32[rank]);
+        std::unique_ptr<int32[]> start( new int32[shape().rank]);
+        std::unique_ptr<int32[]> stride( new int32[shape().rank]);
+        std::unique_ptr<int32[]> count( new int32[shape().rank]);
 
-        for (size_t i = 0; i < rank; i++)
+        for (size_t i = 0; i < shape().rank; i++)
         {
             start[i] = 0;
             stride[i] = 1;
-            count[i] = dimensions[i];
+            count[i] = shape().dimensions[i];
         }
 
         read (start.get(), stride.get(), count.get(), buffer.data());
         return buffer;
     }
 
-    std::list<std::string> getAttributeNames() const
+    // writes values in the dataset's own type to a hyperslab; the file must be open with
+    // UHDF_READWRITE or UHDF_CREATE
+    void rawWrite( const int32 *const start,
+                   const int32 *const stride,
+                   const int32 *const count,
+                   const void *buffer) const
     {
-        std::list<std::string> names;
+        if (shape().dataType == UHDF_UNKNOWN || shape().dataType == UHDF_REFERENCE || shape().dataType == UHDF_STRING)
+            throw UHDF_Exception("Can't write dataset '" + datasetname + "' of type " + UHDFTypeName(shape().dataType));
+
+        std::unique_lock<std::recursive_mutex> guard;
+        if (libraryLock != NULL)
+            guard = std::unique_lock<std::recursive_mutex>(*libraryLock);
+
+        fitChunkCache(stride, count);
+
+        ioCounters->add(UHDF_IOCounters::WRITE_CALLS, 1);
+        ioCounters->add(UHDF_IOCounters::BYTES_WRITTEN, getSelectionSize(count) * UHDFTypeSize(shape().dataType));
+        const UHDF_IOTimer timer(*ioCounters, UHDF_IOCounters::LIBRARY_NANOSECONDS);
 
         switch(fileType)
         {
         case UHDF_HDF4:
         {
-            for (int32 i = 0; i < h4NumAttrs; i++)
-            {
-                char name[MAX_NC_NAME + 1];
-                int32 attType;
-                int32 attCount;
-
-                memset(name, 0, MAX_NC_NAME + 1);
-                if (SDattrinfo(id.h4id, i, name, &attType, &attCount) < 0)
-                    throw UHDF_Exception("Error getting attribute name from dataset '" + datasetname + "'");
-
-                names.push_back(std::string(name));
-            }
+            if (SDwritedata(id.h4id, const_cast<int32*>(start), const_cast<int32*>(stride), const_cast<int32*>(count), const_cast<void*>(buffer)) < 0)
+                throw UHDF_Exception("Error writing HDF4 dataset '" + datasetname + "'");
             break;
         }
         case UHDF_HDF5:
         {
-            const int numAttrs = H5Aget_num_attrs(id.h5id);
-            if (numAttrs < 0)
-                throw UHDF_Exception("Error retrieving the number of attributes in dataset '" + datasetname + "'");
+            const UHDF_SpaceHolder fileSpaceId(H5Dget_space(id.h5id));
 
-            for (int i = 0; i < numAttrs; i++)
+            if (shape().rank > 0)
             {
-                const ssize_t nameLength = H5Aget_name_by_idx(id.h5id, ".", H5_INDEX_NAME, H5_ITER_NATIVE, i, NULL, 0, H5P_DEFAULT);
-                if (nameLength < 0)
-                    throw UHDF_Exception("Error getting name of attribute " + boost::lexical_cast<std::string>(i) + " of dataset '" + datasetname + "'");
-                if (nameLength == 0)
-                    continue;
+                hsize_t hstart[UHDF_MAX_RANK];
+                hsize_t hstride[UHDF_MAX_RANK];
+                hsize_t hcount[UHDF_MAX_RANK];
+                for (int i = 0; i < shape().rank; i++)
+                {
+                    hstart[i] = start[i];
+                    hstride[i] = stride[i];
+                    hcount[i] = count[i];
+                }
 
-                std::unique_ptr<char[]> name(new char[nameLength + 1]);
-                memset(name.get(), 0, nameLength + 1);
+                if (H5Sselect_hyperslab(fileSpaceId.get(), H5S_SELECT_SET, hstart, hstride, hcount, NULL) < 0)
+                    throw UHDF_Exception("Error selecting region to write in HDF5 dataset '" + datasetname + "'");
+            }
 
-                if (H5Aget_name_by_idx(id.h5id, ".", H5_INDEX_NAME, H5_ITER_NATIVE, i, name.get(), nameLength + 1, H5P_DEFAULT) < 0)
-                    throw UHDF_Exception("Error getting name of attribute " + boost::lexical_cast<std::string>(i) + " of dataset '" + datasetname + "'");
+            const UHDF_SpaceHolder memSpaceId(createH5MemSpace(count));
 
-                names.push_back(std::string(name.get()));
-            }
+            if (H5Dwrite(id.h5id, UHDFTypeToH5(shape().dataType), memSpaceId.get(), fileSpaceId.get(), H5P_DEFAULT, buffer) < 0)
+                throw UHDF_Exception("Error writing HDF5 dataset '" + datasetname + "'");
             break;
         }
         }
-
-        return names;
     }
 
-    UHDF_Attribute openAttribute(const std::string &attributeName) const
+    // Writes a hyperslab from buffer, which holds the selection packed in row-major order.
+    // Values are converted to the dataset's type first, saturating like reads do.  For many
+    // small writes into a compressed dataset, UHDF_ChunkWriter collects them into whole
+    // chunks so each chunk is only compressed once.
+    template<typename T>
+    void write( const int32 *const start,
+                const int32 *const stride,
+                const int32 *const count,
+                const T* buffer) const
     {
-        return UHDF_Attribute(fileType, id, attributeName);
-    }
+        if (shape().dataType == getUHDFType<T>())
+        {  // no conversion needed
+            rawWrite(start, stride, count, buffer);
+            return;
+        }
 
-private:
-    UHDF_FileType fileType;
-    UHDF_Identifier id;
-    UHDF_DataType dataType;
-    std::string datasetname;
-    int rank;
-    std::vector<size_t> dimensions;
-    int32 h4NumAttrs;
+        switch(shape().dataType)
+        {
+        case UHDF_UINT8:
+            writeConverted<uint8_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_INT8:
+            writeConverted<int8_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_UINT16:
+            writeConverted<uint16_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_INT16:
+            writeConverted<int16_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_UINT32:
+            writeConverted<uint32_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_INT32:
+            writeConverted<int32_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_UINT64:
+            writeConverted<uint64_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_INT64:
+            writeConverted<int64_t, T>(start, stride, count, buffer);
+            break;
+        case UHDF_FLOAT32:
+            writeConverted<float, T>(start, stride, count, buffer);
+            break;
+        case UHDF_FLOAT64:
+            writeConverted<double, T>(start, stride, count, buffer);
+            break;
+        default:
+            throw UHDF_Exception("Unsupported datatype when doing conversion in write of dataset '" + datasetname + "'");
+        }
+    }
 
-    UHDF_Dataset( UHDF_FileType format, UHDF_Identifier ownerId, const std::string &datasetName)
+    template <typename T>
+    void write( const int32 *const start,
+                const int32 *const count,
+                const T* buffer) const
+    {
+        int32 stride[UHDF_MAX_RANK];
+        for (int i = 0; i < shape().rank; i++)
+            stride[i] = 1;
+
+        write (start, stride, count, buffer);
+    }
+
+    // buffer holds getNumElements() values
+    template <typename T>
+    void writeAll( const T* buffer) const
+    {
+        std::vector<int32> start(shape().rank, 0);
+        std::vector<int32> count(shape().dimensions.begin(), shape().dimensions.end());
+
+        write (start.data(), count.data(), buffer);
+    }
+
+    // How the dataset's stored values map to physical ones, from its attributes.  HDF4
+    // calibration comes from SDgetcal, whose convention is physical = scale_factor *
+    // (stored - add_offset); HDF5 follows CF, physical = stored * scale_factor + add_offset.
+    // The fill value is _FillValue, and the valid range is valid_range or valid_min and
+    // valid_max; a floating-point range on scaled integer data is taken to be in physical
+    // units, as CF specifies.
+    UHDF_Calibration getCalibration() const
+    {
+        UHDF_Calibration calibration;
+        const UHDF_AttributeMap &attributes = readAllAttributes();
+
+        switch(fileType)
+        {
+        case UHDF_HDF4:
+        {
+            float64 cal, calErr, offset, offsetErr;
+            int32 calType;
+            if (SDgetcal(id.h4id, &cal, &calErr, &offset, &offsetErr, &calType) == SUCCEED)
+            {
+                calibration.scale = cal;
+                calibration.offset = -cal * offset;
+            }
+            break;
+        }
+        case UHDF_HDF5:
+        {
+            const UHDF_AttributeValue *scale = attributes.find("scale_factor");
+            if (scale != NULL && !scale->isString() && scale->getNumElements() > 0)
+                calibration.scale = scale->asScalar<double>();
+
+            const UHDF_AttributeValue *offset = attributes.find("add_offset");
+            if (offset != NULL && !offset->isString() && offset->getNumElements() > 0)
+                calibration.offset = offset->asScalar<double>();
+            break;
+        }
+        }
+
+        const UHDF_AttributeValue *fill = attributes.find("_FillValue");
+        if (fill != NULL && !fill->isString() && fill->getNumElements() > 0)
+        {
+            calibration.hasFillValue = true;
+            calibration.fillValue = fill->asScalar<double>();
+        }
+
+        const UHDF_AttributeValue *range = attributes.find("valid_range");
+        const UHDF_AttributeValue *validMin = attributes.find("valid_min");
+        const UHDF_AttributeValue *validMax = attributes.find("valid_max");
+        UHDF_DataType rangeType = shape().dataType;
+
+        if (range != NULL && !range->isString() && range->getNumElements() >= 2)
+        {
+            const std::vector<double> limits = range->as<double>();
+            calibration.validMin = limits[0];
+            calibration.validMax = limits[1];
+            rangeType = range->getType();
+        }
+        else
+        {
+            if (validMin != NULL && !validMin->isString() && validMin->getNumElements() > 0)
+            {
+                calibration.validMin = validMin->asScalar<double>();
+                rangeType = validMin->getType();
+            }
+            if (validMax != NULL && !validMax->isString() && validMax->getNumElements() > 0)
+            {
+                calibration.validMax = validMax->asScalar<double>();
+                rangeType = validMax->getType();
+            }
+        }
+
+        const bool scaled = calibration.scale != 1 || calibration.offset != 0;
+        const bool integerData = shape().dataType != UHDF_FLOAT32 && shape().dataType != UHDF_FLOAT64;
+        const bool floatRange = rangeType == UHDF_FLOAT32 || rangeType == UHDF_FLOAT64;
+
+        if (scaled && integerData && floatRange && calibration.scale != 0)
+        {
+            double lo = (calibration.validMin - calibration.offset) / calibration.scale;
+            double hi = (calibration.validMax - calibration.offset) / calibration.scale;
+            if (lo > hi)
+                std::swap(lo, hi);
+
+            calibration.validMin = lo;
+            calibration.validMax = hi;
+        }
+
+        return calibration;
+    }
+
+    // Reads a hyperslab as physical values (T is float or double): scaling, fill values and
+    // the valid range are applied in the same pass as the conversion from the stored type,
+    // and values with no physical value read as NaN.
+    template <typename T>
+    void readPhysical( const int32 *const start,
+                       const int32 *const stride,
+                       const int32 *const count,
+                       T* buffer,
+                       const UHDF_Calibration &calibration) const
+    {
+        static_assert(std::is_floating_point<T>::value, "Physical values are read as float or double");
+
+        switch(shape().dataType)
+        {
+        case UHDF_UINT8:
+            readCalibrated<uint8_t, T>(start, stride, count, buffer, calibration);
+            break;
+        case UHDF_INT8:
+            readCalibrated<int8_t, T>(start, stride, count, buffer, calibration);
+            break;
+        case UHDF_UINT16:
+            readCalibrated<uint16_t, T>(start, stride, count, buffer, calibration);
+            break;
+        case UHDF_INT16:
+            readCalibrated<int16_t, T>(start, stride, count, buffer, calibration);
+            break;
+        case UHDF_UINT32:
+            readCalibrated<uint32_t, T>(start, stride, count, buffer, calibration);
+            break;
+        case UHDF_INT32:
+            readCalibrated<int32_t, T>(start, stride, count, buffer, calibration);
+            break;
+        case UHDF_UINT64:
+            readCalibrated<uint64_t, T>(start, stride, count, buffer, calibration);
+            break;
+        case UHDF_INT64:
+            readCalibrated<int64_t, T>(start, stride, count, buffer, calibration);
+            break;
+        case UHDF_FLOAT32:
+            readCalibrated<float, T>(start, stride, count, buffer, calibration);
+            break;
+        case UHDF_FLOAT64:
+            readCalibrated<double, T>(start, stride, count, buffer, calibration);
+            break;
+        default:
+            throw UHDF_Exception("Can't read physical values of dataset '" + datasetname + "' of type " + UHDFTypeName(shape().dataType));
+        }
+    }
+
+    template <typename T>
+    void readPhysical( const int32 *const start,
+                       const int32 *const stride,
+                       const int32 *const count,
+                       T* buffer) const
+    {
+        readPhysical(start, stride, count, buffer, getCalibration());
+    }
+
+    template <typename T>
+    std::vector<T> readAllPhysical() const
+    {
+        std::vector<T> buffer(getNumElements());
+        std::vector<int32> start(shape().rank, 0);
+        std::vector<int32> stride(shape().rank, 1);
+        std::vector<int32> count(shape().dimensions.begin(), shape().dimensions.end());
+
+        readPhysical(start.data(), stride.data(), count.data(), buffer.data());
+        return buffer;
+    }
+
+    // true for HDF5 datasets whose data can be mapped straight from the file: contiguous,
+    // unfiltered, already written, and stored in the machine's native type
+    bool isMappable() const
+    {
+#ifdef UHDF_HAVE_MMAP
+        return getMappableOffset() != HADDR_UNDEF;
+#else
+        return false;
+#endif
+    }
+
+    // read-only view of the whole dataset backed by a mapping of the file, instead of a copy;
+    // T must be the dataset's own type, since no conversion is possible
+    template <typename T>
+    UHDF_MappedView<T> map() const
+    {
+        if (getUHDFType<T>() != shape().dataType)
+            throw UHDF_Exception("Can't map dataset '" + datasetname + "' as " + UHDFTypeName(getUHDFType<T>()) + ", it is stored as " + UHDFTypeName(shape().dataType));
+
+        const haddr_t offset = getMappableOffset();
+        if (offset == HADDR_UNDEF)
+            throw UHDF_Exception("Dataset '" + datasetname + "' isn't stored in a way that can be mapped");
+
+        return UHDF_MappedView<T>(filename, offset, getNumElements() * sizeof(T), shape().dimensions);
+    }
+
+    std::list<std::string> getAttributeNames() const
+    {
+        std::list<std::string> names;
+
+        switch(fileType)
+        {
+        case UHDF_HDF4:
+        {
+            for (int32 i = 0; i < shape().h4NumAttrs; i++)
+            {
+                char name[MAX_NC_NAME + 1];
+                int32 attType;
+                int32 attCount;
+
+                memset(name, 0, MAX_NC_NAME + 1);
+                if (SDattrinfo(id.h4id, i, name, &attType, &attCount) < 0)
+                    throw UHDF_Exception("Error getting attribute name from dataset '" + datasetname + "'");
+
+                names.push_back(std::string(name));
+            }
+            break;
+        }
+        case UHDF_HDF5:
+            names = UHDF_listH5AttributeNames(id.h5id, datasetname);
+            break;
+        }
+
+        return names;
+    }
+
+    UHDF_Attribute openAttribute(const std::string &attributeName) const
+    {
+        return UHDF_Attribute(fileType, id, attributeName);
+    }
+
+    template<typename T>
+    UHDF_Attribute createAttribute( const std::string &attributeName, const T *values, const size_t numValues)
+    {
+        checkWritable();
+
+        // HDF4 replaces an attribute that already has the name
+        const bool addingH4Attribute = (fileType == UHDF_HDF4) && SDfindattr(id.h4id, attributeName.c_str()) < 0;
+
+        try
+        {
+            // other handles on this dataset share the cache, so they see the new attribute too
+            attributeCache->clear();
+
+            if (addingH4Attribute)
+                shape().h4NumAttrs++;
+
+            return UHDF_Attribute(fileType, id, attributeName, numValues, values);
+        }
+        catch (const UHDF_Exception &e)
+        {
+            if (addingH4Attribute)
+                shape().h4NumAttrs--;
+
+            throw UHDF_Exception("Couldn't create attribute " + attributeName + " in dataset " + datasetname + ": " + e.what());
+        }
+    }
+
+    UHDF_Attribute createAttribute( const std::string &attributeName, const std::string &value)
+    {
+        return createAttribute(attributeName, value.c_str(), value.size());
+    }
+
+    // every attribute's type and value, read in one pass on first use and cached; the map
+    // stays valid as long as this dataset or another handle on it from the same file
+    const UHDF_AttributeMap &readAllAttributes() const
+    {
+        return attributeCache->get([this]() -> UHDF_AttributeMap
+        {
+            switch(fileType)
+            {
+            case UHDF_HDF4:
+                return UHDF_readH4Attributes(id.h4id, shape().h4NumAttrs, datasetname);
+            case UHDF_HDF5:
+                return UHDF_readH5Attributes(id.h5id, datasetname);
+            }
+            return UHDF_AttributeMap();
+        });
+    }
+
+private:
+    UHDF_FileType fileType;
+    mutable UHDF_Identifier id;  // reopened by setChunkCache, and by reads in automatic cache mode
+    std::string datasetname;
+    std::string filename;
+    std::string path;
+    int32 h4SdId;   // the file's SD interface id, for share()
+    int32 h4SdsIndex;
+
+    // set on datasets owned by worker threads, so their reads take the library lock
+    std::recursive_mutex *libraryLock;
+
+    UHDF_ChunkCache chunkCache;
+    mutable size_t chunkCacheBytes;  // what the cache holds now, once it has been configured
+
+    // shared by handles made from the same cached dataset
+    std::shared_ptr<UHDF_AttributeCache> attributeCache;
+
+    // shared like attributeCache; updates also go to the file's counters
+    std::shared_ptr<UHDF_IOCounters> ioCounters;
+
+    // readParallel goes through these reader processes when set
+    std::shared_ptr<UHDF_ProcessPool> readerPool;
+
+    // the file's: whether it can be changed, and how workers open it again
+    UHDF_FileAccess access;
+    UHDF_FileAccessOptions accessOptions;
+
+    // Opening a dataset only looks it up; what it holds is fetched the first time it's
+    // needed, through shape() and storage(), and kept.  So opening many datasets to pick a
+    // few costs one library call each.  Handles made by share() copy whatever has been
+    // fetched.  The fetch takes UHDF_libraryMutex(), so const uses of one handle from
+    // several threads stay safe.
+    struct Shape
+    {
+        Shape() :
+            rank (0),
+            dataType (UHDF_UNKNOWN),
+            h4NumAttrs (0)
+        {}
+
+        int rank;
+        std::vector<size_t> dimensions;
+        UHDF_DataType dataType;
+        int32 h4NumAttrs;
+    };
+
+    struct Storage
+    {
+        Storage() :
+            layout (UHDF_CONTIGUOUS)
+        {}
+
+        UHDF_StorageLayout layout;
+        std::vector<size_t> chunkDimensions;
+    };
+
+    UHDF_LoadOnce<Shape> shapeInfo;
+    UHDF_LoadOnce<Storage> storageInfo;
+
+    // rank, dimensions, type, and for HDF4 the number of attributes
+    const Shape &shape() const
+    {
+        return shapeInfo.get([this]() { return loadShape(); });
+    }
+
+    // for createAttribute, which keeps the HDF4 attribute count up to date
+    Shape &shape()
+    {
+        return shapeInfo.get([this]() { return loadShape(); });
+    }
+
+    // layout and chunk dimensions
+    const Storage &storage() const
+    {
+        return storageInfo.get([this]() { return loadStorage(); });
+    }
+
+    template<typename FILE_T, typename ACCUMULATOR>
+    ACCUMULATOR reduceAs( const ACCUMULATOR &initial, unsigned numThreads) const;
+
+    // HDF5 dataset names may be paths relative to the owner (eg, "group1/group2/dataset");
+    // for HDF4, a known SDS index can be given to skip the search by name
+    UHDF_Dataset( UHDF_FileType format,
+                  UHDF_Identifier ownerId,
+                  const std::string &datasetName,
+                  const std::string &fileName,
+                  const std::string &parentPath,
+                  const int32 h4Index = -1,
+                  const UHDF_ChunkCache &cacheSettings = UHDF_ChunkCache(),
+                  const std::shared_ptr<UHDF_IOCounters> &fileCounters = std::shared_ptr<UHDF_IOCounters>())
     {
         fileType = format;
         datasetname = datasetName;
+        filename = fileName;
+        path = parentPath.empty() ? datasetName : parentPath + "/" + datasetName;
+        h4SdId = -1;
+        h4SdsIndex = -1;
+        libraryLock = NULL;
+        attributeCache = std::make_shared<UHDF_AttributeCache>();
+        chunkCache = cacheSettings;
+        chunkCacheBytes = 0;
+        access = UHDF_READONLY;
+        ioCounters = std::make_shared<UHDF_IOCounters>(fileCounters);
 
         switch(fileType)
         {
         case UHDF_HDF4:
         {
-            int32 ix = SDnametoindex(ownerId.h4id, datasetname.c_str());
+            int32 ix = (h4Index >= 0) ? h4Index : SDnametoindex(ownerId.h4id, datasetname.c_str());
             if (ix < 0)
                 throw UHDF_Exception("Couldn't find dataset named '" + datasetname + "'");
 
             id.h4id = SDselect( ownerId.h4id, ix);
             if (id.h4id < 0)
                 throw UHDF_Exception("Couldn't open dataset named '" + datasetname + "'");
+            h4SdId = ownerId.h4id;
+            h4SdsIndex = ix;
+            ioCounters->add(UHDF_IOCounters::OPENS, 1);
+            break;
+        }
+        case UHDF_HDF5:
+        {
+            id.h5id = H5Dopen2(ownerId.h5id, datasetName.c_str(), H5P_DEFAULT);
+            if (id.h5id < 0)
+                throw UHDF_Exception("Couldn't open dataset name '" + datasetName + "'");
+            ioCounters->add(UHDF_IOCounters::OPENS, 1);
+
+            const size_t delimiterPos = datasetName.rfind("/");
+            if (delimiterPos != std::string::npos)
+                datasetname = datasetName.substr(delimiterPos + 1);
+            break;
+        }
+        }
 
+        // a cache that isn't the library's default has to be set before the first read
+        if (chunkCache.mode != UHDF_CACHE_DEFAULT && storage().layout == UHDF_CHUNKED)
+            configureChunkCache();
+    }
+
+    // an empty handle, for moving into
+    UHDF_Dataset() :
+        fileType (UHDF_HDF5),
+        h4SdId (-1),
+        h4SdsIndex (-1),
+        libraryLock (NULL),
+        chunkCacheBytes (0),
+        access (UHDF_READONLY)
+    {
+        id.h5id = -1;
+    }
+
+    // the same check, and message, as the file's
+    void checkWritable() const
+    {
+        if (access == UHDF_READONLY)
+            throw UHDF_Exception("File " + filename + " is open read-only");
+    }
+
+    Shape loadShape() const
+    {
+        Shape loaded;
+
+        switch(fileType)
+        {
+        case UHDF_HDF4:
+        {
             int32 sdsRank;
             int32 sdsDimSizes[MAX_VAR_DIMS];
             int32 sdsType;
 
-            if (SDgetinfo( id.h4id, NULL, &sdsRank, sdsDimSizes, &sdsType, &h4NumAttrs) < 0)
-                throw UHDF_Exception("Error getting dataset info");
+            if (SDgetinfo( id.h4id, NULL, &sdsRank, sdsDimSizes, &sdsType, &loaded.h4NumAttrs) < 0)
+                throw UHDF_Exception("Error getting info of dataset '" + datasetname + "'");
 
-            for (intn i = 0; i < sdsRank; i++)
-            {
-                const int32 dimId = SDgetdimid(id.h4id, i);
-                if (dimId < 0)
-                    throw UHDF_Exception("Error getting dimension information for dimension " + boost::lexical_cast<std::string>(i));
-
-                dimensions.push_back(sdsDimSizes[i]);
-            }
-            rank = static_cast<size_t>(sdsRank);
+            loaded.dimensions.assign(sdsDimSizes, sdsDimSizes + sdsRank);
+            loaded.rank = static_cast<int>(sdsRank);
 
             try
             {
-                dataType = H4TypeToUHDF(sdsType);
+                loaded.dataType = H4TypeToUHDF(sdsType);
             }
             catch (UHDF_Exception &)
             {
-                dataType = UHDF_UNKNOWN;
+                loaded.dataType = UHDF_UNKNOWN;
             }
-
             break;
         }
         case UHDF_HDF5:
         {
-            id.h5id = H5Dopen2(ownerId.h5id, datasetname.c_str(), H5P_DEFAULT);
-            if (id.h5id < 0)
-                throw UHDF_Exception("Couldn't open dataset name '" + datasetname + "'");
-
             const UHDF_SpaceHolder spaceId(H5Dget_space(id.h5id));
             if (spaceId.get() < 0)
                 throw UHDF_Exception("Error getting dataset info (couldn't get dataspace)");
 
-            rank = H5Sget_simple_extent_ndims(spaceId.get());
-            if (rank < 0)
+            loaded.rank = H5Sget_simple_extent_ndims(spaceId.get());
+            if (loaded.rank < 0)
                 throw UHDF_Exception("Error getting dataset info (couldn't get rank)");
 
-            if (rank > 0)
+            if (loaded.rank > 0)
             {
-                std::unique_ptr<hsize_t[]> dims(new hsize_t[rank]);
-                std::unique_ptr<hsize_t[]> maxDims(new hsize_t[rank]);
+                std::unique_ptr<hsize_t[]> dims(new hsize_t[loaded.rank]);
 
-                if (H5Sget_simple_extent_dims(spaceId.get(), dims.get(), maxDims.get()) < 0)
+                if (H5Sget_simple_extent_dims(spaceId.get(), dims.get(), NULL) < 0)
                     throw UHDF_Exception("Error getting dataset info (couldn't get dimensions)");
 
-                for (int i = 0; i < rank; i++)
-                    dimensions.push_back(dims[i]);
+                loaded.dimensions.assign(dims.get(), dims.get() + loaded.rank);
             }
 
             const UHDF_TypeHolder h5Type(H5Dget_type(id.h5id));
 
             try
             {
-                dataType = H5TypeToUHDF(h5Type.get());
+                loaded.dataType = H5TypeToUHDF(h5Type.get());
             }
             catch (UHDF_Exception &)
             {
-                dataType = UHDF_UNKNOWN;
+                loaded.dataType = UHDF_UNKNOWN;
+            }
+            break;
+        }
+        }
+
+        return loaded;
+    }
+
+    Storage loadStorage() const
+    {
+        const int numDims = shape().rank;
+        Storage loaded;
+
+        switch(fileType)
+        {
+        case UHDF_HDF4:
+        {
+            HDF_CHUNK_DEF chunkDef;
+            int32 chunkFlags;
+            if (SDgetchunkinfo(id.h4id, &chunkDef, &chunkFlags) < 0)
+                throw UHDF_Exception("Error getting chunking information");
+
+            if (chunkFlags != HDF_NONE)
+            {
+                // chunk_lengths is at the start of every member of the union
+                loaded.layout = UHDF_CHUNKED;
+                loaded.chunkDimensions.assign(chunkDef.chunk_lengths, chunkDef.chunk_lengths + numDims);
+            }
+            break;
+        }
+        case UHDF_HDF5:
+        {
+            const UHDF_PlistHolder createPlist(H5Dget_create_plist(id.h5id));
+
+            switch(H5Pget_layout(createPlist.get()))
+            {
+            case H5D_CHUNKED:
+            {
+                loaded.layout = UHDF_CHUNKED;
+
+                std::unique_ptr<hsize_t[]> chunkDims(new hsize_t[numDims]);
+                if (H5Pget_chunk(createPlist.get(), numDims, chunkDims.get()) != numDims)
+                    throw UHDF_Exception("Error getting dataset info (couldn't get chunk dimensions)");
+
+                loaded.chunkDimensions.assign(chunkDims.get(), chunkDims.get() + numDims);
+                break;
+            }
+            case H5D_COMPACT:
+                loaded.layout = UHDF_COMPACT;
+                break;
+            case H5D_LAYOUT_ERROR:
+                throw UHDF_Exception("Error getting dataset info (couldn't get storage layout)");
+            default:
+                // virtual datasets have no chunk grid of their own, so treat them as contiguous
+                loaded.layout = UHDF_CONTIGUOUS;
+                break;
+            }
+            break;
+        }
+        }
+
+        return loaded;
+    }
+
+    // copies everything, id included, so only share() may use it
+    UHDF_Dataset( const UHDF_Dataset &) = default;
+    UHDF_Dataset &operator=( const UHDF_Dataset &) = delete;
+
+    // counts one read call of numElements elements
+    void countRead( const size_t numElements) const
+    {
+        const size_t elementBytes = (shape().dataType == UHDF_REFERENCE) ? sizeof(hobj_ref_t) :
+                                    (shape().dataType == UHDF_UNKNOWN) ? 1 : UHDFTypeSize(shape().dataType);
+
+        ioCounters->add(UHDF_IOCounters::READ_CALLS, 1);
+        ioCounters->add(UHDF_IOCounters::BYTES_REQUESTED, numElements * elementBytes);
+    }
+
+    size_t getChunkBytes() const
+    {
+        size_t bytes = (shape().dataType == UHDF_UNKNOWN || shape().dataType == UHDF_REFERENCE) ? 1 : UHDFTypeSize(shape().dataType);
+        for (auto n : storage().chunkDimensions)
+            bytes *= std::max<size_t>(n, 1);
+        return bytes;
+    }
+
+    void configureChunkCache() const
+    {
+        switch(chunkCache.mode)
+        {
+        case UHDF_CACHE_DEFAULT:
+            resizeChunkCache(0, 0);
+            break;
+        case UHDF_CACHE_FIXED:
+            resizeChunkCache(chunkCache.numBytes, chunkCache.numSlots);
+            break;
+        case UHDF_CACHE_AUTO:
+        {
+            // start with enough for a scan row by row; reads that need more grow it
+            const size_t slabBytes = UHDF_chunksPerSlab(shape().dimensions, storage().chunkDimensions) * getChunkBytes();
+            const size_t wanted = std::min(chunkCache.numBytes, slabBytes);
+            if (wanted > getChunkCacheBytes())
+                resizeChunkCache(wanted, 0);
+            break;
+        }
+        }
+    }
+
+    // in automatic mode, grows the cache to hold every chunk a selection this shape can
+    // touch, so the next read next to it finds them decoded already
+    void fitChunkCache( const int32 *const stride, const int32 *const count) const
+    {
+        if (chunkCache.mode != UHDF_CACHE_AUTO || storage().layout != UHDF_CHUNKED)
+            return;
+
+        const size_t neededBytes = UHDF_maxChunksTouched(shape().dimensions, storage().chunkDimensions, stride, count) * getChunkBytes();
+        const size_t wanted = std::min(chunkCache.numBytes, neededBytes);
+        if (wanted > getChunkCacheBytes())
+            resizeChunkCache(wanted, 0);
+    }
+
+    // numBytes = 0 restores the library's default
+    void resizeChunkCache( const size_t numBytes, const size_t numSlots) const
+    {
+        const size_t chunkBytes = getChunkBytes();
+
+        switch(fileType)
+        {
+        case UHDF_HDF4:
+        {
+            // HDF4 caches whole chunks, by default as many as there are along the fastest dimension
+            int32 maxChunks = std::max<size_t>(1, numBytes / chunkBytes);
+            if (numBytes == 0)
+                maxChunks = (shape().dimensions.back() + storage().chunkDimensions.back() - 1) / storage().chunkDimensions.back();
+
+            if (SDsetchunkcache(id.h4id, maxChunks, 0) == FAIL)
+                throw UHDF_Exception("Error setting chunk cache of HDF4 dataset '" + datasetname + "'");
+
+            chunkCacheBytes = maxChunks * chunkBytes;
+            break;
+        }
+        case UHDF_HDF5:
+        {
+            const UHDF_PlistHolder accessPlist(H5Pcreate(H5P_DATASET_ACCESS));
+            if (numBytes > 0)
+            {
+                const size_t slots = (numSlots > 0) ? numSlots : UHDF_chunkCacheSlots(numBytes / chunkBytes);
+                if (H5Pset_chunk_cache(accessPlist.get(), slots, numBytes, chunkCache.preemption) < 0)
+                    throw UHDF_Exception("Error setting chunk cache of HDF5 dataset '" + datasetname + "'");
             }
 
+            const hid_t fileId = H5Iget_file_id(id.h5id);
+            if (fileId < 0)
+                throw UHDF_Exception("Error getting file of HDF5 dataset '" + datasetname + "'");
+
+            // the cache belongs to the open dataset, not the handle, so this handle has to let
+            // go of it first; while other handles keep the dataset open, it keeps its old cache
+            H5Dclose(id.h5id);
+            id.h5id = H5Dopen2(fileId, ("/" + path).c_str(), accessPlist.get());
+            H5Fclose(fileId);
+            if (id.h5id < 0)
+                throw UHDF_Exception("Couldn't reopen HDF5 dataset '" + datasetname + "' with a new chunk cache");
+            ioCounters->add(UHDF_IOCounters::CLOSES, 1);
+            ioCounters->add(UHDF_IOCounters::OPENS, 1);
+
+            // the library's own figure, in case it adjusted the request
+            chunkCacheBytes = 0;
+            chunkCacheBytes = getChunkCacheBytes();
             break;
         }
         }
     }
 
-    template<typename FILE_T, typename MEM_T>
-    void convertH4 (const int32 *const start,
-                    const int32 *const stride,
-                    const int32 *const count,
-                    MEM_T* buffer) const
+    // file offset of the dataset's data if it can be mapped, HADDR_UNDEF otherwise
+    haddr_t getMappableOffset() const
+    {
+        if (fileType != UHDF_HDF5 || storage().layout != UHDF_CONTIGUOUS || shape().dataType == UHDF_UNKNOWN || shape().dataType == UHDF_REFERENCE || shape().dataType == UHDF_STRING)
+            return HADDR_UNDEF;
+
+        const UHDF_PlistHolder createPlist(H5Dget_create_plist(id.h5id));
+        if (H5Pget_nfilters(createPlist.get()) != 0 || H5Pget_external_count(createPlist.get()) != 0)
+            return HADDR_UNDEF;
+
+        // the offset is only meaningful for files accessed through the default POSIX driver
+        const hid_t fileId = H5Iget_file_id(id.h5id);
+        if (fileId < 0)
+            return HADDR_UNDEF;
+        const hid_t accessPlist = H5Fget_access_plist(fileId);
+        H5Fclose(fileId);
+        const UHDF_PlistHolder fileAccessPlist(accessPlist);
+        if (H5Pget_driver(fileAccessPlist.get()) != H5FD_SEC2)
+            return HADDR_UNDEF;
+
+        const UHDF_TypeHolder fileDataType(H5Dget_type(id.h5id));
+        if (H5Tequal(fileDataType.get(), UHDFTypeToH5(shape().dataType)) <= 0)
+            return HADDR_UNDEF;
+
+        if (H5Dget_storage_size(id.h5id) < getNumElements() * UHDFTypeSize(shape().dataType))
+            return HADDR_UNDEF;
+
+        return H5Dget_offset(id.h5id);
+    }
+
+    // Whether workers can open the dataset's file again by name, read-only with the file's
+    // access options.  Only files opened through the default (sec2) driver can: HDF5 then
+    // shares the file already open, even one open for writing.  Files held by the core
+    // driver, including images opened from memory, may have no file by that name or lack
+    // the changes made in memory, and a second open of a file through another driver can
+    // conflict with the first over the file's lock.  Reads of other files stay on the
+    // calling thread.
+    bool canReopenFile() const
+    {
+        if (fileType != UHDF_HDF5)
+            return true;
+
+        const hid_t fileId = H5Iget_file_id(id.h5id);
+        if (fileId < 0)
+            return false;
+        const hid_t accessPlist = H5Fget_access_plist(fileId);
+        H5Fclose(fileId);
+        const UHDF_PlistHolder fileAccessPlist(accessPlist);
+        return H5Pget_driver(fileAccessPlist.get()) == H5FD_SEC2;
+    }
+
+    // true for datasets readChunksDirect can read that have filters for it to undo outside
+    // the library lock
+    bool hasDirectChunkFilters() const
+    {
+#if H5_VERSION_GE(1,10,5)
+        std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+        std::vector<UHDF_ChunkFilter> pipeline;
+        return getDirectChunkPipeline(pipeline) && !pipeline.empty();
+#else
+        return false;
+#endif
+    }
+
+    bool getDirectChunkPipeline( std::vector<UHDF_ChunkFilter> &pipeline) const
+    {
+        if (fileType != UHDF_HDF5 || storage().layout != UHDF_CHUNKED || shape().dataType == UHDF_UNKNOWN || shape().dataType == UHDF_REFERENCE || shape().dataType == UHDF_STRING)
+            return false;
+
+        const UHDF_TypeHolder fileDataType(H5Dget_type(id.h5id));
+        if (H5Tequal(fileDataType.get(), UHDFTypeToH5(shape().dataType)) <= 0)
+            return false;
+
+        const UHDF_PlistHolder createPlist(H5Dget_create_plist(id.h5id));
+        return UHDF_getChunkFilters(createPlist.get(), pipeline);
+    }
+
+#if H5_VERSION_GE(1,10,5)
+    // The calling thread fetches raw chunks in order while the pool decodes the ones before
+    // them.  Each chunk overlaps exactly one tile of the selection, and tiles don't overlap,
+    // so the workers write to buffer without locking.
+    template<typename FILE_T, typename T>
+    void readChunksDirectAs( const int32 *const start,
+                             const int32 *const count,
+                             T* buffer,
+                             unsigned numThreads) const
+    {
+        if (numThreads == 0)
+            numThreads = UHDF_defaultThreadCount();
+
+        const std::vector<int32> selectionStart(start, start + shape().rank);
+        const std::vector<int32> selectionCount(count, count + shape().rank);
+        const UHDF_TileGrid grid(tiles(selectionStart, selectionCount).getGrid());
+        const size_t numTiles = grid.getNumTiles();
+
+        size_t chunkElems = 1;
+        for (auto n : storage().chunkDimensions)
+            chunkElems *= n;
+        const size_t chunkBytes = chunkElems * sizeof(FILE_T);
+
+        std::vector<UHDF_ChunkFilter> pipeline;
+        T fill = 0;
+        {
+            std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+
+            getDirectChunkPipeline(pipeline);
+
+            // chunks never written read as the fill value
+            const UHDF_PlistHolder createPlist(H5Dget_create_plist(id.h5id));
+            H5D_fill_value_t fillStatus;
+            FILE_T fileFill = 0;
+            if (H5Pfill_value_defined(createPlist.get(), &fillStatus) >= 0 && fillStatus != H5D_FILL_VALUE_UNDEFINED)
+            {
+                if (H5Pget_fill_value(createPlist.get(), UHDFTypeToH5(shape().dataType), &fileFill) < 0)
+                    throw UHDF_Exception("Error getting fill value of HDF5 dataset '" + datasetname + "'");
+            }
+            UHDF_convert(&fileFill, &fill, 1);
+        }
+
+        UHDF_ThreadPool pool(std::min<size_t>(numThreads, std::max<size_t>(numTiles, 1)));
+
+        // a couple of chunks per worker in flight bounds the memory held by fetched chunks
+        const size_t maxInFlight = pool.size() * 2;
+        std::deque<std::future<void>> inFlight;
+
+        for (size_t t = 0; t < numTiles; t++)
+        {
+            const UHDF_Tile tile = grid.getTile(t);
+            if (tile.getNumElements() == 0)
+                continue;
+
+            std::shared_ptr<UHDF_RawChunk> chunk = std::make_shared<UHDF_RawChunk>();
+            fetchRawChunk(tile, *chunk);
+
+            if (inFlight.size() >= maxInFlight)
+            {
+                inFlight.front().get();
+                inFlight.pop_front();
+            }
+
+            inFlight.push_back(pool.submit([&, tile, chunk]()
+            {
+                if (!chunk->allocated)
+                {
+                    scatterChunk(tile, *chunk, start, count, buffer, [fill](const size_t, T *out, const size_t n)
+                    {
+                        std::fill(out, out + n, fill);
+                    });
+                    return;
+                }
+
+                std::vector<char> scratch;
+                {
+                    const UHDF_IOTimer timer(*ioCounters, UHDF_IOCounters::DECODE_NANOSECONDS);
+                    UHDF_decodeChunk(pipeline, chunk->filterMask, chunkBytes, sizeof(FILE_T), chunk->data, scratch, datasetname);
+                }
+                ioCounters->add(UHDF_IOCounters::BYTES_DECOMPRESSED, chunkBytes);
+
+                const FILE_T *decoded = reinterpret_cast<const FILE_T*>(chunk->data.data());
+                const UHDF_IOTimer timer(*ioCounters, UHDF_IOCounters::CONVERSION_NANOSECONDS);
+                scatterChunk(tile, *chunk, start, count, buffer, [decoded](const size_t in, T *out, const size_t n)
+                {
+                    UHDF_convert(decoded + in, out, n);
+                });
+            }));
+        }
+
+        UHDF_waitAll(inFlight);
+    }
+
+    // the chunk holding the start of tile, as stored; unallocated chunks have no data
+    void fetchRawChunk( const UHDF_Tile &tile, UHDF_RawChunk &chunk) const
+    {
+        hsize_t offset[UHDF_MAX_RANK];
+        chunk.origin.resize(shape().rank);
+        for (int i = 0; i < shape().rank; i++)
+        {
+            chunk.origin[i] = (tile.getStart()[i] / storage().chunkDimensions[i]) * storage().chunkDimensions[i];
+            offset[i] = chunk.origin[i];
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+        const UHDF_IOTimer timer(*ioCounters, UHDF_IOCounters::LIBRARY_NANOSECONDS);
+
+        unsigned filterMask = 0;
+        haddr_t address = HADDR_UNDEF;
+        hsize_t size = 0;
+        if (H5Dget_chunk_info_by_coord(id.h5id, offset, &filterMask, &address, &size) < 0)
+            throw UHDF_Exception("Error getting chunk info from HDF5 dataset '" + datasetname + "'");
+
+        chunk.allocated = (address != HADDR_UNDEF);
+        if (!chunk.allocated)
+            return;
+
+        uint32_t filters = 0;
+        chunk.data.resize(size);
+        if (H5Dread_chunk(id.h5id, H5P_DEFAULT, offset, &filters, chunk.data.data()) < 0)
+            throw UHDF_Exception("Error reading chunk from HDF5 dataset '" + datasetname + "'");
+        chunk.filterMask = filters;
+
+        ioCounters->add(UHDF_IOCounters::READ_CALLS, 1);
+        ioCounters->add(UHDF_IOCounters::BYTES_FETCHED, size);
+    }
+
+    // fills the part of the selection that tile covers one row along the fastest dimension
+    // at a time, through copyRow(indexInChunk, out, n)
+    template<typename T, typename COPY_ROW>
+    void scatterChunk( const UHDF_Tile &tile,
+                       const UHDF_RawChunk &chunk,
+                       const int32 *const start,
+                       const int32 *const count,
+                       T* buffer,
+                       COPY_ROW copyRow) const
+    {
+        const std::vector<int32> &tileStart = tile.getStart();
+        const std::vector<int32> &tileCount = tile.getCount();
+        const int last = shape().rank - 1;
+
+        std::vector<int32> index(shape().rank, 0);
+
+        while (true)
+        {
+            size_t in = 0;
+            size_t out = 0;
+            for (int i = 0; i < shape().rank; i++)
+            {
+                const size_t position = tileStart[i] + index[i];
+                in = in * storage().chunkDimensions[i] + (position - chunk.origin[i]);
+                out = out * count[i] + (position - start[i]);
+            }
+
+            copyRow(in, buffer + out, tileCount[last]);
+
+            int dim = last - 1;
+            while (dim >= 0 && ++index[dim] >= tileCount[dim])
+                index[dim--] = 0;
+            if (dim < 0)
+                break;
+        }
+    }
+#else
+    template<typename FILE_T, typename T>
+    void readChunksDirectAs( const int32 *const start,
+                             const int32 *const count,
+                             T* buffer,
+                             unsigned numThreads) const
+    {
+        throw UHDF_Exception("Reading raw chunks needs HDF5 1.10.5 or later");
+    }
+#endif
+
+    size_t getSelectionSize( const int32 *const count) const
+    {
+        size_t elems = 1;
+        for (int i = 0; i < shape().rank; i++)
+        {
+            if (count[i] < 0)
+                throw UHDF_Exception("Negative count given when reading dataset '" + datasetname + "'");
+            elems *= count[i];
+        }
+        return elems;
+    }
+
+    // memory dataspace that holds just the selected elements, packed
+    hid_t createH5MemSpace( const int32 *const count) const
+    {
+        if (shape().rank == 0)
+            return H5Screate(H5S_SCALAR);
+
+        hsize_t memDims[UHDF_MAX_RANK];
+        for (int i = 0; i < shape().rank; i++)
+            memDims[i] = count[i];
+
+        return H5Screate_simple(shape().rank, memDims, NULL);
+    }
+
+    // fills buffer with numElements values read all at once by rawRead, in the file's type
+    template<typename T, typename RAW_READ>
+    void readConvertedAll( const size_t numElements,
+                           T* buffer,
+                           RAW_READ rawRead) const
+    {
+        if (shape().dataType == getUHDFType<T>())
+        {
+            rawRead(static_cast<void*>(buffer));
+            return;
+        }
+
+        switch(shape().dataType)
+        {
+        case UHDF_UINT8:
+            UHDF_readTransformed<uint8_t, T>(numElements, buffer, rawRead, UHDF_timeKernel(UHDF_convert<uint8_t, T>, *ioCounters));
+            break;
+        case UHDF_INT8:
+            UHDF_readTransformed<int8_t, T>(numElements, buffer, rawRead, UHDF_timeKernel(UHDF_convert<int8_t, T>, *ioCounters));
+            break;
+        case UHDF_UINT16:
+            UHDF_readTransformed<uint16_t, T>(numElements, buffer, rawRead, UHDF_timeKernel(UHDF_convert<uint16_t, T>, *ioCounters));
+            break;
+        case UHDF_INT16:
+            UHDF_readTransformed<int16_t, T>(numElements, buffer, rawRead, UHDF_timeKernel(UHDF_convert<int16_t, T>, *ioCounters));
+            break;
+        case UHDF_UINT32:
+            UHDF_readTransformed<uint32_t, T>(numElements, buffer, rawRead, UHDF_timeKernel(UHDF_convert<uint32_t, T>, *ioCounters));
+            break;
+        case UHDF_INT32:
+            UHDF_readTransformed<int32_t, T>(numElements, buffer, rawRead, UHDF_timeKernel(UHDF_convert<int32_t, T>, *ioCounters));
+            break;
+        case UHDF_UINT64:
+            UHDF_readTransformed<uint64_t, T>(numElements, buffer, rawRead, UHDF_timeKernel(UHDF_convert<uint64_t, T>, *ioCounters));
+            break;
+        case UHDF_INT64:
+            UHDF_readTransformed<int64_t, T>(numElements, buffer, rawRead, UHDF_timeKernel(UHDF_convert<int64_t, T>, *ioCounters));
+            break;
+        case UHDF_FLOAT32:
+            UHDF_readTransformed<float, T>(numElements, buffer, rawRead, UHDF_timeKernel(UHDF_convert<float, T>, *ioCounters));
+            break;
+        case UHDF_FLOAT64:
+            UHDF_readTransformed<double, T>(numElements, buffer, rawRead, UHDF_timeKernel(UHDF_convert<double, T>, *ioCounters));
+            break;
+        default:
+            throw UHDF_Exception("Unsupported datatype when doing conversion in read of dataset '" + datasetname + "'");
+        }
+    }
+
+    // boxes (or points, when counts is NULL) read in one call; see readBoxes
+    template<typename T>
+    void readSelection( const int32 *const starts,
+                        const int32 *const counts,
+                        const size_t numBoxes,
+                        T* buffer) const
     {
-        size_t numSelectedElements = 1;
-        for (size_t i = 0; i < rank; i++)
+        if (shape().rank == 0)
+            throw UHDF_Exception("Can't select points or boxes in scalar dataset '" + datasetname + "'");
+        if (numBoxes == 0)
+            return;
+
+        size_t numElements = 0;
+        for (size_t b = 0; b < numBoxes; b++)
+        {
+            for (int i = 0; i < shape().rank; i++)
+            {
+                const int32 first = starts[b * shape().rank + i];
+                const int32 n = UHDF_boxCount(counts, shape().rank, b, i);
+                if (n <= 0 || first < 0 || static_cast<size_t>(first) + n > shape().dimensions[i])
+                    throw UHDF_Exception("Point or box out of range when reading dataset '" + datasetname + "'");
+            }
+            numElements += UHDF_boxSize(counts, shape().rank, b);
+        }
+
+        readConvertedAll(numElements, buffer,
+            [&](void *rawBuffer)
+            {
+                rawReadSelection(starts, counts, numBoxes, static_cast<char*>(rawBuffer));
+            });
+    }
+
+    // reads boxes in the file's type, packed one after another
+    void rawReadSelection( const int32 *const starts,
+                           const int32 *const counts,
+                           const size_t numBoxes,
+                           char *buffer) const
+    {
+        if (shape().dataType == UHDF_UNKNOWN || shape().dataType == UHDF_REFERENCE)
+            throw UHDF_Exception("Can't read: unknown/unsupported datatype");
+
+        const size_t elementSize = UHDFTypeSize(shape().dataType);
+
+        std::unique_lock<std::recursive_mutex> guard;
+        if (libraryLock != NULL)
+            guard = std::unique_lock<std::recursive_mutex>(*libraryLock);
+
+        switch(fileType)
+        {
+        case UHDF_HDF4:
         {
-            if (count[i] <= 0)
-                throw UHDF_Exception("Zero or negative count given when reading");
+            // one SDreaddata per cluster of nearby requests, rather than one per request
+            const size_t gap = std::max<size_t>(1, UHDF_COALESCE_GAP_BYTES / elementSize);
+            const std::vector<UHDF_CoalescedRead> reads = UHDF_coalesceBoxes(shape().rank, starts, counts, numBoxes, gap);
+
+            std::vector<size_t> boxOffsets(numBoxes);
+            size_t offset = 0;
+            for (size_t b = 0; b < numBoxes; b++)
+            {
+                boxOffsets[b] = offset;
+                offset += UHDF_boxSize(counts, shape().rank, b);
+            }
+
+            std::vector<char> readData;
+            for (const auto &read : reads)
+            {
+                readData.resize(getSelectionSize(read.count.data()) * elementSize);
+                countRead(getSelectionSize(read.count.data()));
+                {
+                    const UHDF_IOTimer timer(*ioCounters, UHDF_IOCounters::LIBRARY_NANOSECONDS);
+                    if (SDreaddata(id.h4id, const_cast<int32*>(read.start.data()), NULL, const_cast<int32*>(read.count.data()), readData.data()) < 0)
+                        throw UHDF_Exception("Error reading HDF4 dataset '" + datasetname + "'");
+                }
+
+                for (auto b : read.boxes)
+                {
+                    UHDF_copyBoxFromRead(read, shape().rank, starts + b * shape().rank, (counts == NULL) ? NULL : counts + b * shape().rank,
+                                         elementSize, readData.data(), buffer + boxOffsets[b] * elementSize);
+                }
+            }
+            break;
+        }
+        case UHDF_HDF5:
+        {
+            const UHDF_SpaceHolder fileSpace(H5Dget_space(id.h5id));
+            const hid_t memType = UHDFTypeToH5(shape().dataType);
+
+            if (counts == NULL)
+            {
+                // point selections are read in the order the points are listed
+                std::vector<hsize_t> coords(starts, starts + numBoxes * shape().rank);
+                if (H5Sselect_elements(fileSpace.get(), H5S_SELECT_SET, numBoxes, coords.data()) < 0)
+                    throw UHDF_Exception("Error selecting points to read from HDF5 dataset '" + datasetname + "'");
+
+                const hsize_t memDims = numBoxes;
+                const UHDF_SpaceHolder memSpace(H5Screate_simple(1, &memDims, NULL));
+
+                countRead(numBoxes);
+                const UHDF_IOTimer timer(*ioCounters, UHDF_IOCounters::LIBRARY_NANOSECONDS);
+                if (H5Dread(id.h5id, memType, memSpace.get(), fileSpace.get(), H5P_DEFAULT, buffer) < 0)
+                    throw UHDF_Exception("Error reading HDF5 dataset '" + datasetname + "'");
+                break;
+            }
+
+            // the union of the boxes, read in one call; it comes back in file order, without
+            // repeats, so each box's elements are then gathered from where they landed
+            std::vector<hsize_t> hstart(shape().rank);
+            std::vector<hsize_t> hcount(shape().rank);
+            for (size_t b = 0; b < numBoxes; b++)
+            {
+                for (int i = 0; i < shape().rank; i++)
+                {
+                    hstart[i] = starts[b * shape().rank + i];
+                    hcount[i] = counts[b * shape().rank + i];
+                }
+
+                if (H5Sselect_hyperslab(fileSpace.get(), (b == 0) ? H5S_SELECT_SET : H5S_SELECT_OR, hstart.data(), NULL, hcount.data(), NULL) < 0)
+                    throw UHDF_Exception("Error selecting boxes to read from HDF5 dataset '" + datasetname + "'");
+            }
+
+            const hssize_t numSelected = H5Sget_select_npoints(fileSpace.get());
+            if (numSelected < 0)
+                throw UHDF_Exception("Error counting selected elements of HDF5 dataset '" + datasetname + "'");
+
+            const hsize_t memDims = numSelected;
+            const UHDF_SpaceHolder memSpace(H5Screate_simple(1, &memDims, NULL));
+            std::vector<char> unionData(numSelected * elementSize);
+
+            countRead(numSelected);
+            {
+                const UHDF_IOTimer timer(*ioCounters, UHDF_IOCounters::LIBRARY_NANOSECONDS);
+                if (H5Dread(id.h5id, memType, memSpace.get(), fileSpace.get(), H5P_DEFAULT, unionData.data()) < 0)
+                    throw UHDF_Exception("Error reading HDF5 dataset '" + datasetname + "'");
+            }
+
+            std::vector<uint64_t> elements;
+            for (size_t b = 0; b < numBoxes; b++)
+            {
+                UHDF_forEachBoxElement(shape().rank, starts + b * shape().rank, counts + b * shape().rank, shape().dimensions,
+                    [&elements](const uint64_t linear)
+                    {
+                        elements.push_back(linear);
+                    });
+            }
+
+            std::vector<uint64_t> fileOrder(elements);
+            std::sort(fileOrder.begin(), fileOrder.end());
+            fileOrder.erase(std::unique(fileOrder.begin(), fileOrder.end()), fileOrder.end());
+
+            if (fileOrder.size() != static_cast<size_t>(numSelected))
+                throw UHDF_Exception("Unexpected selection size reading boxes from HDF5 dataset '" + datasetname + "'");
 
-            numSelectedElements *= count[i];
+            for (size_t e = 0; e < elements.size(); e++)
+            {
+                const size_t position = std::lower_bound(fileOrder.begin(), fileOrder.end(), elements[e]) - fileOrder.begin();
+                memcpy(buffer + e * elementSize, unionData.data() + position * elementSize, elementSize);
+            }
+            break;
         }
+        }
+    }
 
-        std::unique_ptr<FILE_T[]> unconverted(new FILE_T[numSelectedElements]);
+    // reads in the file's type and converts to the requested type
+    template<typename FILE_T, typename MEM_T>
+    void readConverted (const int32 *const start,
+                        const int32 *const stride,
+                        const int32 *const count,
+                        MEM_T* buffer) const
+    {
+        UHDF_readTransformed<FILE_T, MEM_T>(shape().rank, start, stride, count, getChunkDimensions(), buffer,
+            [this](const int32 *pieceStart, const int32 *pieceStride, const int32 *pieceCount, void *pieceBuffer)
+            {
+                rawRead(pieceStart, pieceStride, pieceCount, pieceBuffer);
+            },
+            UHDF_timeKernel(UHDF_convert<FILE_T, MEM_T>, *ioCounters));
+    }
 
-        rawRead(start, stride, count, unconverted.get());
+    // converts to the file's type and writes
+    template<typename FILE_T, typename MEM_T>
+    void writeConverted (const int32 *const start,
+                         const int32 *const stride,
+                         const int32 *const count,
+                         const MEM_T* buffer) const
+    {
+        UHDF_writeTransformed<FILE_T, MEM_T>(shape().rank, start, stride, count, getChunkDimensions(), buffer,
+            [this](const int32 *pieceStart, const int32 *pieceStride, const int32 *pieceCount, const void *pieceBuffer)
+            {
+                rawWrite(pieceStart, pieceStride, pieceCount, pieceBuffer);
+            },
+            UHDF_timeKernel(UHDF_convert<MEM_T, FILE_T>, *ioCounters));
+    }
 
-        for (size_t i = 0; i < numSelectedElements; i++)
-            buffer[i] = static_cast<MEM_T>(unconverted[i]);
+    // reads in the file's type and decodes to physical values
+    template<typename FILE_T, typename MEM_T>
+    void readCalibrated( const int32 *const start,
+                         const int32 *const stride,
+                         const int32 *const count,
+                         MEM_T* buffer,
+                         const UHDF_Calibration &calibration) const
+    {
+        UHDF_readTransformed<FILE_T, MEM_T>(shape().rank, start, stride, count, getChunkDimensions(), buffer,
+            [this](const int32 *pieceStart, const int32 *pieceStride, const int32 *pieceCount, void *pieceBuffer)
+            {
+                rawRead(pieceStart, pieceStride, pieceCount, pieceBuffer);
+            },
+            UHDF_timeKernel(UHDF_CalibrationKernel<FILE_T, MEM_T>(calibration), *ioCounters));
     }
 };
 
@@ -0,0 +1,450 @@
+#ifndef UHDF_DATASETCOLLECTION_H
+#define UHDF_DATASETCOLLECTION_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+#include <boost/lexical_cast.hpp>
+
+#include "UHDF_Types.h"
+#include "UHDF_ChunkCache.h"
+#include "UHDF_HandleCache.h"
+#include "UHDF_ThreadPool.h"
+#include "UHDF_ProcessPool.h"
+#include "UHDF_Dataset.h"
+#include "UHDF_File.h"
+
+// files a collection keeps open between reads
+static const size_t UHDF_DEFAULT_COLLECTION_OPEN_FILES = 16;
+
+typedef enum
+{
+    UHDF_CONCATENATE,  // granules are joined end to end along an existing dimension
+    UHDF_STACK         // granules become slices along a new dimension
+} UHDF_CollectionLayout;
+
+// The same dataset in a series of files (eg, one granule per time step), read as one array.
+// Concatenated granules must agree on every dimension but the one they're joined along;
+// stacked granules must have the same shape.  All must have the same type.
+//
+// Each file is opened once when the collection is made, to check it fits.  After that, up
+// to maxOpenFiles are kept open, with the dataset open in each, and the least recently used
+// is closed when another is needed.  A read is split into one piece per file it touches;
+// pieces are read on worker threads, one file per worker at a time, so files being read
+// stay open even if they're evicted meanwhile, and up to one more file per worker can be
+// open.  Library calls are serialized by UHDF_libraryMutex() as for readParallel; with a
+// reader pool set, pieces are read one after another, each split across its processes.
+class UHDF_DatasetCollection
+{
+public:
+    UHDF_DatasetCollection( const std::vector<std::string> &collectionFiles,
+                            const std::string &collectionDatasetPath,
+                            const UHDF_CollectionLayout collectionLayout = UHDF_CONCATENATE,
+                            const size_t collectionDimension = 0,
+                            const size_t maxOpenFiles = UHDF_DEFAULT_COLLECTION_OPEN_FILES) :
+        fileNames (collectionFiles),
+        datasetPath (collectionDatasetPath),
+        layout (collectionLayout),
+        dimension (collectionDimension),
+        granules (std::max<size_t>(1, maxOpenFiles))
+    {
+        if (fileNames.empty())
+            throw UHDF_Exception("No files given for collection of dataset '" + datasetPath + "'");
+
+        for (size_t i = 0; i < fileNames.size(); i++)
+        {
+            const std::shared_ptr<Granule> granule = getGranule(i);
+            const UHDF_Dataset &dataset = granule->dataset;
+
+            if (i == 0)
+            {
+                dataType = dataset.getType();
+                granuleDimensions = dataset.getDimensions();
+                init();
+            }
+            else
+            {
+                checkFits(dataset, i);
+            }
+
+            if (layout == UHDF_CONCATENATE)
+            {
+                offsets.push_back(dimensions[dimension]);
+                extents.push_back(dataset.getDimensions()[dimension]);
+                dimensions[dimension] += extents.back();
+            }
+        }
+    }
+
+    UHDF_DatasetCollection( const UHDF_DatasetCollection &) = delete;
+    UHDF_DatasetCollection &operator=( const UHDF_DatasetCollection &) = delete;
+
+    const std::vector<std::string> &getFileNames() const
+    {
+        return fileNames;
+    }
+
+    size_t getNumFiles() const
+    {
+        return fileNames.size();
+    }
+
+    const std::string &getDatasetPath() const
+    {
+        return datasetPath;
+    }
+
+    UHDF_CollectionLayout getLayout() const
+    {
+        return layout;
+    }
+
+    // the dimension granules are joined or stacked along
+    size_t getCollectionDimension() const
+    {
+        return dimension;
+    }
+
+    size_t getRank() const
+    {
+        return dimensions.size();
+    }
+
+    const std::vector<size_t> &getDimensions() const
+    {
+        return dimensions;
+    }
+
+    size_t getNumElements() const
+    {
+        size_t n = 1;
+        for (auto d : dimensions)
+            n *= d;
+        return n;
+    }
+
+    UHDF_DataType getType() const
+    {
+        return dataType;
+    }
+
+    // where file i's granule starts along the collection dimension
+    size_t getFileOffset( const size_t i) const
+    {
+        return (layout == UHDF_CONCATENATE) ? offsets.at(i) : i;
+    }
+
+    // Chunk cache for files opened from now on; see UHDF_ChunkCache.  Open files are closed,
+    // so they're reopened with the new setting.
+    void setChunkCache( const UHDF_ChunkCache &cache)
+    {
+        std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+        chunkCache = cache;
+        granules.clear();
+    }
+
+    // Reader processes to read through instead of threads (NULL for threads); see
+    // UHDF_ProcessPool.  Open files are closed, so they're reopened with the new setting.
+    void setReaderPool( const std::shared_ptr<UHDF_ProcessPool> &pool)
+    {
+        std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+        readerPool = pool;
+        granules.clear();
+    }
+
+    // Reads a hyperslab of the whole collection into buffer, with numThreads workers (0 =
+    // one per core) sharing the files it touches.  Values are converted to T.
+    template<typename T>
+    void read( const int32 *const start,
+               const int32 *const stride,
+               const int32 *const count,
+               T* buffer,
+               unsigned numThreads = 0) const
+    {
+        const std::vector<Piece> pieces = split(start, stride, count);
+
+        // the output is [outer][count along the collection dimension][inner]
+        size_t outer = 1;
+        size_t inner = 1;
+        for (size_t i = 0; i < dimensions.size(); i++)
+        {
+            if (i < dimension)
+                outer *= count[i];
+            else if (i > dimension)
+                inner *= count[i];
+        }
+
+        if (numThreads == 0)
+            numThreads = UHDF_defaultThreadCount();
+        if (readerPool)
+            numThreads = 1;
+
+        const auto readPieces = [&](std::atomic<size_t> &nextPiece)
+        {
+            std::vector<int32> fileStart;
+            std::vector<int32> fileStride;
+            std::vector<int32> fileCount;
+            std::vector<T> scratch;
+
+            for (size_t p = nextPiece++; p < pieces.size(); p = nextPiece++)
+            {
+                const Piece &piece = pieces[p];
+                getFileSelection(piece, start, stride, count, fileStart, fileStride, fileCount);
+
+                // held until the read is done, even if another worker evicts it
+                const std::shared_ptr<Granule> granule = getGranule(piece.file);
+
+                const size_t blockElems = piece.count * inner;
+                T* target = buffer + piece.first * inner;
+                if (outer > 1)
+                {
+                    scratch.resize(outer * blockElems);
+                    target = scratch.data();
+                }
+
+                if (readerPool)
+                    granule->dataset.readParallel(fileStart.data(), fileStride.data(), fileCount.data(), target);
+                else
+                    granule->dataset.read(fileStart.data(), fileStride.data(), fileCount.data(), target);
+
+                // one block per position in the dimensions before the collection dimension
+                if (outer > 1)
+                {
+                    const size_t rowElems = count[dimension] * inner;
+                    for (size_t o = 0; o < outer; o++)
+                        std::copy(scratch.data() + o * blockElems, scratch.data() + (o + 1) * blockElems, buffer + o * rowElems + piece.first * inner);
+                }
+            }
+        };
+
+        std::atomic<size_t> nextPiece(0);
+        if (numThreads == 1 || pieces.size() == 1)
+        {
+            readPieces(nextPiece);
+            return;
+        }
+
+        UHDF_ThreadPool pool(std::min<size_t>(numThreads, pieces.size()));
+        std::vector<std::future<void>> results;
+        for (size_t t = 0; t < pool.size(); t++)
+            results.push_back(pool.submit([&]() { readPieces(nextPiece); }));
+
+        UHDF_waitAll(results);
+    }
+
+    template<typename T>
+    void read( const int32 *const start,
+               const int32 *const count,
+               T* buffer,
+               unsigned numThreads = 0) const
+    {
+        const std::vector<int32> stride(dimensions.size(), 1);
+        read(start, stride.data(), count, buffer, numThreads);
+    }
+
+    template<typename T>
+    std::vector<T> readAll( unsigned numThreads = 0) const
+    {
+        const std::vector<int32> start(dimensions.size(), 0);
+        const std::vector<int32> count(dimensions.begin(), dimensions.end());
+
+        std::vector<T> buffer(getNumElements());
+        read(start.data(), count.data(), buffer.data(), numThreads);
+        return buffer;
+    }
+
+private:
+    // one file, with the dataset open in it; closed under the library lock whenever the
+    // last reference goes, which may be on a worker
+    struct Granule
+    {
+        Granule( UHDF_File &&granuleFile, const std::string &path) :
+            file (std::move(granuleFile)),
+            dataset (file.openDataset(path))
+        {
+            dataset.libraryLock = &UHDF_libraryMutex();
+        }
+
+        UHDF_File file;
+        UHDF_Dataset dataset;
+    };
+
+    // the part of a read that falls in one file: count positions along the collection
+    // dimension, starting at position first of the read
+    struct Piece
+    {
+        size_t file;
+        int32 first;
+        int32 count;
+    };
+
+    std::vector<std::string> fileNames;
+    std::string datasetPath;
+    UHDF_CollectionLayout layout;
+    size_t dimension;
+
+    UHDF_DataType dataType;
+    std::vector<size_t> granuleDimensions;  // the first file's
+    std::vector<size_t> dimensions;
+
+    // concatenated only: where each file starts along the collection dimension, and how far it goes
+    std::vector<size_t> offsets;
+    std::vector<size_t> extents;
+
+    UHDF_ChunkCache chunkCache;
+    std::shared_ptr<UHDF_ProcessPool> readerPool;
+
+    // guarded by the library lock
+    mutable UHDF_LRUCache<size_t, std::shared_ptr<Granule>> granules;
+
+    void init()
+    {
+        const size_t granuleRank = granuleDimensions.size();
+        dimensions = granuleDimensions;
+
+        switch(layout)
+        {
+        case UHDF_CONCATENATE:
+            if (dimension >= granuleRank)
+                throw UHDF_Exception("Can't concatenate dataset '" + datasetPath + "' along dimension " + boost::lexical_cast<std::string>(dimension) +
+                                     ", it has " + boost::lexical_cast<std::string>(granuleRank) + " dimensions");
+            dimensions[dimension] = 0;
+            break;
+        case UHDF_STACK:
+            if (dimension > granuleRank || granuleRank + 1 > static_cast<size_t>(UHDF_MAX_RANK))
+                throw UHDF_Exception("Can't stack dataset '" + datasetPath + "' along dimension " + boost::lexical_cast<std::string>(dimension) +
+                                     ", it has " + boost::lexical_cast<std::string>(granuleRank) + " dimensions");
+            dimensions.insert(dimensions.begin() + dimension, fileNames.size());
+            break;
+        }
+    }
+
+    void checkFits( const UHDF_Dataset &dataset, const size_t i) const
+    {
+        if (dataset.getType() != dataType)
+            throw UHDF_Exception("Dataset '" + datasetPath + "' in " + fileNames[i] + " is " + UHDFTypeName(dataset.getType()) +
+                                 ", not " + UHDFTypeName(dataType) + " as in " + fileNames[0]);
+
+        const std::vector<size_t> &dims = dataset.getDimensions();
+        bool fits = (dims.size() == granuleDimensions.size());
+        for (size_t d = 0; fits && d < dims.size(); d++)
+        {
+            if (layout == UHDF_CONCATENATE && d == dimension)
+                continue;
+            fits = (dims[d] == granuleDimensions[d]);
+        }
+
+        if (!fits)
+            throw UHDF_Exception("Dataset '" + datasetPath + "' in " + fileNames[i] + " doesn't have the same shape as in " + fileNames[0]);
+    }
+
+    std::shared_ptr<Granule> getGranule( const size_t i) const
+    {
+        std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+
+        const std::shared_ptr<Granule> *cached = granules.find(i);
+        if (cached != NULL)
+            return *cached;
+
+        UHDF_File file(fileNames[i]);
+        file.setChunkCache(chunkCache);
+        file.setReaderPool(readerPool);
+
+        const std::shared_ptr<Granule> granule(new Granule(std::move(file), datasetPath), [](Granule *g)
+        {
+            std::lock_guard<std::recursive_mutex> closeLock(UHDF_libraryMutex());
+            delete g;
+        });
+        granules.insert(i, granule);
+        return granule;
+    }
+
+    // the files a selection touches, in order along the collection dimension
+    std::vector<Piece> split( const int32 *const start, const int32 *const stride, const int32 *const count) const
+    {
+        for (size_t d = 0; d < dimensions.size(); d++)
+        {
+            if (count[d] <= 0 || stride[d] <= 0)
+                throw UHDF_Exception("Zero or negative count or stride given when reading collection of dataset '" + datasetPath + "'");
+        }
+
+        const int64_t first = start[dimension];
+        const int64_t step = stride[dimension];
+        const int64_t last = first + (static_cast<int64_t>(count[dimension]) - 1) * step;
+        if (first < 0 || last >= static_cast<int64_t>(dimensions[dimension]))
+            throw UHDF_Exception("Read of collection of dataset '" + datasetPath + "' goes outside it along dimension " + boost::lexical_cast<std::string>(dimension));
+
+        std::vector<Piece> pieces;
+        switch(layout)
+        {
+        case UHDF_CONCATENATE:
+        {
+            // the file holding the first position, then each after it up to the last
+            size_t f = std::upper_bound(offsets.begin(), offsets.end(), static_cast<size_t>(first)) - offsets.begin() - 1;
+            for (; f < offsets.size() && static_cast<int64_t>(offsets[f]) <= last; f++)
+            {
+                const int64_t begin = offsets[f];
+                const int64_t end = begin + extents[f];
+
+                // positions k of the read with begin <= first + k * step < end
+                const int64_t kFirst = (begin <= first) ? 0 : (begin - first + step - 1) / step;
+                const int64_t kEnd = std::min<int64_t>(count[dimension], (end - first + step - 1) / step);
+                if (kFirst >= kEnd)
+                    continue;
+
+                Piece piece;
+                piece.file = f;
+                piece.first = kFirst;
+                piece.count = kEnd - kFirst;
+                pieces.push_back(piece);
+            }
+            break;
+        }
+        case UHDF_STACK:
+            for (int32 k = 0; k < count[dimension]; k++)
+            {
+                Piece piece;
+                piece.file = first + k * step;
+                piece.first = k;
+                piece.count = 1;
+                pieces.push_back(piece);
+            }
+            break;
+        }
+
+        return pieces;
+    }
+
+    // the selection within a piece's file
+    void getFileSelection( const Piece &piece,
+                           const int32 *const start,
+                           const int32 *const stride,
+                           const int32 *const count,
+                           std::vector<int32> &fileStart,
+                           std::vector<int32> &fileStride,
+                           std::vector<int32> &fileCount) const
+    {
+        fileStart.assign(start, start + dimensions.size());
+        fileStride.assign(stride, stride + dimensions.size());
+        fileCount.assign(count, count + dimensions.size());
+
+        switch(layout)
+        {
+        case UHDF_CONCATENATE:
+            fileStart[dimension] = start[dimension] + piece.first * stride[dimension] - offsets[piece.file];
+            fileCount[dimension] = piece.count;
+            break;
+        case UHDF_STACK:
+            fileStart.erase(fileStart.begin() + dimension);
+            fileStride.erase(fileStride.begin() + dimension);
+            fileCount.erase(fileCount.begin() + dimension);
+            break;
+        }
+    }
+};
+
+#endif // UHDF_DATASETCOLLECTION_H
@@ -2,70 +2,160 @@
 #define UHDF_FILE_H
 
 #include <string>
-#include <list>
 #include <memory>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
 
 #include "UHDF_Dataset.h"
 #include "UHDF_Group.h"
+#include "UHDF_HandleCache.h"
+#include "UHDF_Visit.h"
+#include "UHDF_Create.h"
+#include "UHDF_FileAccess.h"
+#include "UHDF_ProcessPool.h"
 
 #include <boost/lexical_cast.hpp>
 
 
+static const size_t UHDF_DEFAULT_HANDLE_CACHE_SIZE = 64;
+
 class UHDF_File// : GroupHolder, DatasetHolder, AttributeHolder
 {
 public:
-    UHDF_File( const std::string &fileName, UHDF_FileAccess accessMode = UHDF_READONLY)
+    // UHDF_CREATE makes a new file in createFormat; otherwise the format is detected
+    UHDF_File( const std::string &fileName, UHDF_FileAccess accessMode = UHDF_READONLY, UHDF_FileType createFormat = UHDF_HDF5) :
+        UHDF_File(fileName, UHDF_FileAccessOptions(), accessMode, createFormat)
+    {}
+
+    // HDF5 files are opened with the driver and settings in options; HDF4 files ignore them
+    UHDF_File( const std::string &fileName,
+               const UHDF_FileAccessOptions &options,
+               UHDF_FileAccess accessMode = UHDF_READONLY,
+               UHDF_FileType createFormat = UHDF_HDF5) :
+        access (accessMode),
+        accessOptions (options),
+        datasetCache (UHDF_DEFAULT_HANDLE_CACHE_SIZE),
+        groupCache (UHDF_DEFAULT_HANDLE_CACHE_SIZE),
+        ioCounters (std::make_shared<UHDF_IOCounters>()),
+        h4IndexBuilt (false)
     {
         filename = fileName;
 
-        if (Hishdf(fileName.c_str()) != 0)
-        {
+        if (accessMode == UHDF_CREATE)
+            fileType = createFormat;
+        else if (Hishdf(fileName.c_str()) != 0)
             fileType = UHDF_HDF4;
+        else if (H5Fis_hdf5(fileName.c_str()) != 0)
+            fileType = UHDF_HDF5;
+        else
+            throw UHDF_Exception(fileName + " is not an HDF4 or HDF5 file");
+
+        switch (fileType)
+        {
+        case UHDF_HDF4:
+        {
             fileId.h4id = -1;
+            H5RootGroupId = -1;
 
-            int32 h4Access;
+            int32 h4Access = DFACC_RDONLY;
             switch (accessMode)
             {
             case UHDF_READONLY:
                 h4Access = DFACC_RDONLY;
                 break;
+            case UHDF_READWRITE:
+                h4Access = DFACC_RDWR;
+                break;
+            case UHDF_CREATE:
+                h4Access = DFACC_CREATE;
+                break;
             }
 
             fileId.h4id = SDstart(fileName.c_str(), h4Access);
             if (fileId.h4id < 0)
                 throw UHDF_Exception("Unable to open " + filename);
+            ioCounters->add(UHDF_IOCounters::OPENS, 1);
 
+            break;
         }
-        else if (H5Fis_hdf5(fileName.c_str()) != 0)
+        case UHDF_HDF5:
         {
-            fileType = UHDF_HDF5;
             fileId.h5id = -1;
             H5RootGroupId = -1;
 
-            unsigned int flags;
+            const UHDF_PlistHolder accessPlist(H5Pcreate(H5P_FILE_ACCESS));
+            UHDF_setH5AccessOptions(accessPlist.get(), options, filename);
+
             switch(accessMode)
             {
             case UHDF_READONLY:
-                flags = H5F_ACC_RDONLY;
+                fileId.h5id = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, accessPlist.get());
+                break;
+            case UHDF_READWRITE:
+                fileId.h5id = H5Fopen(fileName.c_str(), H5F_ACC_RDWR, accessPlist.get());
+                break;
+            case UHDF_CREATE:
+            {
+                const UHDF_PlistHolder createPlist(H5Pcreate(H5P_FILE_CREATE));
+                UHDF_setH5CreateOptions(createPlist.get(), options, filename);
+
+                fileId.h5id = H5Fcreate(fileName.c_str(), H5F_ACC_TRUNC, createPlist.get(), accessPlist.get());
                 break;
             }
+            }
 
-            fileId.h5id = H5Fopen(fileName.c_str(), flags, H5P_DEFAULT);
             if (fileId.h5id < 0)
                 throw UHDF_Exception("Unable to open " + filename);
+            ioCounters->add(UHDF_IOCounters::OPENS, 1);
 
             H5RootGroupId = H5Gopen2( fileId.h5id, "/", H5P_DEFAULT);
             if (H5RootGroupId < 0)
                 throw UHDF_Exception("Couldn't open root group of file " + filename);
+
+            break;
         }
-        else
-        {
-            throw UHDF_Exception(fileName + " is not an HDF4 or HDF5 file");
         }
     }
 
+    // Opens an HDF5 file image read-only, without copying it.  The image must stay valid
+    // and unchanged until the file and everything opened from it are closed.  imageName is
+    // only what getFileName reports.  HDF4 files can't be opened from memory.
+    UHDF_File( const std::string &imageName, const void *image, const size_t imageSize) :
+        access (UHDF_READONLY),
+        datasetCache (UHDF_DEFAULT_HANDLE_CACHE_SIZE),
+        groupCache (UHDF_DEFAULT_HANDLE_CACHE_SIZE),
+        ioCounters (std::make_shared<UHDF_IOCounters>()),
+        h4IndexBuilt (false),
+        fileImage (new UHDF_FileImage())
+    {
+        fileImage->data = image;
+        fileImage->size = imageSize;
+        openImage(imageName);
+    }
+
+    // as above, but the file takes the image over, so it lives as long as the file does
+    UHDF_File( const std::string &imageName, std::vector<char> &&image) :
+        access (UHDF_READONLY),
+        datasetCache (UHDF_DEFAULT_HANDLE_CACHE_SIZE),
+        groupCache (UHDF_DEFAULT_HANDLE_CACHE_SIZE),
+        ioCounters (std::make_shared<UHDF_IOCounters>()),
+        h4IndexBuilt (false),
+        fileImage (new UHDF_FileImage())
+    {
+        fileImage->owned.swap(image);
+        fileImage->data = fileImage->owned.data();
+        fileImage->size = fileImage->owned.size();
+        openImage(imageName);
+    }
+
     ~UHDF_File()
     {
+        // cached handles have to be closed before the file
+        clearHandleCache();
+
         switch(fileType)
         {
         case UHDF_HDF4:
@@ -81,6 +171,64 @@ public:
         }
     }
 
+    // movable but not copyable, like UHDF_Dataset; datasets and groups opened from the file
+    // stay valid when it moves
+    UHDF_File( UHDF_File &&other) noexcept :
+        UHDF_File()
+    {
+        swap(other);
+    }
+
+    UHDF_File &operator=( UHDF_File &&other) noexcept
+    {
+        UHDF_File moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    UHDF_File( const UHDF_File &) = delete;
+    UHDF_File &operator=( const UHDF_File &) = delete;
+
+    void swap( UHDF_File &other) noexcept
+    {
+        std::swap(filename, other.filename);
+        std::swap(fileType, other.fileType);
+        std::swap(access, other.access);
+        std::swap(accessOptions, other.accessOptions);
+        std::swap(fileId, other.fileId);
+        std::swap(H5RootGroupId, other.H5RootGroupId);
+        std::swap(datasetCache, other.datasetCache);
+        std::swap(groupCache, other.groupCache);
+        std::swap(attributeCache, other.attributeCache);
+        std::swap(ioCounters, other.ioCounters);
+        std::swap(chunkCache, other.chunkCache);
+        std::swap(readerPool, other.readerPool);
+        std::swap(h4Datasets, other.h4Datasets);
+        std::swap(h4DatasetIndex, other.h4DatasetIndex);
+        std::swap(h4IndexBuilt, other.h4IndexBuilt);
+        std::swap(fileImage, other.fileImage);
+    }
+
+    // I/O done through everything opened from the file; see UHDF_IOStatistics
+    UHDF_IOStatistics getIOStatistics() const
+    {
+        UHDF_IOStatistics stats = ioCounters->snapshot();
+
+        double hitRate;
+        if (fileType == UHDF_HDF5 && H5Fget_mdc_hit_rate(fileId.h5id, &hitRate) >= 0)
+            stats.metadataCacheHitRate = hitRate;
+
+        return stats;
+    }
+
+    // the counts of datasets already open are left alone
+    void resetIOStatistics()
+    {
+        ioCounters->reset();
+        if (fileType == UHDF_HDF5)
+            H5Freset_mdc_hit_rate_stats(fileId.h5id);
+    }
+
     const std::string &getFileName() const
     {
         return filename;
@@ -91,121 +239,402 @@ public:
         return fileType;
     }
 
-    std::list<std::string> getDatasetNames() const
+    UHDF_FileAccess getAccess() const
+    {
+        return access;
+    }
+
+    // true for files opened from a memory image
+    bool isInMemory() const
     {
-        std::list<std::string> datasetNames;
+        return fileImage != NULL;
+    }
 
+    // members of the root group (every dataset, for HDF4) with their types, in one pass
+    std::vector<UHDF_ObjectInfo> getChildren() const
+    {
         switch(fileType)
         {
         case UHDF_HDF4:
-        {
-            int32 numDatasets;
-            int32 numAttributes;
+            buildH4Index();
+            return h4Datasets;
+        case UHDF_HDF5:
+            return UHDF_listH5Group(H5RootGroupId, "");
+        }
 
-            if (SDfileinfo( fileId.h4id, &numDatasets, &numAttributes) < 0)
-                throw UHDF_Exception("Error getting file info from " + filename);
+        return std::vector<UHDF_ObjectInfo>();
+    }
 
-            for (int32 i = 0; i < numDatasets; i++)
+    // calls visitor for every object in the file, parents before children, until it returns false
+    void visit( const UHDF_Visitor &visitor) const
+    {
+        switch(fileType)
+        {
+        case UHDF_HDF4:
+            buildH4Index();
+            for (const auto &info : h4Datasets)
             {
-                const int32 sdsid = SDselect( fileId.h4id, i);
-                if (sdsid < 0)
-                    throw UHDF_Exception("Error opening dataset #" + boost::lexical_cast<std::string>(i) + " from file " + filename);
+                if (!visitor(info))
+                    break;
+            }
+            break;
+        case UHDF_HDF5:
+            UHDF_visitH5Group(H5RootGroupId, "", visitor);
+            break;
+        }
+    }
+
+    std::vector<std::string> getDatasetNames() const
+    {
+        return getChildNames(UHDF_OBJ_DATASET);
+    }
+
+    std::vector<std::string> getGroupNames() const
+    {
+        return getChildNames(UHDF_OBJ_GROUP);
+    }
+
+    // Datasets and groups can be opened from several threads at once; each open holds
+    // UHDF_libraryMutex() while it uses the library and the handle cache.
+    UHDF_Dataset openDataset(const std::string &datasetName) const
+    {
+        // an automatic chunk cache grows by reopening the dataset, which only takes effect
+        // once no other handle holds it open, so those handles aren't shared
+        return openDataset(datasetName, chunkCache, chunkCache.mode != UHDF_CACHE_AUTO);
+    }
 
-                char sdsName[MAX_NC_NAME + 1];
-                int32 sdsRank;
-                int32 sdsDimSizes[MAX_VAR_DIMS];
-                int32 sdsType;
-                int32 sdsNumAttrs;
+    // Opens a dataset with its own chunk cache instead of the file's.  The handle isn't
+    // shared through the handle cache, and any cached handle on the dataset is closed, so
+    // the setting takes effect unless the caller still holds another handle on it.
+    UHDF_Dataset openDataset(const std::string &datasetName, const UHDF_ChunkCache &cache) const
+    {
+        std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+        if (fileType == UHDF_HDF5)
+            datasetCache.erase(trimPath(datasetName));
+
+        return openDataset(datasetName, cache, false);
+    }
+
+    UHDF_Group openGroup(const std::string &groupName) const
+    {
+        std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+        try
+        {
+            switch (fileType)
+            {
+            case UHDF_HDF4:
+                throw UHDF_Exception("No groups in HDF4 files");
+            case UHDF_HDF5:
+            {
+                // allow specifying a group in a subgroup (eg, "group1/group2"); HDF5 resolves the path
+                const std::string path = trimPath(groupName);
 
-                if (SDgetinfo( sdsid, sdsName, &sdsRank, sdsDimSizes, &sdsType, &sdsNumAttrs) < 0)
-                    throw UHDF_Exception("Error getting dataset info from dataset #" + boost::lexical_cast<std::string>(i) + " from file " + filename);
+                const UHDF_Group *cached = groupCache.find(path);
+                if (cached != NULL)
+                {
+                    ioCounters->add(UHDF_IOCounters::HANDLE_CACHE_HITS, 1);
+                    return cached->share();
+                }
+                ioCounters->add(UHDF_IOCounters::HANDLE_CACHE_MISSES, 1);
 
-                datasetNames.push_back(std::string(sdsName));
+                UHDF_Identifier id;
+                id.h5id = H5RootGroupId;
 
-                SDendaccess(sdsid);
+                UHDF_Group opened(id, path, filename, "", chunkCache, ioCounters);
+                opened.readerPool = readerPool;
+                opened.access = access;
+                opened.accessOptions = accessOptions;
+                groupCache.insert(path, opened.share());
+                return opened;
+            }
             }
-            break;
         }
-        case UHDF_HDF5:
+        catch (const UHDF_Exception &e)
         {
-            hsize_t numObjs;
-            if (H5Gget_num_objs(H5RootGroupId, &numObjs) < 0)
-                throw UHDF_Exception("Error getting number of objects from root group of " + filename);
+            throw UHDF_Exception("Couldn't open group " + groupName + " in file " + filename + ": " + e.what());
+        }
 
-            for (hsize_t i = 0; i < numObjs; i++)
-            {
-                if (H5Gget_objtype_by_idx(H5RootGroupId, i) == H5G_DATASET)
-                {
-                    char name[256];
-                    if (H5Gget_objname_by_idx(H5RootGroupId, i, name, 255) < 0)
-                        throw UHDF_Exception("Error getting name of object " + boost::lexical_cast<std::string>(i) + " from root group of " + filename);
+        // shouldn't reach here
+        throw UHDF_Exception("Error opening group " + groupName);
+    }
 
-                    datasetNames.push_back(name);
-                }
+    // Creates a dataset of the given type and shape, stored as options says, and opens it.
+    // HDF5 dataset names may be paths (eg, "group1/group2/dataset"); groups missing along
+    // the way are created.
+    UHDF_Dataset createDataset( const std::string &datasetName,
+                                const UHDF_DataType type,
+                                const std::vector<size_t> &dims,
+                                const UHDF_DatasetOptions &options = UHDF_DatasetOptions())
+    {
+        checkWritable();
+
+        try
+        {
+            switch (fileType)
+            {
+            case UHDF_HDF4:
+                UHDF_createH4Dataset(fileId.h4id, datasetName, type, dims, options);
+                h4IndexBuilt = false;
+                break;
+            case UHDF_HDF5:
+                UHDF_createH5Dataset(H5RootGroupId, trimPath(datasetName), type, dims, options);
+                break;
             }
-            break;
         }
+        catch (const UHDF_Exception &e)
+        {
+            throw UHDF_Exception("Couldn't create dataset " + datasetName + " in file " + filename + ": " + e.what());
         }
 
-        return datasetNames;
+        return openDataset(datasetName);
     }
 
-    std::list<std::string> getGroupNames() const
+    // HDF5 only; groups missing along the path are created too
+    UHDF_Group createGroup( const std::string &groupName)
     {
-        std::list<std::string> groupNames;
+        checkWritable();
 
-        switch(fileType)
+        if (fileType != UHDF_HDF5)
+            throw UHDF_Exception("Couldn't create group " + groupName + " in file " + filename + ": No groups in HDF4 files");
+
+        try
+        {
+            UHDF_createH5Group(H5RootGroupId, trimPath(groupName));
+        }
+        catch (const UHDF_Exception &e)
+        {
+            throw UHDF_Exception("Couldn't create group " + groupName + " in file " + filename + ": " + e.what());
+        }
+
+        return openGroup(groupName);
+    }
+
+    // creates a file attribute (on the root group, for HDF5) holding numValues values
+    template<typename T>
+    UHDF_Attribute createAttribute( const std::string &attributeName, const T *values, const size_t numValues)
+    {
+        checkWritable();
+
+        UHDF_Identifier owner;
+        switch (fileType)
         {
         case UHDF_HDF4:
+            owner = fileId;
             break;
         case UHDF_HDF5:
-        {
-            hsize_t numObjs;
-            if (H5Gget_num_objs(H5RootGroupId, &numObjs) < 0)
-                throw UHDF_Exception("Error getting number of objects from root group of " + filename);
+            owner.h5id = H5RootGroupId;
+            break;
+        }
+
+        attributeCache.clear();
+        return UHDF_Attribute(fileType, owner, attributeName, numValues, values);
+    }
+
+    UHDF_Attribute createAttribute( const std::string &attributeName, const std::string &value)
+    {
+        return createAttribute(attributeName, value.c_str(), value.size());
+    }
 
-            for (hsize_t i = 0; i < numObjs; i++)
+    // every attribute of the file (the root group's, for HDF5), read in one pass on first
+    // use and cached for the life of the file
+    const UHDF_AttributeMap &readAllAttributes() const
+    {
+        return attributeCache.get([this]() -> UHDF_AttributeMap
+        {
+            switch(fileType)
             {
-                if (H5Gget_objtype_by_idx(H5RootGroupId, i) == H5G_GROUP)
-                {
-                    char name[256];
-                    if (H5Gget_objname_by_idx(H5RootGroupId, i, name, 255) < 0)
-                        throw UHDF_Exception("Error getting name of object " + boost::lexical_cast<std::string>(i) + " from root group of " + filename);
+            case UHDF_HDF4:
+            {
+                int32 numDatasets;
+                int32 numAttributes;
 
-                    groupNames.push_back(name);
-                }
+                if (SDfileinfo( fileId.h4id, &numDatasets, &numAttributes) < 0)
+                    throw UHDF_Exception("Error getting file info from " + filename);
+
+                return UHDF_readH4Attributes(fileId.h4id, numAttributes, filename);
             }
+            case UHDF_HDF5:
+                return UHDF_readH5Attributes(H5RootGroupId, filename);
+            }
+            return UHDF_AttributeMap();
+        });
+    }
+
+    // Chunk cache for datasets opened from now on, from the file or its groups; see
+    // UHDF_ChunkCache.  Cached handles are closed, so they're reopened with the new setting.
+    void setChunkCache( const UHDF_ChunkCache &cache)
+    {
+        chunkCache = cache;
+        clearHandleCache();
+    }
+
+    const UHDF_ChunkCache &getChunkCache() const
+    {
+        return chunkCache;
+    }
+
+    const UHDF_FileAccessOptions &getAccessOptions() const
+    {
+        return accessOptions;
+    }
+
+    // Reader processes for readParallel on datasets opened from now on, from the file or its
+    // groups, instead of threads; NULL goes back to threads.  See UHDF_ProcessPool.  Cached
+    // handles are closed, so they're reopened with the new setting.
+    void setReaderPool( const std::shared_ptr<UHDF_ProcessPool> &pool)
+    {
+        readerPool = pool;
+        clearHandleCache();
+    }
+
+    const std::shared_ptr<UHDF_ProcessPool> &getReaderPool() const
+    {
+        return readerPool;
+    }
+
+    // Number of dataset and group handles (each) kept open for reuse by openDataset and
+    // openGroup, evicting the least recently used.  0 disables caching.
+    void setHandleCacheSize( const size_t maxHandles)
+    {
+        datasetCache.setCapacity(maxHandles);
+        groupCache.setCapacity(maxHandles);
+    }
+
+    size_t getHandleCacheSize() const
+    {
+        return datasetCache.getCapacity();
+    }
+
+    // closes every cached handle; handles already returned to callers stay valid
+    void clearHandleCache()
+    {
+        datasetCache.clear();
+        groupCache.clear();
+    }
+
+
+private:
+    std::string filename;
+    UHDF_FileType fileType;
+    UHDF_FileAccess access;
+    UHDF_FileAccessOptions accessOptions;
+    UHDF_Identifier fileId;
+
+    hid_t H5RootGroupId;
+
+    // open handles that openDataset and openGroup share; they're const and may be called
+    // from several threads at once, so the caches are only used under UHDF_libraryMutex()
+    mutable UHDF_LRUCache<std::string, UHDF_Dataset> datasetCache;
+    mutable UHDF_LRUCache<std::string, UHDF_Group> groupCache;
+
+    mutable UHDF_AttributeCache attributeCache;
+
+    std::shared_ptr<UHDF_IOCounters> ioCounters;
+
+    UHDF_ChunkCache chunkCache;
+    std::shared_ptr<UHDF_ProcessPool> readerPool;
+
+    // HDF4 datasets in index order and the index of each name, built on first use
+    mutable std::vector<UHDF_ObjectInfo> h4Datasets;
+    mutable std::unordered_map<std::string, int32> h4DatasetIndex;
+    mutable bool h4IndexBuilt;
+
+    // the image of a file opened from memory, which HDF5 reads in place
+    std::unique_ptr<UHDF_FileImage> fileImage;
+
+    // an empty file, for moving into
+    UHDF_File() :
+        fileType (UHDF_HDF5),
+        access (UHDF_READONLY),
+        H5RootGroupId (-1),
+        datasetCache (0),
+        groupCache (0),
+        h4IndexBuilt (false)
+    {
+        fileId.h5id = -1;
+    }
+
+    void openImage( const std::string &imageName)
+    {
+        filename = imageName;
+        fileType = UHDF_HDF5;
+        fileId.h5id = -1;
+        H5RootGroupId = -1;
+
+        switch (UHDF_imageFormat(fileImage->data, fileImage->size))
+        {
+        case 0:
             break;
+        case 4:
+            throw UHDF_Exception("Can't open " + filename + " from memory: HDF4 files can only be opened from disk");
+        default:
+            throw UHDF_Exception(filename + " is not an HDF5 file image");
         }
-        }
 
-        return groupNames;
+        fileId.h5id = UHDF_openH5Image(*fileImage, filename);
+        if (fileId.h5id < 0)
+            throw UHDF_Exception("Unable to open " + filename);
+        ioCounters->add(UHDF_IOCounters::OPENS, 1);
+
+        H5RootGroupId = H5Gopen2( fileId.h5id, "/", H5P_DEFAULT);
+        if (H5RootGroupId < 0)
+            throw UHDF_Exception("Couldn't open root group of file " + filename);
     }
 
-    UHDF_Dataset openDataset(const std::string &datasetName) const
+    void checkWritable() const
     {
+        if (access == UHDF_READONLY)
+            throw UHDF_Exception("File " + filename + " is open read-only");
+    }
+
+    // shared handles come from, and go into, the handle cache
+    UHDF_Dataset openDataset( const std::string &datasetName, const UHDF_ChunkCache &cache, const bool shared) const
+    {
+        std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
         try
         {
             switch (fileType)
             {
             case UHDF_HDF4:
-                return UHDF_Dataset(fileType, fileId, datasetName);
+            {
+                UHDF_Dataset opened(fileType, fileId, datasetName, filename, "", getH4DatasetIndex(datasetName), cache, ioCounters);
+                opened.readerPool = readerPool;
+                opened.access = access;
+                opened.accessOptions = accessOptions;
+                return opened;
+            }
             case UHDF_HDF5:
             {
+                // allow specifying a dataset in a subgroup (eg, "group1/group2/dataset"); HDF5 resolves the path
+                const std::string path = trimPath(datasetName);
+
                 UHDF_Identifier id;
                 id.h5id = H5RootGroupId;
 
-                // allow specifying a dataset in a subgroup (eg, "group1/group2/dataset")
-                const size_t delimiterPos = datasetName.find("/");
-                if (delimiterPos == std::string::npos)
+                if (!shared)
                 {
-                    return UHDF_Dataset(fileType, id, datasetName);
+                    UHDF_Dataset opened(fileType, id, path, filename, "", -1, cache, ioCounters);
+                    opened.readerPool = readerPool;
+                    opened.access = access;
+                    opened.accessOptions = accessOptions;
+                    return opened;
                 }
-                else
+
+                // datasets opened before share the cached handle and metadata
+                const UHDF_Dataset *cached = datasetCache.find(path);
+                if (cached != NULL)
                 {
-                    const std::string groupName = datasetName.substr(0, delimiterPos);
-                    return UHDF_Group(id, groupName).openDataset(datasetName.substr(delimiterPos+1, std::string::npos));
+                    ioCounters->add(UHDF_IOCounters::HANDLE_CACHE_HITS, 1);
+                    return cached->share();
                 }
+                ioCounters->add(UHDF_IOCounters::HANDLE_CACHE_MISSES, 1);
+
+                UHDF_Dataset opened(fileType, id, path, filename, "", -1, cache, ioCounters);
+                opened.readerPool = readerPool;
+                opened.access = access;
+                opened.accessOptions = accessOptions;
+                datasetCache.insert(path, opened.share());
+                return opened;
             }
             }
         }
@@ -218,51 +647,390 @@ public:
         throw UHDF_Exception("Error opening dataset " + datasetName);
     }
 
-    UHDF_Group openGroup(const std::string &groupName) const
+    static std::string trimPath( const std::string &objectPath)
     {
-        try
+        const size_t first = objectPath.find_first_not_of('/');
+        if (first == std::string::npos)
+            return "";
+        return objectPath.substr(first);
+    }
+
+    std::vector<std::string> getChildNames( const UHDF_ObjectType objType) const
+    {
+        std::vector<std::string> names;
+        for (const auto &child : getChildren())
         {
-            switch (fileType)
+            if (child.type == objType)
+                names.push_back(child.name);
+        }
+        return names;
+    }
+
+    void buildH4Index() const
+    {
+        if (h4IndexBuilt)
+            return;
+
+        std::vector<UHDF_ObjectInfo> datasets = UHDF_listH4Datasets(fileId.h4id, filename);
+        std::unordered_map<std::string, int32> indices;
+
+        // like SDnametoindex, the first dataset with a given name wins
+        for (size_t i = 0; i < datasets.size(); i++)
+            indices.insert(std::make_pair(datasets[i].name, static_cast<int32>(i)));
+
+        h4Datasets.swap(datasets);
+        h4DatasetIndex.swap(indices);
+        h4IndexBuilt = true;
+    }
+
+    int32 getH4DatasetIndex( const std::string &datasetName) const
+    {
+        buildH4Index();
+
+        const auto iter = h4DatasetIndex.find(datasetName);
+        if (iter == h4DatasetIndex.end())
+            throw UHDF_Exception("Couldn't find dataset named '" + datasetName + "'");
+        return iter->second;
+    }
+};
+
+//--------------------------------
+// UHDF_Dataset members that need to reopen the dataset's file
+
+template<typename T>
+void UHDF_Dataset::readParallel( const int32 *const start,
+                                 const int32 *const stride,
+                                 const int32 *const count,
+                                 T* buffer,
+                                 unsigned numThreads) const
+{
+    if (readerPool && shape().rank > 0 && canReopenFile())
+    {
+        readerPool->read(*this, start, stride, count, buffer);
+        return;
+    }
+
+    if (numThreads == 0)
+        numThreads = UHDF_defaultThreadCount();
+
+    if (shape().rank == 0 || numThreads == 1)
+    {
+        read(start, stride, count, buffer);
+        return;
+    }
+
+    size_t rowElems = 1;
+    for (int i = 0; i < shape().rank; i++)
+    {
+        if (count[i] <= 0)
+            throw UHDF_Exception("Zero or negative count given when reading");
+        if (i > 0)
+            rowElems *= count[i];
+    }
+
+    // decompression inside H5Dread would hold the library lock; fetching the chunks
+    // compressed lets the workers decode them outside it
+    if (std::all_of(stride, stride + shape().rank, [](const int32 s) { return s == 1; }) && hasDirectChunkFilters())
+    {
+        readChunksDirect(start, count, buffer, numThreads);
+        return;
+    }
+
+    if (!canReopenFile())
+    {
+        read(start, stride, count, buffer);
+        return;
+    }
+
+    // a few pieces per thread, so a slow piece doesn't leave the other threads idle
+    const std::vector<UHDF_RowRange> pieces = UHDF_splitRows(start[0], stride[0], count[0], getTileDimensions()[0], numThreads * 4);
+    if (pieces.size() == 1)
+    {
+        read(start, stride, count, buffer);
+        return;
+    }
+
+    std::atomic<size_t> nextPiece(0);
+    UHDF_ThreadPool pool(std::min<size_t>(numThreads, pieces.size()));
+    std::vector<std::future<void>> results;
+
+    for (size_t t = 0; t < pool.size(); t++)
+    {
+        results.push_back(pool.submit([&]()
+        {
+            std::recursive_mutex &mutex = UHDF_libraryMutex();
+            std::unique_lock<std::recursive_mutex> lock(mutex);
+
+            UHDF_File file(filename, accessOptions);
+            file.setChunkCache(chunkCache);
+            UHDF_Dataset dataset = file.openDataset(path);
+            dataset.libraryLock = &mutex;
+
+            // the worker's reads, and its close, count towards this dataset
+            dataset.ioCounters = ioCounters;
+            ioCounters->add(UHDF_IOCounters::OPENS, 1);
+
+            UHDF_RelockOnExit relock(lock);
+            lock.unlock();
+
+            std::vector<int32> pieceStart(start, start + shape().rank);
+            std::vector<int32> pieceCount(count, count + shape().rank);
+
+            for (size_t p = nextPiece++; p < pieces.size(); p = nextPiece++)
             {
-            case UHDF_HDF4:
-                throw UHDF_Exception("No groups in HDF4 files");
-            case UHDF_HDF5:
+                pieceStart[0] = start[0] + pieces[p].first * stride[0];
+                pieceCount[0] = pieces[p].count;
+
+                dataset.read(pieceStart.data(), stride, pieceCount.data(), buffer + pieces[p].first * rowElems);
+            }
+        }));
+    }
+
+    UHDF_waitAll(results);
+}
+
+template <typename T>
+std::vector<T> UHDF_Dataset::readAllParallel( unsigned numThreads) const
+{
+    std::vector<T> buffer;
+
+    buffer.resize(getNumElements(), 0);
+    std::vector<int32> start(shape().rank, 0);
+    std::vector<int32> stride(shape().rank, 1);
+    std::vector<int32> count(shape().dimensions.begin(), shape().dimensions.end());
+
+    readParallel(start.data(), stride.data(), count.data(), buffer.data(), numThreads);
+    return buffer;
+}
+
+template<typename ACCUMULATOR>
+ACCUMULATOR UHDF_Dataset::reduce( const ACCUMULATOR &initial, unsigned numThreads) const
+{
+    switch(shape().dataType)
+    {
+    case UHDF_UINT8:
+        return reduceAs<uint8_t>(initial, numThreads);
+    case UHDF_INT8:
+        return reduceAs<int8_t>(initial, numThreads);
+    case UHDF_UINT16:
+        return reduceAs<uint16_t>(initial, numThreads);
+    case UHDF_INT16:
+        return reduceAs<int16_t>(initial, numThreads);
+    case UHDF_UINT32:
+        return reduceAs<uint32_t>(initial, numThreads);
+    case UHDF_INT32:
+        return reduceAs<int32_t>(initial, numThreads);
+    case UHDF_UINT64:
+        return reduceAs<uint64_t>(initial, numThreads);
+    case UHDF_INT64:
+        return reduceAs<int64_t>(initial, numThreads);
+    case UHDF_FLOAT32:
+        return reduceAs<float>(initial, numThreads);
+    case UHDF_FLOAT64:
+        return reduceAs<double>(initial, numThreads);
+    default:
+        throw UHDF_Exception("Can't reduce dataset '" + datasetname + "' of type " + UHDFTypeName(shape().dataType));
+    }
+}
+
+template<typename FILE_T, typename ACCUMULATOR>
+ACCUMULATOR UHDF_Dataset::reduceAs( const ACCUMULATOR &initial, unsigned numThreads) const
+{
+    if (numThreads == 0)
+        numThreads = UHDF_defaultThreadCount();
+
+    const UHDF_TileGrid grid(getTileDimensions(), std::vector<int32>(shape().rank, 0), std::vector<int32>(shape().dimensions.begin(), shape().dimensions.end()));
+    const size_t numTiles = grid.getNumTiles();
+
+    ACCUMULATOR result(initial);
+
+    if (numThreads == 1 || numTiles <= 1 || !canReopenFile())
+    {
+        UHDF_Buffer<FILE_T> buffer;
+        for (size_t t = 0; t < numTiles; t++)
+        {
+            const UHDF_Tile tile = grid.getTile(t);
+            buffer.resize(tile.getNumElements());
+            read(tile, buffer.data());
+            result.add(buffer.data(), buffer.size());
+        }
+        return result;
+    }
+
+    std::atomic<size_t> nextTile(0);
+    std::mutex resultMutex;
+    UHDF_ThreadPool pool(std::min<size_t>(numThreads, numTiles));
+    std::vector<std::future<void>> results;
+
+    for (size_t w = 0; w < pool.size(); w++)
+    {
+        results.push_back(pool.submit([&]()
+        {
+            std::recursive_mutex &mutex = UHDF_libraryMutex();
+            std::unique_lock<std::recursive_mutex> lock(mutex);
+
+            UHDF_File file(filename, accessOptions);
+            file.setChunkCache(chunkCache);
+            UHDF_Dataset dataset = file.openDataset(path);
+            dataset.libraryLock = &mutex;
+
+            // the worker's reads, and its close, count towards this dataset
+            dataset.ioCounters = ioCounters;
+            ioCounters->add(UHDF_IOCounters::OPENS, 1);
+
+            UHDF_RelockOnExit relock(lock);
+            lock.unlock();
+
+            ACCUMULATOR partial(initial);
+            UHDF_Buffer<FILE_T> buffer;
+
+            for (size_t t = nextTile++; t < numTiles; t = nextTile++)
             {
-                UHDF_Identifier id;
-                id.h5id = H5RootGroupId;
+                const UHDF_Tile tile = grid.getTile(t);
+                buffer.resize(tile.getNumElements());
+                dataset.read(tile, buffer.data());
+                partial.add(buffer.data(), buffer.size());
+            }
 
-                // allow specifying a dataset in a subgroup (eg, "group1/group2/dataset")
-                const size_t delimiterPos = groupName.find("/");
-                if (delimiterPos == std::string::npos)
-                {
-                    return UHDF_Group(id, groupName);
-                }
-                else
-                {
-                    const std::string groupName = groupName.substr(0, delimiterPos);
-                    return UHDF_Group(id, groupName).openGroup(groupName.substr(delimiterPos+1, std::string::npos));
-                }
+            std::lock_guard<std::mutex> resultLock(resultMutex);
+            result.merge(partial);
+        }));
+    }
 
-                return UHDF_Group(id, groupName);
+    UHDF_waitAll(results);
+    return result;
+}
+
+//--------------------------------
+// reader processes
+
+inline void UHDF_ProcessPool::serve( const int socket, void *const buffer) const
+{
+#ifdef UHDF_HAVE_FORK
+    UHDF_LRUCache<std::string, UHDF_File> files(maxOpenFiles);
+
+    for (;;)
+    {
+        UHDF_ReaderRequest request;
+        int outputDescriptor;
+        if (!UHDF_receiveWithDescriptor(socket, &request, sizeof(request), outputDescriptor))
+            return;
+
+        // the shared output is only mapped while this read writes to it
+        void *outputMapping = MAP_FAILED;
+        size_t outputMappingBytes = 0;
+        const auto closeOutput = [&]()
+        {
+            if (outputMapping != MAP_FAILED)
+                munmap(outputMapping, outputMappingBytes);
+            if (outputDescriptor >= 0)
+                close(outputDescriptor);
+            outputMapping = MAP_FAILED;
+            outputDescriptor = -1;
+        };
+
+        std::string fileName(request.fileNameLength, '\0');
+        std::string datasetPath(request.datasetNameLength, '\0');
+        if (!UHDF_receiveAll(socket, &fileName[0], fileName.size()) ||
+            !UHDF_receiveAll(socket, &datasetPath[0], datasetPath.size()))
+        {
+            closeOutput();
+            return;
+        }
+
+        std::string message;
+        try
+        {
+            void *output = buffer;
+            if (request.sharedOutput)
+            {
+                if (outputDescriptor < 0)
+                    throw UHDF_Exception("No shared memory came with the read of dataset '" + datasetPath + "'");
+
+                // mappings start on a page
+                const size_t pageBytes = sysconf(_SC_PAGESIZE);
+                const size_t mapStart = request.outputOffset / pageBytes * pageBytes;
+                outputMappingBytes = request.outputOffset + request.outputBytes - mapStart;
+                outputMapping = mmap(NULL, outputMappingBytes, PROT_READ | PROT_WRITE, MAP_SHARED, outputDescriptor, mapStart);
+                if (outputMapping == MAP_FAILED)
+                    throw UHDF_Exception(std::string("Couldn't map the shared memory to read dataset '") + datasetPath + "' into: " + strerror(errno));
+                output = static_cast<char*>(outputMapping) + (request.outputOffset - mapStart);
+            }
+
+            // opened the way the dataset's own file was, and again if a read asks for other options
+            UHDF_File *file = files.find(fileName);
+            if (file != NULL && !UHDF_sameAccessOptions(file->getAccessOptions(), request.accessOptions))
+            {
+                files.erase(fileName);
+                file = NULL;
             }
+            if (file == NULL)
+            {
+                files.insert(fileName, UHDF_File(fileName, request.accessOptions));
+                file = files.find(fileName);
+            }
+
+            const UHDF_ChunkCache &cache = file->getChunkCache();
+            if (cache.mode != request.chunkCache.mode || cache.numBytes != request.chunkCache.numBytes ||
+                cache.numSlots != request.chunkCache.numSlots || cache.preemption != request.chunkCache.preemption)
+                file->setChunkCache(request.chunkCache);
+
+            const UHDF_Dataset dataset = file->openDataset(datasetPath);
+            if (dataset.shape().rank != request.rank)
+                throw UHDF_Exception("Dataset '" + datasetPath + "' has " + boost::lexical_cast<std::string>(dataset.shape().rank) + " dimensions, not " +
+                                     boost::lexical_cast<std::string>(request.rank));
+
+            switch(request.memType)
+            {
+            case UHDF_UINT8:
+                dataset.read(request.start, request.stride, request.count, static_cast<uint8_t*>(output));
+                break;
+            case UHDF_INT8:
+                dataset.read(request.start, request.stride, request.count, static_cast<int8_t*>(output));
+                break;
+            case UHDF_UINT16:
+                dataset.read(request.start, request.stride, request.count, static_cast<uint16_t*>(output));
+                break;
+            case UHDF_INT16:
+                dataset.read(request.start, request.stride, request.count, static_cast<int16_t*>(output));
+                break;
+            case UHDF_UINT32:
+                dataset.read(request.start, request.stride, request.count, static_cast<uint32_t*>(output));
+                break;
+            case UHDF_INT32:
+                dataset.read(request.start, request.stride, request.count, static_cast<int32_t*>(output));
+                break;
+            case UHDF_UINT64:
+                dataset.read(request.start, request.stride, request.count, static_cast<uint64_t*>(output));
+                break;
+            case UHDF_INT64:
+                dataset.read(request.start, request.stride, request.count, static_cast<int64_t*>(output));
+                break;
+            case UHDF_FLOAT32:
+                dataset.read(request.start, request.stride, request.count, static_cast<float*>(output));
+                break;
+            case UHDF_FLOAT64:
+                dataset.read(request.start, request.stride, request.count, static_cast<double*>(output));
+                break;
+            default:
+                throw UHDF_Exception("Can't read dataset '" + datasetPath + "' as " + UHDFTypeName(static_cast<UHDF_DataType>(request.memType)));
             }
         }
-        catch (const UHDF_Exception &e)
+        catch (const std::exception &e)
         {
-            throw UHDF_Exception("Couldn't open group " + groupName + " in file " + filename + ": " + e.what());
+            message = e.what();
+            if (message.empty())
+                message = "Error reading dataset '" + datasetPath + "' from " + fileName;
         }
+        closeOutput();
 
-        // shouldn't reach here
-        throw UHDF_Exception("Error opening group " + groupName);
+        UHDF_ReaderReply reply;
+        reply.status = message.empty() ? 0 : 1;
+        reply.messageLength = message.size();
+        if (!UHDF_sendAll(socket, &reply, sizeof(reply)) || !UHDF_sendAll(socket, message.data(), message.size()))
+            return;
     }
-
-
-private:
-    std::string filename;
-    UHDF_FileType fileType;
-    UHDF_Identifier fileId;
-
-    hid_t H5RootGroupId;
-};
+#endif
+}
 
 #endif
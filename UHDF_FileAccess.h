@@ -0,0 +1,197 @@
+#ifndef UHDF_FILEACCESS_H
+#define UHDF_FILEACCESS_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstring>
+
+#include <boost/lexical_cast.hpp>
+
+#include "UHDF_Types.h"
+#include "UHDF_H5Holder.h"
+
+typedef enum
+{
+    UHDF_DRIVER_SEC2,   // POSIX I/O, the library default
+    UHDF_DRIVER_STDIO,  // buffered C stdio
+    UHDF_DRIVER_CORE    // whole file held in memory, read in one go when opened
+} UHDF_FileDriver;
+
+// How HDF5 files are accessed; HDF4 files ignore these.  Zero sizes keep the library's
+// defaults.
+struct UHDF_FileAccessOptions
+{
+    UHDF_FileAccessOptions() :
+        driver (UHDF_DRIVER_SEC2),
+        coreIncrement (1024 * 1024),
+        coreWriteBack (true),
+        pageBufferBytes (0),
+        filePageBytes (0),
+        metadataBlockBytes (0),
+        sieveBufferBytes (0)
+    {}
+
+    UHDF_FileDriver driver;
+    size_t coreIncrement;       // core driver: memory grows by this much at a time when writing
+    bool coreWriteBack;         // core driver: write changes back to the file when it's closed
+    size_t pageBufferBytes;     // page buffer, for files created with filePageBytes set
+    size_t filePageBytes;       // UHDF_CREATE only: make a paged file with pages this size
+    size_t metadataBlockBytes;  // metadata is allocated in blocks of at least this size
+    size_t sieveBufferBytes;    // buffer for raw data of contiguous datasets
+};
+
+// true if files opened with a and b would be accessed the same way
+static inline bool UHDF_sameAccessOptions( const UHDF_FileAccessOptions &a, const UHDF_FileAccessOptions &b)
+{
+    return a.driver == b.driver && a.coreIncrement == b.coreIncrement && a.coreWriteBack == b.coreWriteBack &&
+           a.pageBufferBytes == b.pageBufferBytes && a.filePageBytes == b.filePageBytes &&
+           a.metadataBlockBytes == b.metadataBlockBytes && a.sieveBufferBytes == b.sieveBufferBytes;
+}
+
+// sets up a file access property list for options
+static inline void UHDF_setH5AccessOptions( const hid_t accessPlist, const UHDF_FileAccessOptions &options, const std::string &fileName)
+{
+    herr_t status = 0;
+
+    switch (options.driver)
+    {
+    case UHDF_DRIVER_SEC2:
+        break;
+    case UHDF_DRIVER_STDIO:
+        status = H5Pset_fapl_stdio(accessPlist);
+        break;
+    case UHDF_DRIVER_CORE:
+        status = H5Pset_fapl_core(accessPlist, options.coreIncrement, options.coreWriteBack);
+        break;
+    }
+
+    if (status >= 0 && options.pageBufferBytes > 0)
+    {
+#if H5_VERSION_GE(1,10,1)
+        status = H5Pset_page_buffer_size(accessPlist, options.pageBufferBytes, 0, 0);
+#else
+        throw UHDF_Exception("Page buffering needs HDF5 1.10.1 or later, for " + fileName);
+#endif
+    }
+    if (status >= 0 && options.metadataBlockBytes > 0)
+        status = H5Pset_meta_block_size(accessPlist, options.metadataBlockBytes);
+    if (status >= 0 && options.sieveBufferBytes > 0)
+        status = H5Pset_sieve_buf_size(accessPlist, options.sieveBufferBytes);
+
+    if (status < 0)
+        throw UHDF_Exception("Error setting up file access options for " + fileName);
+}
+
+// sets up a file creation property list for options
+static inline void UHDF_setH5CreateOptions( const hid_t createPlist, const UHDF_FileAccessOptions &options, const std::string &fileName)
+{
+    if (options.filePageBytes == 0)
+        return;
+
+#if H5_VERSION_GE(1,10,1)
+    if (H5Pset_file_space_strategy(createPlist, H5F_FSPACE_STRATEGY_PAGE, 0, 1) < 0 ||
+        H5Pset_file_space_page_size(createPlist, options.filePageBytes) < 0)
+        throw UHDF_Exception("Error setting up paged file creation for " + fileName);
+#else
+    throw UHDF_Exception("Paged files need HDF5 1.10.1 or later, for " + fileName);
+#endif
+}
+
+//--------------------------------
+// Files opened from memory
+
+// A file image handed to HDF5 without copying it.  The library asks for a buffer the size
+// of the image and then to copy the image into it; these callbacks give it the image
+// itself and make the copy a no-op.  The image is read-only, so it's never resized, and
+// it's never freed by the library.
+struct UHDF_FileImage
+{
+    const void *data;
+    size_t size;
+    std::vector<char> owned;  // the image, when the file was given ownership of it
+};
+
+static inline void *UHDF_imageMalloc( size_t size, H5FD_file_image_op_t, void *userData)
+{
+    UHDF_FileImage *image = static_cast<UHDF_FileImage*>(userData);
+    return (size == image->size) ? const_cast<void*>(image->data) : NULL;
+}
+
+static inline void *UHDF_imageMemcpy( void *dest, const void *src, size_t size, H5FD_file_image_op_t, void *userData)
+{
+    UHDF_FileImage *image = static_cast<UHDF_FileImage*>(userData);
+    return (dest == src && dest == image->data && size <= image->size) ? dest : NULL;
+}
+
+static inline void *UHDF_imageRealloc( void *, size_t, H5FD_file_image_op_t, void *)
+{
+    return NULL;
+}
+
+static inline herr_t UHDF_imageFree( void *, H5FD_file_image_op_t, void *)
+{
+    return 0;
+}
+
+// the image outlives every property list and file that refers to it, so there's nothing to count
+static inline void *UHDF_imageUserDataCopy( void *userData)
+{
+    return userData;
+}
+
+static inline herr_t UHDF_imageUserDataFree( void *)
+{
+    return 0;
+}
+
+// 0 for HDF5, 4 for HDF4, -1 for neither; HDF5 signatures can follow a user block
+static inline int UHDF_imageFormat( const void *data, const size_t size)
+{
+    static const char h5Signature[] = "\x89HDF\r\n\x1a\n";
+    static const char h4Signature[] = "\x0e\x03\x13\x01";
+    const char *bytes = static_cast<const char*>(data);
+
+    if (size >= 4 && memcmp(bytes, h4Signature, 4) == 0)
+        return 4;
+
+    for (size_t offset = 0; offset + 8 <= size; offset = (offset == 0) ? 512 : offset * 2)
+    {
+        if (memcmp(bytes + offset, h5Signature, 8) == 0)
+            return 0;
+    }
+
+    return -1;
+}
+
+// HDF5 tells core-driver files apart by name, so every image gets one of its own
+static inline std::string UHDF_uniqueImageName()
+{
+    static std::atomic<unsigned long> counter(0);
+    return "uhdf-image-" + boost::lexical_cast<std::string>(counter++);
+}
+
+// opens image read-only through the core driver, without copying it
+static inline hid_t UHDF_openH5Image( UHDF_FileImage &image, const std::string &imageName)
+{
+    const UHDF_PlistHolder accessPlist(H5Pcreate(H5P_FILE_ACCESS));
+
+    H5FD_file_image_callbacks_t callbacks;
+    callbacks.image_malloc = UHDF_imageMalloc;
+    callbacks.image_memcpy = UHDF_imageMemcpy;
+    callbacks.image_realloc = UHDF_imageRealloc;
+    callbacks.image_free = UHDF_imageFree;
+    callbacks.udata_copy = UHDF_imageUserDataCopy;
+    callbacks.udata_free = UHDF_imageUserDataFree;
+    callbacks.udata = &image;
+
+    // the callbacks have to be in place before the image is
+    if (H5Pset_fapl_core(accessPlist.get(), 1024 * 1024, false) < 0 ||
+        H5Pset_file_image_callbacks(accessPlist.get(), &callbacks) < 0 ||
+        H5Pset_file_image(accessPlist.get(), const_cast<void*>(image.data), image.size) < 0)
+        throw UHDF_Exception("Error setting up file image for " + imageName);
+
+    return H5Fopen(UHDF_uniqueImageName().c_str(), H5F_ACC_RDONLY, accessPlist.get());
+}
+
+#endif // UHDF_FILEACCESS_H
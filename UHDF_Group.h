@@ -4,9 +4,13 @@
 #include "UHDF_Types.h"
 #include "UHDF_Interfaces.h"
 #include "UHDF_Dataset.h"
+#include "UHDF_Visit.h"
+#include "UHDF_Create.h"
 
 #include <list>
 #include <string>
+#include <vector>
+#include <utility>
 
 
 // groups don't exist in HDF4, so all UHDF_Groups are HDF5
@@ -19,6 +23,52 @@ public:
     {
         if (id.h5id >= 0)
             H5Gclose(id.h5id);
+
+        if (ioCounters)
+            ioCounters->add(UHDF_IOCounters::CLOSES, 1);
+    }
+
+    // movable but not copyable, like UHDF_Dataset; share() gives another handle on the group
+    UHDF_Group( UHDF_Group &&other) noexcept :
+        UHDF_Group()
+    {
+        swap(other);
+    }
+
+    UHDF_Group &operator=( UHDF_Group &&other) noexcept
+    {
+        UHDF_Group moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    void swap( UHDF_Group &other) noexcept
+    {
+        std::swap(id, other.id);
+        std::swap(groupname, other.groupname);
+        std::swap(filename, other.filename);
+        std::swap(path, other.path);
+        std::swap(attributeCache, other.attributeCache);
+        std::swap(chunkCache, other.chunkCache);
+        std::swap(readerPool, other.readerPool);
+        std::swap(access, other.access);
+        std::swap(accessOptions, other.accessOptions);
+        std::swap(ioCounters, other.ioCounters);
+    }
+
+    // another handle on the same open group, sharing its reference-counted id
+    UHDF_Group share() const
+    {
+        UHDF_Group handle(*this);
+        if (H5Iinc_ref(id.h5id) < 0)
+        {
+            handle.id.h5id = -1;
+            throw UHDF_Exception("Couldn't share handle of group '" + groupname + "'");
+        }
+        if (ioCounters)
+            ioCounters->add(UHDF_IOCounters::OPENS, 1);
+
+        return handle;
     }
 
     const std::string &getName() const
@@ -26,59 +76,64 @@ public:
         return groupname;
     }
 
-    std::list<std::string> getGroupNames() const
+    // full path of the group within its file
+    const std::string &getPath() const
     {
-        return getObjNames(H5G_GROUP);
+        return path;
     }
 
-    std::list<std::string> getDatasetNames() const
+    const std::string &getFileName() const
     {
-        return getObjNames(H5G_DATASET);
+        return filename;
     }
 
-    std::list<std::string> getAttributeNames() const
+    // members of the group with their types, in one pass over its links
+    std::vector<UHDF_ObjectInfo> getChildren() const
     {
-        std::list<std::string> names;
-
-        const int numAttrs = H5Aget_num_attrs(id.h5id);
-        if (numAttrs < 0)
-            throw UHDF_Exception("Error retrieving the number of attributes in group '" + groupname + "'");
+        return UHDF_listH5Group(id.h5id, path);
+    }
 
-        for (int i = 0; i < numAttrs; i++)
-        {
-            const ssize_t nameLength = H5Aget_name_by_idx(id.h5id, ".", H5_INDEX_NAME, H5_ITER_NATIVE, i, NULL, 0, H5P_DEFAULT);
-            if (nameLength < 0)
-                throw UHDF_Exception("Error getting name of attribute " + boost::lexical_cast<std::string>(i) + " of group '" + groupname + "'");
-            if (nameLength == 0)
-                continue;
+    // calls visitor for every object below the group, parents before children, until it returns false
+    void visit( const UHDF_Visitor &visitor) const
+    {
+        UHDF_visitH5Group(id.h5id, path, visitor);
+    }
 
-            std::unique_ptr<char[]> name(new char[nameLength + 1]);
-            memset(name.get(), 0, nameLength + 1);
+    std::vector<std::string> getGroupNames() const
+    {
+        return getChildNames(UHDF_OBJ_GROUP);
+    }
 
-            if (H5Aget_name_by_idx(id.h5id, ".", H5_INDEX_NAME, H5_ITER_NATIVE, i, name.get(), nameLength + 1, H5P_DEFAULT) < 0)
-                throw UHDF_Exception("Error getting name of attribute " + boost::lexical_cast<std::string>(i) + " of group '" + groupname + "'");
+    std::vector<std::string> getDatasetNames() const
+    {
+        return getChildNames(UHDF_OBJ_DATASET);
+    }
 
-            names.push_back(std::string(name.get()));
-        }
+    std::list<std::string> getAttributeNames() const
+    {
+        return UHDF_listH5AttributeNames(id.h5id, groupname);
+    }
 
-        return names;
+    // every attribute's type and value, read in one pass on first use and cached; the map
+    // stays valid as long as this group or another handle on it from the same file
+    const UHDF_AttributeMap &readAllAttributes() const
+    {
+        return attributeCache->get([this]() -> UHDF_AttributeMap
+        {
+            return UHDF_readH5Attributes(id.h5id, groupname);
+        });
     }
 
     UHDF_Group openGroup(const std::string &groupName) const
     {
         try
         {
-            // allow specifying a dataset in a subgroup (eg, "group1/group2/dataset")
-            const size_t delimiterPos = groupName.find("/");
-            if (delimiterPos == std::string::npos)
-            {
-                return UHDF_Group(id, groupName);
-            }
-            else
-            {
-                const std::string groupName = groupName.substr(0, delimiterPos);
-                return UHDF_Group(id, groupName).openGroup(groupName.substr(delimiterPos+1, std::string::npos));
-            }
+            // allow specifying a group in a subgroup (eg, "group1/group2"); HDF5 resolves the path
+            UHDF_Group opened(id, groupName, filename, path, chunkCache, ioCounters);
+            opened.readerPool = readerPool;
+            opened.access = access;
+            opened.accessOptions = accessOptions;
+            return opened;
         }
         catch (const UHDF_Exception &e)
         {
@@ -93,17 +148,12 @@ public:
     {
         try
         {
-            // allow specifying a dataset in a subgroup (eg, "group1/group2/dataset")
-            const size_t delimiterPos = datasetName.find("/");
-            if (delimiterPos == std::string::npos)
-            {
-                return UHDF_Dataset(UHDF_HDF5, id, datasetName);
-            }
-            else
-            {
-                const std::string groupName = datasetName.substr(0, delimiterPos);
-                return UHDF_Group(id, groupName).openDataset(datasetName.substr(delimiterPos+1, std::string::npos));
-            }
+            // allow specifying a dataset in a subgroup (eg, "group1/group2/dataset"); HDF5 resolves the path
+            UHDF_Dataset opened(UHDF_HDF5, id, datasetName, filename, path, -1, chunkCache, ioCounters);
+            opened.readerPool = readerPool;
+            opened.access = access;
+            opened.accessOptions = accessOptions;
+            return opened;
         }
         catch (const UHDF_Exception &e)
         {
@@ -126,39 +176,132 @@ public:
         }
     }
 
+    // Creates a dataset in the group, stored as options says, and opens it; groups missing
+    // along a path in datasetName are created too.
+    UHDF_Dataset createDataset( const std::string &datasetName,
+                                const UHDF_DataType type,
+                                const std::vector<size_t> &dims,
+                                const UHDF_DatasetOptions &options = UHDF_DatasetOptions())
+    {
+        checkWritable();
+        try
+        {
+            UHDF_createH5Dataset(id.h5id, datasetName, type, dims, options);
+        }
+        catch (const UHDF_Exception &e)
+        {
+            throw UHDF_Exception("Couldn't create dataset " + datasetName + " in group " + groupname + ": " + e.what());
+        }
+
+        return openDataset(datasetName);
+    }
+
+    UHDF_Group createGroup( const std::string &groupName)
+    {
+        checkWritable();
+        try
+        {
+            UHDF_createH5Group(id.h5id, groupName);
+        }
+        catch (const UHDF_Exception &e)
+        {
+            throw UHDF_Exception("Couldn't create group " + groupName + " in group " + groupname + ": " + e.what());
+        }
+
+        return openGroup(groupName);
+    }
+
+    template<typename T>
+    UHDF_Attribute createAttribute( const std::string &attributeName, const T *values, const size_t numValues)
+    {
+        checkWritable();
+        try
+        {
+            attributeCache->clear();
+            return UHDF_Attribute(UHDF_HDF5, id, attributeName, numValues, values);
+        }
+        catch (const UHDF_Exception &e)
+        {
+            throw UHDF_Exception("Couldn't create attribute " + attributeName + " in group " + groupname + ": " + e.what());
+        }
+    }
+
+    UHDF_Attribute createAttribute( const std::string &attributeName, const std::string &value)
+    {
+        return createAttribute(attributeName, value.c_str(), value.size());
+    }
+
 private:
     UHDF_Identifier id;
     std::string groupname;
+    std::string filename;
+    std::string path;
+
+    // shared by handles made from the same cached group
+    std::shared_ptr<UHDF_AttributeCache> attributeCache;
 
-    UHDF_Group( UHDF_Identifier ownerId, const std::string &groupName)
+    // passed on to datasets opened from the group
+    UHDF_ChunkCache chunkCache;
+    std::shared_ptr<UHDF_ProcessPool> readerPool;
+    UHDF_FileAccess access;
+    UHDF_FileAccessOptions accessOptions;
+
+    // the file's; groups don't keep counts of their own
+    std::shared_ptr<UHDF_IOCounters> ioCounters;
+
+    // the group name may be a path relative to the owner (eg, "group1/group2")
+    UHDF_Group( UHDF_Identifier ownerId,
+                const std::string &groupName,
+                const std::string &fileName,
+                const std::string &parentPath,
+                const UHDF_ChunkCache &cacheSettings = UHDF_ChunkCache(),
+                const std::shared_ptr<UHDF_IOCounters> &fileCounters = std::shared_ptr<UHDF_IOCounters>())
     {
         groupname = groupName;
+        filename = fileName;
+        path = parentPath.empty() ? groupName : parentPath + "/" + groupName;
+        attributeCache = std::make_shared<UHDF_AttributeCache>();
+        chunkCache = cacheSettings;
+        access = UHDF_READONLY;
+        ioCounters = fileCounters;
 
-        id.h5id = H5Gopen2(ownerId.h5id, groupname.c_str(), H5P_DEFAULT);
+        id.h5id = H5Gopen2(ownerId.h5id, groupName.c_str(), H5P_DEFAULT);
         if (id.h5id < 0)
-            throw UHDF_Exception("Couldn't open group name '" + groupname + "'");
+            throw UHDF_Exception("Couldn't open group name '" + groupName + "'");
+        if (ioCounters)
+            ioCounters->add(UHDF_IOCounters::OPENS, 1);
+
+        const size_t delimiterPos = groupName.rfind("/");
+        if (delimiterPos != std::string::npos)
+            groupname = groupName.substr(delimiterPos + 1);
     }
 
-    std::list<std::string> getObjNames(const H5G_obj_t objType) const
+    // an empty handle, for moving into
+    UHDF_Group() :
+        access (UHDF_READONLY)
     {
-        std::list<std::string> names;
+        id.h5id = -1;
+    }
 
-        hsize_t numObjs;
-        if (H5Gget_num_objs(id.h5id, &numObjs) < 0)
-            throw UHDF_Exception("Error getting number of objects from group " + groupname);
+    // the same check, and message, as the file's
+    void checkWritable() const
+    {
+        if (access == UHDF_READONLY)
+            throw UHDF_Exception("File " + filename + " is open read-only");
+    }
+
+    // copies everything, id included, so only share() may use it
+    UHDF_Group( const UHDF_Group &) = default;
+    UHDF_Group &operator=( const UHDF_Group &) = delete;
 
-        for (hsize_t i = 0; i < numObjs; i++)
+    std::vector<std::string> getChildNames( const UHDF_ObjectType objType) const
+    {
+        std::vector<std::string> names;
+        for (const auto &child : getChildren())
         {
-            if (H5Gget_objtype_by_idx(id.h5id, i) == objType)
-            {
-                char name[256];
-                if (H5Gget_objname_by_idx(id.h5id, i, name, 255) < 0)
-                    throw UHDF_Exception("Error getting name of object " + boost::lexical_cast<std::string>(i) + " from group " + groupname);
-
-                names.push_back(name);
-            }
+            if (child.type == objType)
+                names.push_back(child.name);
         }
-
         return names;
     }
 };
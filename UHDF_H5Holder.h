@@ -54,5 +54,55 @@ public:
     }
 };
 
+class UHDF_PlistHolder
+{
+private:
+    hid_t id;
+
+public:
+    UHDF_PlistHolder(hid_t plistId) :
+        id (plistId)
+    {
+        if (plistId < 0)
+            throw UHDF_Exception("Negative H5P ID received");
+    }
+
+    ~UHDF_PlistHolder()
+    {
+        if (id >= 0)
+            H5Pclose(id);
+    }
+
+    hid_t get() const
+    {
+        return id;
+    }
+};
+
+class UHDF_AttrHolder
+{
+private:
+    hid_t id;
+
+public:
+    UHDF_AttrHolder(hid_t attrId) :
+        id (attrId)
+    {
+        if (attrId < 0)
+            throw UHDF_Exception("Negative H5A ID received");
+    }
+
+    ~UHDF_AttrHolder()
+    {
+        if (id >= 0)
+            H5Aclose(id);
+    }
+
+    hid_t get() const
+    {
+        return id;
+    }
+};
+
 
 #endif // UHDF_H5HOLDER_H
@@ -0,0 +1,98 @@
+#ifndef UHDF_HANDLECACHE_H
+#define UHDF_HANDLECACHE_H
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <cstddef>
+
+// Bounded map that evicts its least recently used entry when full.  Values are destroyed
+// on eviction, so caching an object that owns a library handle closes that handle.
+template<typename KEY, typename VALUE>
+class UHDF_LRUCache
+{
+public:
+    UHDF_LRUCache( const size_t maxEntries) :
+        capacity (maxEntries)
+    {}
+
+    // NULL if absent; a hit makes the entry the most recently used
+    VALUE *find( const KEY &key)
+    {
+        const auto iter = index.find(key);
+        if (iter == index.end())
+            return NULL;
+
+        entries.splice(entries.begin(), entries, iter->second);
+        return &iter->second->second;
+    }
+
+    // values are moved in, so move-only handles can be cached
+    void insert( const KEY &key, VALUE value)
+    {
+        if (capacity == 0)
+            return;
+
+        const auto iter = index.find(key);
+        if (iter != index.end())
+        {
+            iter->second->second = std::move(value);
+            entries.splice(entries.begin(), entries, iter->second);
+            return;
+        }
+
+        entries.push_front(std::make_pair(key, std::move(value)));
+        index[key] = entries.begin();
+
+        while (entries.size() > capacity)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    void erase( const KEY &key)
+    {
+        const auto iter = index.find(key);
+        if (iter == index.end())
+            return;
+
+        entries.erase(iter->second);
+        index.erase(iter);
+    }
+
+    void setCapacity( const size_t maxEntries)
+    {
+        capacity = maxEntries;
+        while (entries.size() > capacity)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    size_t getCapacity() const
+    {
+        return capacity;
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    void clear()
+    {
+        index.clear();
+        entries.clear();
+    }
+
+private:
+    typedef std::list<std::pair<KEY, VALUE>> EntryList;
+
+    size_t capacity;
+    EntryList entries;
+    std::unordered_map<KEY, typename EntryList::iterator> index;
+};
+
+#endif // UHDF_HANDLECACHE_H
@@ -0,0 +1,160 @@
+#ifndef UHDF_IOSTATS_H
+#define UHDF_IOSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+
+// Snapshot of the I/O counters of a file or dataset, for telling whether a job is waiting on
+// the library (libraryTime), on decompressing chunks outside it (decodeTime) or on type
+// conversion (conversionTime).  Times are in seconds, summed over threads.
+struct UHDF_IOStatistics
+{
+    uint64_t readCalls;          // H5Dread, SDreaddata and H5Dread_chunk
+    uint64_t writeCalls;         // H5Dwrite and SDwritedata
+    uint64_t opens;              // file, group and dataset handles opened, including shared ones
+    uint64_t closes;
+    uint64_t bytesRequested;     // selected by reads, in the file's type
+    uint64_t bytesWritten;       // in the file's type
+    uint64_t bytesFetched;       // chunks read still compressed, by direct chunk reads
+    uint64_t bytesDecompressed;  // those chunks once decoded
+    uint64_t handleCacheHits;    // opens served from a file's handle cache
+    uint64_t handleCacheMisses;
+    double libraryTime;          // inside HDF4 and HDF5 read and write calls
+    double decodeTime;           // decoding chunks from direct chunk reads
+    double conversionTime;       // converting and calibrating values after reading, and before writing
+    double metadataCacheHitRate; // HDF5 files only, from the library; -1 if not known
+};
+
+// Atomic counters behind UHDF_IOStatistics.  Updates are relaxed atomic adds, cheap enough to
+// leave on.  Counters with a parent pass every update on to it too, so a file's counters
+// total everything done through it.
+class UHDF_IOCounters
+{
+public:
+    typedef enum
+    {
+        READ_CALLS,
+        WRITE_CALLS,
+        OPENS,
+        CLOSES,
+        BYTES_REQUESTED,
+        BYTES_WRITTEN,
+        BYTES_FETCHED,
+        BYTES_DECOMPRESSED,
+        HANDLE_CACHE_HITS,
+        HANDLE_CACHE_MISSES,
+        LIBRARY_NANOSECONDS,
+        DECODE_NANOSECONDS,
+        CONVERSION_NANOSECONDS,
+        NUM_COUNTERS
+    } Counter;
+
+    explicit UHDF_IOCounters( const std::shared_ptr<UHDF_IOCounters> &parentCounters = std::shared_ptr<UHDF_IOCounters>()) :
+        parent (parentCounters)
+    {
+        reset();
+    }
+
+    UHDF_IOCounters( const UHDF_IOCounters &) = delete;
+    UHDF_IOCounters &operator=( const UHDF_IOCounters &) = delete;
+
+    void add( const Counter counter, const uint64_t n)
+    {
+        values[counter].fetch_add(n, std::memory_order_relaxed);
+        if (parent)
+            parent->add(counter, n);
+    }
+
+    // leaves the parent's counts alone
+    void reset()
+    {
+        for (int i = 0; i < NUM_COUNTERS; i++)
+            values[i].store(0, std::memory_order_relaxed);
+    }
+
+    UHDF_IOStatistics snapshot() const
+    {
+        UHDF_IOStatistics stats;
+        stats.readCalls = get(READ_CALLS);
+        stats.writeCalls = get(WRITE_CALLS);
+        stats.opens = get(OPENS);
+        stats.closes = get(CLOSES);
+        stats.bytesRequested = get(BYTES_REQUESTED);
+        stats.bytesWritten = get(BYTES_WRITTEN);
+        stats.bytesFetched = get(BYTES_FETCHED);
+        stats.bytesDecompressed = get(BYTES_DECOMPRESSED);
+        stats.handleCacheHits = get(HANDLE_CACHE_HITS);
+        stats.handleCacheMisses = get(HANDLE_CACHE_MISSES);
+        stats.libraryTime = get(LIBRARY_NANOSECONDS) * 1e-9;
+        stats.decodeTime = get(DECODE_NANOSECONDS) * 1e-9;
+        stats.conversionTime = get(CONVERSION_NANOSECONDS) * 1e-9;
+        stats.metadataCacheHitRate = -1;
+        return stats;
+    }
+
+private:
+    std::atomic<uint64_t> values[NUM_COUNTERS];
+    std::shared_ptr<UHDF_IOCounters> parent;
+
+    uint64_t get( const Counter counter) const
+    {
+        return values[counter].load(std::memory_order_relaxed);
+    }
+};
+
+// adds the time from construction to destruction to one of the time counters
+class UHDF_IOTimer
+{
+public:
+    UHDF_IOTimer( UHDF_IOCounters &timerCounters, const UHDF_IOCounters::Counter timeCounter) :
+        counters (timerCounters),
+        counter (timeCounter),
+        begin (std::chrono::steady_clock::now())
+    {}
+
+    ~UHDF_IOTimer()
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - begin;
+        counters.add(counter, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    UHDF_IOTimer( const UHDF_IOTimer &) = delete;
+    UHDF_IOTimer &operator=( const UHDF_IOTimer &) = delete;
+
+private:
+    UHDF_IOCounters &counters;
+    UHDF_IOCounters::Counter counter;
+    std::chrono::steady_clock::time_point begin;
+};
+
+// a conversion kernel(in, out, n) that adds the time it takes to the conversion counter
+template<typename KERNEL>
+class UHDF_TimedKernel
+{
+public:
+    UHDF_TimedKernel( KERNEL timedKernel, UHDF_IOCounters &kernelCounters) :
+        kernel (timedKernel),
+        counters (kernelCounters)
+    {}
+
+    template<typename FROM, typename TO>
+    void operator()( const FROM *in, TO *out, const size_t n) const
+    {
+        const UHDF_IOTimer timer(counters, UHDF_IOCounters::CONVERSION_NANOSECONDS);
+        kernel(in, out, n);
+    }
+
+private:
+    KERNEL kernel;
+    UHDF_IOCounters &counters;
+};
+
+template<typename KERNEL>
+static inline UHDF_TimedKernel<KERNEL> UHDF_timeKernel( KERNEL kernel, UHDF_IOCounters &counters)
+{
+    return UHDF_TimedKernel<KERNEL>(kernel, counters);
+}
+
+#endif // UHDF_IOSTATS_H
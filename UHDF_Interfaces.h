@@ -3,6 +3,7 @@
 
 #include <list>
 #include <string>
+#include <vector>
 
 class UHDF_Dataset;
 class UHDF_Group;
@@ -11,14 +12,14 @@ class UHDF_Attribute;
 class UHDF_DatasetHolder
 {
 public:
-    virtual std::list<std::string> getDatasetNames() const = 0;
+    virtual std::vector<std::string> getDatasetNames() const = 0;
     virtual UHDF_Dataset openDataset(const std::string &datasetName) const = 0;
 };
 
 class UHDF_GroupHolder
 {
 public:
-    virtual std::list<std::string> getGroupNames() const = 0;
+    virtual std::vector<std::string> getGroupNames() const = 0;
     virtual UHDF_Group openGroup(const std::string &groupName) const = 0;
 };
 
@@ -0,0 +1,168 @@
+#ifndef UHDF_MAPPEDVIEW_H
+#define UHDF_MAPPEDVIEW_H
+
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+
+#include "UHDF_Types.h"
+#include "UHDF_View.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define UHDF_HAVE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a dataset's data mapped straight from its file.  Processes that map the
+// same dataset share the page cache's copy of it instead of each reading a private copy.
+// Move-only; the mapping is released when the view is destroyed.
+template<typename T>
+class UHDF_MappedView
+{
+public:
+    UHDF_MappedView() :
+        mapping (NULL),
+        mappingSize (0),
+        elements (NULL)
+    {}
+
+    // maps numBytes bytes at byte offset fileOffset of fileName
+    UHDF_MappedView( const std::string &fileName,
+                     const uint64_t fileOffset,
+                     const size_t numBytes,
+                     const std::vector<size_t> &viewShape) :
+        mapping (NULL),
+        mappingSize (0),
+        elements (NULL),
+        shape (viewShape)
+    {
+#ifdef UHDF_HAVE_MMAP
+        const int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw UHDF_Exception("Couldn't open " + fileName + " for mapping: " + strerror(errno));
+
+        struct stat fileInfo;
+        if (fstat(fd, &fileInfo) < 0 || static_cast<uint64_t>(fileInfo.st_size) < fileOffset + numBytes)
+        {
+            close(fd);
+            throw UHDF_Exception("Dataset extends past the end of " + fileName);
+        }
+
+        // mappings have to start on a page boundary
+        const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+        const uint64_t mapStart = fileOffset - fileOffset % pageSize;
+        const size_t lead = static_cast<size_t>(fileOffset - mapStart);
+
+        mappingSize = lead + numBytes;
+        if (mappingSize > 0)
+        {
+            mapping = mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(mapStart));
+            if (mapping == MAP_FAILED)
+            {
+                const int err = errno;
+                close(fd);
+                mapping = NULL;
+                throw UHDF_Exception("Couldn't map " + fileName + ": " + strerror(err));
+            }
+            elements = reinterpret_cast<const T*>(static_cast<const char*>(mapping) + lead);
+        }
+
+        close(fd);
+#else
+        throw UHDF_Exception("Memory-mapped datasets aren't supported on this platform");
+#endif
+    }
+
+    ~UHDF_MappedView()
+    {
+        release();
+    }
+
+    UHDF_MappedView( const UHDF_MappedView &) = delete;
+    UHDF_MappedView &operator=( const UHDF_MappedView &) = delete;
+
+    UHDF_MappedView( UHDF_MappedView &&other) :
+        mapping (other.mapping),
+        mappingSize (other.mappingSize),
+        elements (other.elements),
+        shape (std::move(other.shape))
+    {
+        other.mapping = NULL;
+        other.mappingSize = 0;
+        other.elements = NULL;
+    }
+
+    UHDF_MappedView &operator=( UHDF_MappedView &&other)
+    {
+        if (this != &other)
+        {
+            release();
+            mapping = other.mapping;
+            mappingSize = other.mappingSize;
+            elements = other.elements;
+            shape = std::move(other.shape);
+
+            other.mapping = NULL;
+            other.mappingSize = 0;
+            other.elements = NULL;
+        }
+        return *this;
+    }
+
+    const T *data() const
+    {
+        return elements;
+    }
+
+    size_t size() const
+    {
+        size_t elems = 1;
+        for (auto n : shape)
+        {
+            elems *= n;
+        }
+        return elems;
+    }
+
+    const T &operator[]( const size_t i) const
+    {
+        return elements[i];
+    }
+
+    UHDF_View<const T> view() const
+    {
+        return UHDF_View<const T>(elements, shape);
+    }
+
+    // hint to the kernel about the upcoming access pattern (eg, MADV_SEQUENTIAL, MADV_WILLNEED)
+    void advise( const int advice) const
+    {
+#ifdef UHDF_HAVE_MMAP
+        if (mapping != NULL)
+            madvise(mapping, mappingSize, advice);
+#endif
+    }
+
+private:
+    void *mapping;
+    size_t mappingSize;
+    const T *elements;
+    std::vector<size_t> shape;
+
+    void release()
+    {
+#ifdef UHDF_HAVE_MMAP
+        if (mapping != NULL)
+            munmap(mapping, mappingSize);
+#endif
+        mapping = NULL;
+        mappingSize = 0;
+        elements = NULL;
+    }
+};
+
+#endif // UHDF_MAPPEDVIEW_H
@@ -0,0 +1,1002 @@
+#ifndef UHDF_PROCESSPOOL_H
+#define UHDF_PROCESSPOOL_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <new>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+
+#include <boost/lexical_cast.hpp>
+
+#include "UHDF_Types.h"
+#include "UHDF_ChunkCache.h"
+#include "UHDF_FileAccess.h"
+#include "UHDF_ThreadPool.h"
+#include "UHDF_Tile.h"
+#include "UHDF_Dataset.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define UHDF_HAVE_FORK 1
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// shared memory each reader process hands its results back in, so the most one read can return
+static const size_t UHDF_DEFAULT_READER_BUFFER_BYTES = 64 * 1024 * 1024;
+
+// files each reader process keeps open between reads
+static const size_t UHDF_DEFAULT_READER_OPEN_FILES = 8;
+
+// one read as sent to a reader process, followed by the file and dataset names.  With
+// sharedOutput set, the request carries a descriptor of shared memory, and the result goes
+// there at outputOffset instead of into the reader's own buffer.
+struct UHDF_ReaderRequest
+{
+    int32 memType;
+    int32 rank;
+    int32 start[UHDF_MAX_RANK];
+    int32 stride[UHDF_MAX_RANK];
+    int32 count[UHDF_MAX_RANK];
+    UHDF_ChunkCache chunkCache;
+    UHDF_FileAccessOptions accessOptions;
+    uint32_t fileNameLength;
+    uint32_t datasetNameLength;
+    int32 sharedOutput;
+    uint64_t outputOffset;
+    uint64_t outputBytes;
+};
+
+// a reader process's answer, followed by an error message when status isn't 0
+struct UHDF_ReaderReply
+{
+    int32 status;
+    uint32_t messageLength;
+};
+
+#ifdef UHDF_HAVE_FORK
+
+// false if the other end has gone away
+static inline bool UHDF_sendAll( const int socket, const void *data, size_t numBytes)
+{
+    const char *bytes = static_cast<const char*>(data);
+    while (numBytes > 0)
+    {
+        const ssize_t sent = send(socket, bytes, numBytes, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+
+        bytes += sent;
+        numBytes -= sent;
+    }
+    return true;
+}
+
+static inline bool UHDF_receiveAll( const int socket, void *data, size_t numBytes)
+{
+    char *bytes = static_cast<char*>(data);
+    while (numBytes > 0)
+    {
+        const ssize_t received = recv(socket, bytes, numBytes, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+
+        bytes += received;
+        numBytes -= received;
+    }
+    return true;
+}
+
+// UHDF_sendAll with a file descriptor attached to the first bytes
+static inline bool UHDF_sendWithDescriptor( const int socket, const void *data, const size_t numBytes, const int descriptor)
+{
+    iovec io;
+    io.iov_base = const_cast<void*>(data);
+    io.iov_len = numBytes;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+
+    msghdr message = msghdr();
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &descriptor, sizeof(int));
+
+    ssize_t sent;
+    do
+    {
+        sent = sendmsg(socket, &message, MSG_NOSIGNAL);
+    }
+    while (sent < 0 && errno == EINTR);
+
+    if (sent <= 0)
+        return false;
+    return UHDF_sendAll(socket, static_cast<const char*>(data) + sent, numBytes - sent);
+}
+
+// UHDF_receiveAll that also takes a file descriptor sent with the data, or sets descriptor
+// to -1 when there was none
+static inline bool UHDF_receiveWithDescriptor( const int socket, void *data, const size_t numBytes, int &descriptor)
+{
+    descriptor = -1;
+
+    iovec io;
+    io.iov_base = data;
+    io.iov_len = numBytes;
+
+    char control[CMSG_SPACE(sizeof(int))];
+
+    msghdr message = msghdr();
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received;
+    do
+    {
+        received = recvmsg(socket, &message, 0);
+    }
+    while (received < 0 && errno == EINTR);
+
+    if (received <= 0)
+        return false;
+
+    for (cmsghdr *header = CMSG_FIRSTHDR(&message); header != NULL; header = CMSG_NXTHDR(&message, header))
+    {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+            memcpy(&descriptor, CMSG_DATA(header), sizeof(int));
+    }
+
+    if (UHDF_receiveAll(socket, static_cast<char*>(data) + received, numBytes - received))
+        return true;
+
+    if (descriptor >= 0)
+        close(descriptor);
+    descriptor = -1;
+    return false;
+}
+
+// shared memory that can be handed to another process by its descriptor
+static inline int UHDF_createSharedMemory( const size_t numBytes)
+{
+#ifdef __linux__
+    const int descriptor = memfd_create("uhdf-read", MFD_CLOEXEC);
+#else
+    static std::atomic<unsigned> serial(0);
+    const std::string name = "/uhdf-" + boost::lexical_cast<std::string>(getpid()) + "-" + boost::lexical_cast<std::string>(serial++);
+    const int descriptor = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (descriptor >= 0)
+        shm_unlink(name.c_str());
+#endif
+    if (descriptor < 0)
+        throw UHDF_Exception(std::string("Couldn't make shared memory for reader processes: ") + strerror(errno));
+
+    if (ftruncate(descriptor, numBytes) < 0)
+    {
+        const int error = errno;
+        close(descriptor);
+        throw UHDF_Exception("Couldn't size " + boost::lexical_cast<std::string>(numBytes) + " bytes of shared memory for reader processes: " + strerror(error));
+    }
+    return descriptor;
+}
+
+#endif
+
+// Values read by UHDF_ProcessPool::readShared, in memory shared with the pool's readers,
+// which decode straight into it.  Move-only; it stays valid after the pool is gone.
+template<typename T>
+class UHDF_SharedArray
+{
+public:
+    UHDF_SharedArray() :
+        descriptor (-1),
+        values (NULL),
+        numElements (0)
+    {}
+
+    explicit UHDF_SharedArray( const size_t elements) :
+        descriptor (-1),
+        values (NULL),
+        numElements (elements)
+    {
+        if (numElements == 0)
+            return;
+
+#ifdef UHDF_HAVE_FORK
+        descriptor = UHDF_createSharedMemory(getNumBytes());
+
+        void *mapping = mmap(NULL, getNumBytes(), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            const int error = errno;
+            close(descriptor);
+            throw UHDF_Exception("Couldn't map " + boost::lexical_cast<std::string>(getNumBytes()) + " bytes of shared memory: " + strerror(error));
+        }
+        values = static_cast<T*>(mapping);
+#else
+        throw UHDF_Exception("Shared memory for reader processes needs fork(), which this platform doesn't have");
+#endif
+    }
+
+    UHDF_SharedArray( UHDF_SharedArray &&other) noexcept :
+        descriptor (other.descriptor),
+        values (other.values),
+        numElements (other.numElements)
+    {
+        other.descriptor = -1;
+        other.values = NULL;
+        other.numElements = 0;
+    }
+
+    UHDF_SharedArray &operator=( UHDF_SharedArray &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            std::swap(descriptor, other.descriptor);
+            std::swap(values, other.values);
+            std::swap(numElements, other.numElements);
+        }
+        return *this;
+    }
+
+    UHDF_SharedArray( const UHDF_SharedArray &) = delete;
+    UHDF_SharedArray &operator=( const UHDF_SharedArray &) = delete;
+
+    ~UHDF_SharedArray()
+    {
+        release();
+    }
+
+    T *data()
+    {
+        return values;
+    }
+
+    const T *data() const
+    {
+        return values;
+    }
+
+    size_t getNumElements() const
+    {
+        return numElements;
+    }
+
+    size_t getNumBytes() const
+    {
+        return numElements * sizeof(T);
+    }
+
+    // for handing to a reader process
+    int getDescriptor() const
+    {
+        return descriptor;
+    }
+
+private:
+    int descriptor;
+    T *values;
+    size_t numElements;
+
+    void release()
+    {
+#ifdef UHDF_HAVE_FORK
+        if (values != NULL)
+            munmap(values, getNumBytes());
+        if (descriptor >= 0)
+            close(descriptor);
+#endif
+        descriptor = -1;
+        values = NULL;
+        numElements = 0;
+    }
+};
+
+template<typename T>
+class UHDF_PooledRead;
+
+// Pool of forked reader processes.  HDF4 isn't thread-safe and thread-safe HDF5 runs one
+// call at a time, so threads in one process can't decode in parallel; each reader here
+// is its own process with its own copy of the libraries, so they can.  A reader keeps
+// the files it has been sent open between reads, and reads and converts straight into a
+// buffer of memory shared with this process, so results aren't copied through a pipe.
+//
+// Readers are forked when the pool is made, so make it early: before opening files you
+// mean to write, and before starting threads of your own that call the libraries (a
+// thread in the middle of a library call when the process is copied leaves the copy
+// stuck).  Readers open files by name, read-only, so they see what is on disk; files
+// written after the pool starts must be closed or flushed before reading them through it,
+// and files opened from memory can't be read through it at all.
+//
+// A pool shouldn't be used from more than one thread at a time.  See
+// UHDF_File::setReaderPool to have readParallel use one.
+class UHDF_ProcessPool
+{
+    template<typename T> friend class UHDF_PooledRead;
+
+public:
+    UHDF_ProcessPool( unsigned numProcesses = 0,
+                      const size_t readerBufferBytes = UHDF_DEFAULT_READER_BUFFER_BYTES,
+                      const size_t readerOpenFiles = UHDF_DEFAULT_READER_OPEN_FILES) :
+        bufferBytes (readerBufferBytes),
+        maxOpenFiles (std::max<size_t>(1, readerOpenFiles))
+    {
+#ifdef UHDF_HAVE_FORK
+        if (numProcesses == 0)
+            numProcesses = UHDF_defaultThreadCount();
+
+        workers.resize(numProcesses);
+        try
+        {
+            for (size_t i = 0; i < workers.size(); i++)
+                startWorker(i);
+        }
+        catch (...)
+        {
+            stopWorkers();
+            throw;
+        }
+#else
+        throw UHDF_Exception("Reader processes need fork(), which this platform doesn't have");
+#endif
+    }
+
+    // reads still in progress must be destroyed first
+    ~UHDF_ProcessPool()
+    {
+        stopWorkers();
+    }
+
+    UHDF_ProcessPool( const UHDF_ProcessPool &) = delete;
+    UHDF_ProcessPool &operator=( const UHDF_ProcessPool &) = delete;
+
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+    size_t getBufferBytes() const
+    {
+        return bufferBytes;
+    }
+
+    size_t getIdleCount() const
+    {
+        size_t n = 0;
+        for (const auto &worker : workers)
+        {
+            if (!worker.busy)
+                n++;
+        }
+        return n;
+    }
+
+    // Starts reading a hyperslab of a dataset, converted to T, on an idle reader; throws if
+    // every reader is busy.  The result is read in place from the reader's shared buffer,
+    // which it keeps until the returned read is destroyed.  The reader opens the file with
+    // accessOptions.
+    template<typename T>
+    UHDF_PooledRead<T> submit( const std::string &fileName,
+                               const std::string &datasetPath,
+                               const std::vector<int32> &start,
+                               const std::vector<int32> &stride,
+                               const std::vector<int32> &count,
+                               const UHDF_ChunkCache &cache = UHDF_ChunkCache(),
+                               const UHDF_FileAccessOptions &accessOptions = UHDF_FileAccessOptions());
+
+    // Reads a hyperslab of dataset into buffer across the readers.  Like readParallel, the
+    // selection is split along its slowest dimension on chunk boundaries, and further into
+    // pieces that fit a reader's buffer.  buffer isn't memory the readers can see, so this
+    // copies: each piece is decoded into its reader's buffer and then copied into buffer in
+    // this process.  readShared doesn't.  Selections whose rows don't fit a reader's buffer
+    // are read in this process instead.
+    template<typename T>
+    void read( const UHDF_Dataset &dataset,
+               const int32 *const start,
+               const int32 *const stride,
+               const int32 *const count,
+               T* buffer);
+
+    // Reads a hyperslab of dataset across the readers without copying it: the pool makes
+    // one block of shared memory for the whole selection, and each reader decodes its
+    // pieces straight into their place in it.  Split like read, but pieces aren't limited
+    // by the readers' buffers.
+    template<typename T>
+    UHDF_SharedArray<T> readShared( const UHDF_Dataset &dataset,
+                                    const int32 *const start,
+                                    const int32 *const stride,
+                                    const int32 *const count);
+
+private:
+    struct Worker
+    {
+        Worker() :
+            pid (-1),
+            socket (-1),
+            buffer (NULL),
+            busy (false)
+        {}
+
+        pid_t pid;
+        int socket;
+        void *buffer;
+        bool busy;
+    };
+
+    std::vector<Worker> workers;
+    size_t bufferBytes;
+    size_t maxOpenFiles;
+
+    // run by each reader process until the pool closes its socket; defined in UHDF_File.h,
+    // since readers open files
+    void serve( const int socket, void *const buffer) const;
+
+#ifdef UHDF_HAVE_FORK
+    void startWorker( const size_t i)
+    {
+        Worker &worker = workers[i];
+        worker.busy = false;
+
+        if (worker.buffer == NULL)
+        {
+            void *mapping = mmap(NULL, bufferBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (mapping == MAP_FAILED)
+                throw UHDF_Exception("Couldn't map " + boost::lexical_cast<std::string>(bufferBytes) + " bytes for a reader process: " + strerror(errno));
+            worker.buffer = mapping;
+        }
+
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) < 0)
+            throw UHDF_Exception(std::string("Couldn't make a socket for a reader process: ") + strerror(errno));
+
+        // none of this library's own workers can be inside a library call while the process
+        // is copied.  The copy finds the lock held by a thread it doesn't have, so it starts
+        // over with a new one; it's the copy's only thread, so nothing else can hold it
+        std::unique_lock<std::recursive_mutex> lock(UHDF_libraryMutex());
+        const pid_t pid = fork();
+        if (pid == 0)
+        {
+            new (&UHDF_libraryMutex()) std::recursive_mutex();
+
+            close(sockets[0]);
+            for (size_t j = 0; j < workers.size(); j++)
+            {
+                if (j == i)
+                    continue;
+                if (workers[j].socket >= 0)
+                    close(workers[j].socket);
+                if (workers[j].buffer != NULL)
+                    munmap(workers[j].buffer, bufferBytes);
+            }
+
+            try
+            {
+                serve(sockets[1], worker.buffer);
+            }
+            catch (...)
+            {
+                _exit(1);
+            }
+
+            // skip exit handlers and destructors, which belong to the parent's copy of everything
+            _exit(0);
+        }
+        lock.unlock();
+
+        close(sockets[1]);
+        if (pid < 0)
+        {
+            close(sockets[0]);
+            throw UHDF_Exception(std::string("Couldn't start a reader process: ") + strerror(errno));
+        }
+
+        worker.pid = pid;
+        worker.socket = sockets[0];
+    }
+
+    // a reader that has exited is replaced, so the pool stays its full size
+    void restartWorker( const size_t i)
+    {
+        Worker &worker = workers[i];
+        if (worker.socket >= 0)
+            close(worker.socket);
+        if (worker.pid > 0)
+            waitpid(worker.pid, NULL, 0);
+        worker.socket = -1;
+        worker.pid = -1;
+
+        startWorker(i);
+    }
+
+    void stopWorkers()
+    {
+        // a reader exits when its socket closes
+        for (auto &worker : workers)
+        {
+            if (worker.socket >= 0)
+                close(worker.socket);
+            worker.socket = -1;
+        }
+
+        for (auto &worker : workers)
+        {
+            if (worker.pid > 0)
+                waitpid(worker.pid, NULL, 0);
+            if (worker.buffer != NULL)
+                munmap(worker.buffer, bufferBytes);
+            worker.pid = -1;
+            worker.buffer = NULL;
+        }
+    }
+#else
+    void startWorker( const size_t) {}
+    void restartWorker( const size_t) {}
+    void stopWorkers() {}
+#endif
+
+    size_t findIdleWorker() const
+    {
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            if (!workers[i].busy)
+                return i;
+        }
+        throw UHDF_Exception("Every reader process is busy");
+    }
+
+    // sends a read to worker i, which must be idle.  The result goes to the worker's buffer,
+    // or at outputOffset in the shared memory of outputDescriptor when there is one.
+    void startRead( const size_t i,
+                    const UHDF_DataType memType,
+                    const size_t memTypeSize,
+                    const std::string &fileName,
+                    const std::string &datasetPath,
+                    const int rank,
+                    const int32 *const start,
+                    const int32 *const stride,
+                    const int32 *const count,
+                    const UHDF_ChunkCache &cache,
+                    const UHDF_FileAccessOptions &accessOptions,
+                    const int outputDescriptor = -1,
+                    const size_t outputOffset = 0)
+    {
+        if (rank < 0 || rank > UHDF_MAX_RANK)
+            throw UHDF_Exception("Can't read " + boost::lexical_cast<std::string>(rank) + " dimensions through a reader process");
+
+        UHDF_ReaderRequest request = UHDF_ReaderRequest();
+        request.memType = memType;
+        request.rank = rank;
+        request.chunkCache = cache;
+        request.accessOptions = accessOptions;
+        request.fileNameLength = fileName.size();
+        request.datasetNameLength = datasetPath.size();
+
+        size_t numBytes = memTypeSize;
+        for (int d = 0; d < rank; d++)
+        {
+            if (count[d] <= 0 || stride[d] <= 0)
+                throw UHDF_Exception("Zero or negative count or stride given when reading");
+
+            request.start[d] = start[d];
+            request.stride[d] = stride[d];
+            request.count[d] = count[d];
+            numBytes *= count[d];
+        }
+
+        request.sharedOutput = (outputDescriptor >= 0) ? 1 : 0;
+        request.outputOffset = outputOffset;
+        request.outputBytes = numBytes;
+
+        if (outputDescriptor < 0 && numBytes > bufferBytes)
+            throw UHDF_Exception("Reading " + boost::lexical_cast<std::string>(numBytes) + " bytes of dataset '" + datasetPath +
+                                 "' needs more than a reader process's " + boost::lexical_cast<std::string>(bufferBytes) + " byte buffer");
+
+#ifdef UHDF_HAVE_FORK
+        // a reader that had exited hasn't started the read, so its replacement can
+        for (int attempt = 0; ; attempt++)
+        {
+            Worker &worker = workers[i];
+            const bool sent = (outputDescriptor >= 0) ? UHDF_sendWithDescriptor(worker.socket, &request, sizeof(request), outputDescriptor)
+                                                      : UHDF_sendAll(worker.socket, &request, sizeof(request));
+            if (sent &&
+                UHDF_sendAll(worker.socket, fileName.data(), fileName.size()) &&
+                UHDF_sendAll(worker.socket, datasetPath.data(), datasetPath.size()))
+            {
+                worker.busy = true;
+                break;
+            }
+
+            restartWorker(i);
+            if (attempt > 0)
+                throw UHDF_Exception("Reader process exited before reading dataset '" + datasetPath + "' from " + fileName);
+        }
+#endif
+    }
+
+    // waits for worker i's read to finish, and throws if it failed; the worker stays busy
+    // until its result has been released
+    void finishRead( const size_t i)
+    {
+#ifdef UHDF_HAVE_FORK
+        Worker &worker = workers[i];
+
+        UHDF_ReaderReply reply;
+        if (!UHDF_receiveAll(worker.socket, &reply, sizeof(reply)))
+        {
+            restartWorker(i);
+            throw UHDF_Exception("Reader process exited during a read");
+        }
+
+        if (reply.status != 0)
+        {
+            std::string message(reply.messageLength, '\0');
+            if (!UHDF_receiveAll(worker.socket, &message[0], message.size()))
+                restartWorker(i);
+            throw UHDF_Exception(message);
+        }
+#endif
+    }
+
+    // blocks until one of the busy workers has an answer waiting
+    size_t waitForAnyWorker() const
+    {
+#ifdef UHDF_HAVE_FORK
+        std::vector<pollfd> polls;
+        std::vector<size_t> indices;
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            if (!workers[i].busy)
+                continue;
+
+            pollfd p;
+            p.fd = workers[i].socket;
+            p.events = POLLIN;
+            p.revents = 0;
+            polls.push_back(p);
+            indices.push_back(i);
+        }
+
+        if (polls.empty())
+            throw UHDF_Exception("No reads in progress to wait for");
+
+        for (;;)
+        {
+            if (poll(polls.data(), polls.size(), -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw UHDF_Exception(std::string("Error waiting for reader processes: ") + strerror(errno));
+            }
+
+            // an exited reader shows as hung up; finishRead finds that out
+            for (size_t k = 0; k < polls.size(); k++)
+            {
+                if (polls[k].revents != 0)
+                    return indices[k];
+            }
+        }
+#else
+        throw UHDF_Exception("No reads in progress to wait for");
+#endif
+    }
+
+    // Sends the pieces of a selection of dataset to readers as they come free, and calls
+    // finishPiece(result, piece) as each one is done.  With an output descriptor, each
+    // piece goes to its own place in that shared memory.
+    template<typename T, typename FINISH>
+    void readPieces( const UHDF_Dataset &dataset,
+                     const int32 *const start,
+                     const int32 *const stride,
+                     const int32 *const count,
+                     const std::vector<UHDF_RowRange> &pieces,
+                     const size_t rowElems,
+                     const int outputDescriptor,
+                     FINISH finishPiece);
+
+    template<typename T>
+    const T *getResult( const size_t i) const
+    {
+        return static_cast<const T*>(workers[i].buffer);
+    }
+};
+
+// One read in progress on a reader process, from UHDF_ProcessPool::submit.  The result is
+// read in place, from memory the reader shares with this process; the reader takes no
+// more reads until this is destroyed.  Move-only, and must not outlive its pool.
+template<typename T>
+class UHDF_PooledRead
+{
+    friend class UHDF_ProcessPool;
+
+public:
+    UHDF_PooledRead( UHDF_PooledRead &&other) noexcept :
+        pool (other.pool),
+        worker (other.worker),
+        numElements (other.numElements),
+        finished (other.finished)
+    {
+        error.swap(other.error);
+        other.pool = NULL;
+    }
+
+    UHDF_PooledRead &operator=( UHDF_PooledRead &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            pool = other.pool;
+            worker = other.worker;
+            numElements = other.numElements;
+            finished = other.finished;
+            error.swap(other.error);
+            other.pool = NULL;
+        }
+        return *this;
+    }
+
+    UHDF_PooledRead( const UHDF_PooledRead &) = delete;
+    UHDF_PooledRead &operator=( const UHDF_PooledRead &) = delete;
+
+    ~UHDF_PooledRead()
+    {
+        release();
+    }
+
+    // blocks until the read is done; throws if it failed
+    void wait()
+    {
+        if (!finished)
+        {
+            finished = true;
+            try
+            {
+                pool->finishRead(worker);
+            }
+            catch (const UHDF_Exception &e)
+            {
+                error = e.what();
+            }
+        }
+
+        if (!error.empty())
+            throw UHDF_Exception(error);
+    }
+
+    // the getNumElements() values read, valid until this read is destroyed
+    const T *data()
+    {
+        wait();
+        return pool->template getResult<T>(worker);
+    }
+
+    size_t getNumElements() const
+    {
+        return numElements;
+    }
+
+private:
+    UHDF_ProcessPool *pool;
+    size_t worker;
+    size_t numElements;
+    bool finished;
+    std::string error;
+
+    UHDF_PooledRead( UHDF_ProcessPool *readPool, const size_t readWorker, const size_t readElements) :
+        pool (readPool),
+        worker (readWorker),
+        numElements (readElements),
+        finished (false)
+    {}
+
+    void release()
+    {
+        if (pool == NULL)
+            return;
+
+        // the answer has to be taken off the socket before the reader can take another read
+        if (!finished)
+        {
+            finished = true;
+            try
+            {
+                pool->finishRead(worker);
+            }
+            catch (const UHDF_Exception &)
+            {
+            }
+        }
+
+        pool->workers[worker].busy = false;
+        pool = NULL;
+    }
+};
+
+template<typename T>
+UHDF_PooledRead<T> UHDF_ProcessPool::submit( const std::string &fileName,
+                                             const std::string &datasetPath,
+                                             const std::vector<int32> &start,
+                                             const std::vector<int32> &stride,
+                                             const std::vector<int32> &count,
+                                             const UHDF_ChunkCache &cache,
+                                             const UHDF_FileAccessOptions &accessOptions)
+{
+    if (start.size() != count.size() || stride.size() != count.size())
+        throw UHDF_Exception("Start, stride and count given for reading dataset '" + datasetPath + "' have different ranks");
+
+    size_t numElements = 1;
+    for (auto n : count)
+        numElements *= std::max<int32>(n, 0);
+
+    const size_t i = findIdleWorker();
+    startRead(i, getUHDFType<T>(), sizeof(T), fileName, datasetPath, count.size(), start.data(), stride.data(), count.data(), cache, accessOptions);
+    return UHDF_PooledRead<T>(this, i, numElements);
+}
+
+template<typename T>
+void UHDF_ProcessPool::read( const UHDF_Dataset &dataset,
+                             const int32 *const start,
+                             const int32 *const stride,
+                             const int32 *const count,
+                             T* buffer)
+{
+    const int rank = dataset.shape().rank;
+    if (!dataset.canReopenFile())
+        throw UHDF_Exception("Reader processes can't open the file of dataset '" + dataset.datasetname + "', which is held in memory");
+
+    size_t rowElems = 1;
+    for (int i = 1; i < rank; i++)
+        rowElems *= std::max<int32>(count[i], 0);
+
+    if (rank == 0 || rowElems * sizeof(T) > bufferBytes)
+    {
+        dataset.read(start, stride, count, buffer);
+        return;
+    }
+
+    if (count[0] <= 0 || stride[0] <= 0)
+        throw UHDF_Exception("Zero or negative count or stride given when reading");
+
+    // a few pieces per reader so a slow piece doesn't leave the others idle, cut again
+    // where one is too big for a reader's buffer
+    const size_t maxRows = bufferBytes / (rowElems * sizeof(T));
+    std::vector<UHDF_RowRange> pieces;
+    for (const auto &piece : UHDF_splitRows(start[0], stride[0], count[0], dataset.getTileDimensions()[0], workers.size() * 4))
+    {
+        for (int32 first = 0; first < piece.count; first += maxRows)
+        {
+            UHDF_RowRange part;
+            part.first = piece.first + first;
+            part.count = std::min<int32>(maxRows, piece.count - first);
+            pieces.push_back(part);
+        }
+    }
+
+    readPieces<T>(dataset, start, stride, count, pieces, rowElems, -1,
+        [&](UHDF_PooledRead<T> &result, const UHDF_RowRange &piece)
+        {
+            std::copy(result.data(), result.data() + result.getNumElements(), buffer + piece.first * rowElems);
+        });
+}
+
+template<typename T>
+UHDF_SharedArray<T> UHDF_ProcessPool::readShared( const UHDF_Dataset &dataset,
+                                                  const int32 *const start,
+                                                  const int32 *const stride,
+                                                  const int32 *const count)
+{
+    const int rank = dataset.shape().rank;
+    if (!dataset.canReopenFile())
+        throw UHDF_Exception("Reader processes can't open the file of dataset '" + dataset.datasetname + "', which is held in memory");
+    if (rank == 0)
+        throw UHDF_Exception("Can't split scalar dataset '" + dataset.datasetname + "' across reader processes");
+
+    size_t rowElems = 1;
+    for (int i = 1; i < rank; i++)
+        rowElems *= std::max<int32>(count[i], 0);
+
+    if (count[0] <= 0 || stride[0] <= 0)
+        throw UHDF_Exception("Zero or negative count or stride given when reading");
+
+    UHDF_SharedArray<T> output(static_cast<size_t>(count[0]) * rowElems);
+    if (output.getNumElements() == 0)
+        return output;
+
+    readPieces<T>(dataset, start, stride, count,
+                  UHDF_splitRows(start[0], stride[0], count[0], dataset.getTileDimensions()[0], workers.size() * 4),
+                  rowElems, output.getDescriptor(),
+                  [](UHDF_PooledRead<T> &result, const UHDF_RowRange &)
+                  {
+                      result.wait();
+                  });
+    return output;
+}
+
+template<typename T, typename FINISH>
+void UHDF_ProcessPool::readPieces( const UHDF_Dataset &dataset,
+                                   const int32 *const start,
+                                   const int32 *const stride,
+                                   const int32 *const count,
+                                   const std::vector<UHDF_RowRange> &pieces,
+                                   const size_t rowElems,
+                                   const int outputDescriptor,
+                                   FINISH finishPiece)
+{
+    const int rank = dataset.shape().rank;
+    std::vector<int32> pieceStart(start, start + rank);
+    std::vector<int32> pieceCount(count, count + rank);
+    std::vector<size_t> pieceOfWorker(workers.size());
+
+    size_t nextPiece = 0;
+    size_t inProgress = 0;
+    std::string error;
+
+    while (nextPiece < pieces.size() || inProgress > 0)
+    {
+        // after an error, only wait for the pieces already started
+        while (error.empty() && nextPiece < pieces.size() && getIdleCount() > 0)
+        {
+            const size_t i = findIdleWorker();
+            pieceStart[0] = start[0] + pieces[nextPiece].first * stride[0];
+            pieceCount[0] = pieces[nextPiece].count;
+
+            try
+            {
+                startRead(i, getUHDFType<T>(), sizeof(T), dataset.filename, dataset.path, rank, pieceStart.data(), stride, pieceCount.data(),
+                          dataset.chunkCache, dataset.accessOptions, outputDescriptor, pieces[nextPiece].first * rowElems * sizeof(T));
+            }
+            catch (const UHDF_Exception &e)
+            {
+                error = e.what();
+                break;
+            }
+
+            dataset.countRead(static_cast<size_t>(pieceCount[0]) * rowElems);
+            pieceOfWorker[i] = nextPiece++;
+            inProgress++;
+        }
+
+        if (inProgress == 0)
+            break;
+
+        const size_t i = waitForAnyWorker();
+        const UHDF_RowRange &piece = pieces[pieceOfWorker[i]];
+        UHDF_PooledRead<T> result(this, i, piece.count * rowElems);
+        inProgress--;
+
+        try
+        {
+            finishPiece(result, piece);
+        }
+        catch (const UHDF_Exception &e)
+        {
+            if (error.empty())
+                error = "Error reading dataset '" + dataset.datasetname + "' through reader processes: " + e.what();
+        }
+    }
+
+    if (!error.empty())
+        throw UHDF_Exception(error);
+}
+
+#endif // UHDF_PROCESSPOOL_H
@@ -0,0 +1,200 @@
+#ifndef UHDF_READPLAN_H
+#define UHDF_READPLAN_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include "UHDF_Types.h"
+#include "UHDF_H5Holder.h"
+#include "UHDF_Convert.h"
+#include "UHDF_Dataset.h"
+
+// Prepared read of a fixed-shape window that can be moved around a dataset, for reading
+// the same shape many times (eg, scanline by scanline).  The dataspaces, selection and
+// conversion are set up once; each read() only moves the selection to its new start with
+// H5Soffset_simple and reads.  The dataset must outlive the plan, and a plan shouldn't be
+// used from more than one thread at a time.
+template<typename T>
+class UHDF_ReadPlan
+{
+public:
+    UHDF_ReadPlan( const UHDF_Dataset &planDataset,
+                   const int32 *const planStride,
+                   const int32 *const planCount) :
+        dataset (planDataset)
+    {
+        init(planStride, planCount);
+    }
+
+    // unit stride
+    UHDF_ReadPlan( const UHDF_Dataset &planDataset,
+                   const int32 *const planCount) :
+        dataset (planDataset)
+    {
+        const std::vector<int32> unitStride(planDataset.shape().rank, 1);
+        init(unitStride.data(), planCount);
+    }
+
+    UHDF_ReadPlan( const UHDF_ReadPlan &) = delete;
+    UHDF_ReadPlan &operator=( const UHDF_ReadPlan &) = delete;
+
+    const std::vector<size_t> &getShape() const
+    {
+        return shape;
+    }
+
+    size_t getNumElements() const
+    {
+        return numElements;
+    }
+
+    // reads the window starting at start into buffer, which holds getNumElements() values
+    void read( const int32 *const start, T *buffer)
+    {
+        void *target = (convert == NULL) ? static_cast<void*>(buffer) : static_cast<void*>(scratch.data());
+
+        {
+            std::unique_lock<std::recursive_mutex> guard;
+            if (dataset.libraryLock != NULL)
+                guard = std::unique_lock<std::recursive_mutex>(*dataset.libraryLock);
+
+            dataset.countRead(numElements);
+            const UHDF_IOTimer timer(*dataset.ioCounters, UHDF_IOCounters::LIBRARY_NANOSECONDS);
+
+            switch(dataset.fileType)
+            {
+            case UHDF_HDF4:
+                if (SDreaddata(dataset.id.h4id, const_cast<int32*>(start), stride.data(), count.data(), target) < 0)
+                    throw UHDF_Exception("Error reading HDF4 dataset '" + dataset.datasetname + "'");
+                break;
+            case UHDF_HDF5:
+                if (rank > 0)
+                {
+                    // the selection was made at the origin; moving it is all a new window needs
+                    for (int i = 0; i < rank; i++)
+                        offset[i] = start[i];
+
+                    if (H5Soffset_simple(fileSpace->get(), offset.data()) < 0)
+                        throw UHDF_Exception("Error moving read window in HDF5 dataset '" + dataset.datasetname + "'");
+                }
+
+                if (H5Dread(dataset.id.h5id, fileMemType, memSpace->get(), fileSpace->get(), H5P_DEFAULT, target) < 0)
+                    throw UHDF_Exception("Error reading HDF5 dataset '" + dataset.datasetname + "'");
+                break;
+            }
+        }
+
+        if (convert != NULL)
+        {
+            const UHDF_IOTimer timer(*dataset.ioCounters, UHDF_IOCounters::CONVERSION_NANOSECONDS);
+            convert(scratch.data(), buffer, numElements);
+        }
+    }
+
+private:
+    typedef void (*ConvertFunction)(const void *, T *, size_t);
+
+    const UHDF_Dataset &dataset;
+    int rank;
+    std::vector<int32> stride;
+    std::vector<int32> count;
+    std::vector<size_t> shape;
+    size_t numElements;
+
+    // HDF5 only
+    std::unique_ptr<UHDF_SpaceHolder> fileSpace;
+    std::unique_ptr<UHDF_SpaceHolder> memSpace;
+    std::vector<hssize_t> offset;
+    hid_t fileMemType;
+
+    // NULL when the dataset is already stored as T; otherwise reads land in scratch, in the
+    // dataset's own type, and are converted from there while still in cache
+    ConvertFunction convert;
+    std::vector<uint64_t> scratch;
+
+    template<typename FROM>
+    static void convertFrom( const void *in, T *out, const size_t n)
+    {
+        UHDF_convert(static_cast<const FROM*>(in), out, n);
+    }
+
+    void init( const int32 *const planStride, const int32 *const planCount)
+    {
+        rank = dataset.shape().rank;
+        stride.assign(planStride, planStride + rank);
+        count.assign(planCount, planCount + rank);
+        shape.assign(planCount, planCount + rank);
+        numElements = dataset.getSelectionSize(planCount);
+
+        for (int i = 0; i < rank; i++)
+        {
+            if (count[i] <= 0 || stride[i] <= 0)
+                throw UHDF_Exception("Zero or negative count or stride given for read plan on dataset '" + dataset.datasetname + "'");
+        }
+
+        switch(dataset.shape().dataType)
+        {
+        case UHDF_UINT8:
+            convert = &convertFrom<uint8_t>;
+            break;
+        case UHDF_INT8:
+            convert = &convertFrom<int8_t>;
+            break;
+        case UHDF_UINT16:
+            convert = &convertFrom<uint16_t>;
+            break;
+        case UHDF_INT16:
+            convert = &convertFrom<int16_t>;
+            break;
+        case UHDF_UINT32:
+            convert = &convertFrom<uint32_t>;
+            break;
+        case UHDF_INT32:
+            convert = &convertFrom<int32_t>;
+            break;
+        case UHDF_UINT64:
+            convert = &convertFrom<uint64_t>;
+            break;
+        case UHDF_INT64:
+            convert = &convertFrom<int64_t>;
+            break;
+        case UHDF_FLOAT32:
+            convert = &convertFrom<float>;
+            break;
+        case UHDF_FLOAT64:
+            convert = &convertFrom<double>;
+            break;
+        default:
+            throw UHDF_Exception("Can't plan reads of dataset '" + dataset.datasetname + "' of type " + UHDFTypeName(dataset.shape().dataType));
+        }
+
+        // reads bypass rawRead, so size an automatic chunk cache for the window here
+        dataset.fitChunkCache(planStride, planCount);
+
+        if (dataset.shape().dataType == getUHDFType<T>())
+            convert = NULL;
+        else
+            scratch.resize((numElements * UHDFTypeSize(dataset.shape().dataType) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+
+        if (dataset.fileType != UHDF_HDF5)
+            return;
+
+        fileMemType = UHDFTypeToH5(dataset.shape().dataType);
+        fileSpace.reset(new UHDF_SpaceHolder(H5Dget_space(dataset.id.h5id)));
+        memSpace.reset(new UHDF_SpaceHolder(dataset.createH5MemSpace(planCount)));
+        offset.assign(rank, 0);
+
+        if (rank > 0)
+        {
+            std::vector<hsize_t> hstart(rank, 0);
+            std::vector<hsize_t> hstride(stride.begin(), stride.end());
+            std::vector<hsize_t> hcount(count.begin(), count.end());
+
+            if (H5Sselect_hyperslab(fileSpace->get(), H5S_SELECT_SET, hstart.data(), hstride.data(), hcount.data(), NULL) < 0)
+                throw UHDF_Exception("Error selecting read window in HDF5 dataset '" + dataset.datasetname + "'");
+        }
+    }
+};
+
+#endif // UHDF_READPLAN_H
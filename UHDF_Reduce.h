@@ -0,0 +1,625 @@
+#ifndef UHDF_REDUCE_H
+#define UHDF_REDUCE_H
+
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+
+#include "UHDF_Types.h"
+#include "UHDF_Convert.h"
+
+// Accumulators for UHDF_Dataset::reduce.  Each one takes blocks of values in the dataset's
+// own type through add(), and partial results from other threads through merge().
+
+// values are taken in blocks small enough to stay in cache between the kernels' passes
+static const size_t UHDF_REDUCE_BLOCK = 4096;
+
+// independent accumulators per kernel; the SSE2/AVX2 passes below keep the same lanes in
+// vector registers, so they give exactly the scalar loop's results
+static const size_t UHDF_REDUCE_LANES = 8;
+
+// block sums are exact in 64-bit integers for types up to 32 bits
+template<typename T> struct UHDF_SumType { typedef double type; };
+template<> struct UHDF_SumType<uint8_t> { typedef int64_t type; };
+template<> struct UHDF_SumType<int8_t> { typedef int64_t type; };
+template<> struct UHDF_SumType<uint16_t> { typedef int64_t type; };
+template<> struct UHDF_SumType<int16_t> { typedef int64_t type; };
+template<> struct UHDF_SumType<uint32_t> { typedef int64_t type; };
+template<> struct UHDF_SumType<int32_t> { typedef int64_t type; };
+
+// false only for NaN; always true (and optimized away) for integers
+template<typename T>
+static inline bool UHDF_isNumber( const T v)
+{
+    return v == v;
+}
+
+// vector passes of UHDF_Statistics over whole groups of UHDF_REDUCE_LANES values, adding
+// to the lanes' accumulators; each returns the number of values taken and the scalar loop
+// finishes the rest.  This one has no vector pass and takes nothing.
+template<typename T>
+struct UHDF_ScalarReduce
+{
+    static inline size_t summarize( const T *, const size_t, typename UHDF_SumType<T>::type *, uint32_t *, T *, T *)
+    {
+        return 0;
+    }
+
+    static inline size_t squares( const T *, const size_t, const double, double *)
+    {
+        return 0;
+    }
+};
+
+template<typename T>
+struct UHDF_SimdReduce : UHDF_ScalarReduce<T> {};
+
+#ifdef UHDF_HAVE_X86_SIMD
+
+// NaN is masked out of the sums and counts, and min(v, m) keeps m when v is NaN, as the
+// scalar comparisons do.  Floats are widened to double before they're summed.
+static inline size_t UHDF_simdSummarizeSSE2( const double *values, const size_t n,
+                                             double *sums, uint32_t *counts, double *mins, double *maxs)
+{
+    __m128d sumV[4], minV[4], maxV[4];
+    __m128i countV[4];
+    for (size_t k = 0; k < 4; k++)
+    {
+        sumV[k] = _mm_loadu_pd(sums + 2 * k);
+        minV[k] = _mm_loadu_pd(mins + 2 * k);
+        maxV[k] = _mm_loadu_pd(maxs + 2 * k);
+        countV[k] = _mm_setzero_si128();
+    }
+
+    size_t i = 0;
+    for (; i + UHDF_REDUCE_LANES <= n; i += UHDF_REDUCE_LANES)
+    {
+        for (size_t k = 0; k < 4; k++)
+        {
+            const __m128d v = _mm_loadu_pd(values + i + 2 * k);
+            const __m128d valid = _mm_cmpord_pd(v, v);
+            sumV[k] = _mm_add_pd(sumV[k], _mm_and_pd(v, valid));
+            countV[k] = _mm_sub_epi64(countV[k], _mm_castpd_si128(valid));
+            minV[k] = _mm_min_pd(v, minV[k]);
+            maxV[k] = _mm_max_pd(v, maxV[k]);
+        }
+    }
+
+    int64_t laneCounts[UHDF_REDUCE_LANES];
+    for (size_t k = 0; k < 4; k++)
+    {
+        _mm_storeu_pd(sums + 2 * k, sumV[k]);
+        _mm_storeu_pd(mins + 2 * k, minV[k]);
+        _mm_storeu_pd(maxs + 2 * k, maxV[k]);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(laneCounts + 2 * k), countV[k]);
+    }
+    for (size_t l = 0; l < UHDF_REDUCE_LANES; l++)
+        counts[l] += static_cast<uint32_t>(laneCounts[l]);
+    return i;
+}
+
+static inline size_t UHDF_simdSummarizeSSE2( const float *values, const size_t n,
+                                             double *sums, uint32_t *counts, float *mins, float *maxs)
+{
+    __m128d sumV[4];
+    __m128 minV[2], maxV[2];
+    __m128i countV[2];
+    for (size_t k = 0; k < 4; k++)
+        sumV[k] = _mm_loadu_pd(sums + 2 * k);
+    for (size_t k = 0; k < 2; k++)
+    {
+        minV[k] = _mm_loadu_ps(mins + 4 * k);
+        maxV[k] = _mm_loadu_ps(maxs + 4 * k);
+        countV[k] = _mm_setzero_si128();
+    }
+
+    size_t i = 0;
+    for (; i + UHDF_REDUCE_LANES <= n; i += UHDF_REDUCE_LANES)
+    {
+        for (size_t k = 0; k < 2; k++)
+        {
+            const __m128 v = _mm_loadu_ps(values + i + 4 * k);
+            const __m128 valid = _mm_cmpord_ps(v, v);
+            const __m128 masked = _mm_and_ps(v, valid);
+            sumV[2 * k] = _mm_add_pd(sumV[2 * k], _mm_cvtps_pd(masked));
+            sumV[2 * k + 1] = _mm_add_pd(sumV[2 * k + 1], _mm_cvtps_pd(_mm_movehl_ps(masked, masked)));
+            countV[k] = _mm_sub_epi32(countV[k], _mm_castps_si128(valid));
+            minV[k] = _mm_min_ps(v, minV[k]);
+            maxV[k] = _mm_max_ps(v, maxV[k]);
+        }
+    }
+
+    uint32_t laneCounts[UHDF_REDUCE_LANES];
+    for (size_t k = 0; k < 4; k++)
+        _mm_storeu_pd(sums + 2 * k, sumV[k]);
+    for (size_t k = 0; k < 2; k++)
+    {
+        _mm_storeu_ps(mins + 4 * k, minV[k]);
+        _mm_storeu_ps(maxs + 4 * k, maxV[k]);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(laneCounts + 4 * k), countV[k]);
+    }
+    for (size_t l = 0; l < UHDF_REDUCE_LANES; l++)
+        counts[l] += laneCounts[l];
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline size_t UHDF_simdSummarizeAVX2( const double *values, const size_t n,
+                                      double *sums, uint32_t *counts, double *mins, double *maxs)
+{
+    __m256d sumV[2], minV[2], maxV[2];
+    __m256i countV[2];
+    for (size_t k = 0; k < 2; k++)
+    {
+        sumV[k] = _mm256_loadu_pd(sums + 4 * k);
+        minV[k] = _mm256_loadu_pd(mins + 4 * k);
+        maxV[k] = _mm256_loadu_pd(maxs + 4 * k);
+        countV[k] = _mm256_setzero_si256();
+    }
+
+    size_t i = 0;
+    for (; i + UHDF_REDUCE_LANES <= n; i += UHDF_REDUCE_LANES)
+    {
+        for (size_t k = 0; k < 2; k++)
+        {
+            const __m256d v = _mm256_loadu_pd(values + i + 4 * k);
+            const __m256d valid = _mm256_cmp_pd(v, v, _CMP_ORD_Q);
+            sumV[k] = _mm256_add_pd(sumV[k], _mm256_and_pd(v, valid));
+            countV[k] = _mm256_sub_epi64(countV[k], _mm256_castpd_si256(valid));
+            minV[k] = _mm256_min_pd(v, minV[k]);
+            maxV[k] = _mm256_max_pd(v, maxV[k]);
+        }
+    }
+
+    int64_t laneCounts[UHDF_REDUCE_LANES];
+    for (size_t k = 0; k < 2; k++)
+    {
+        _mm256_storeu_pd(sums + 4 * k, sumV[k]);
+        _mm256_storeu_pd(mins + 4 * k, minV[k]);
+        _mm256_storeu_pd(maxs + 4 * k, maxV[k]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(laneCounts + 4 * k), countV[k]);
+    }
+    for (size_t l = 0; l < UHDF_REDUCE_LANES; l++)
+        counts[l] += static_cast<uint32_t>(laneCounts[l]);
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline size_t UHDF_simdSummarizeAVX2( const float *values, const size_t n,
+                                      double *sums, uint32_t *counts, float *mins, float *maxs)
+{
+    __m256d sumLow = _mm256_loadu_pd(sums);
+    __m256d sumHigh = _mm256_loadu_pd(sums + 4);
+    __m256 minV = _mm256_loadu_ps(mins);
+    __m256 maxV = _mm256_loadu_ps(maxs);
+    __m256i countV = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + UHDF_REDUCE_LANES <= n; i += UHDF_REDUCE_LANES)
+    {
+        const __m256 v = _mm256_loadu_ps(values + i);
+        const __m256 valid = _mm256_cmp_ps(v, v, _CMP_ORD_Q);
+        const __m256 masked = _mm256_and_ps(v, valid);
+        sumLow = _mm256_add_pd(sumLow, _mm256_cvtps_pd(_mm256_castps256_ps128(masked)));
+        sumHigh = _mm256_add_pd(sumHigh, _mm256_cvtps_pd(_mm256_extractf128_ps(masked, 1)));
+        countV = _mm256_sub_epi32(countV, _mm256_castps_si256(valid));
+        minV = _mm256_min_ps(v, minV);
+        maxV = _mm256_max_ps(v, maxV);
+    }
+
+    uint32_t laneCounts[UHDF_REDUCE_LANES];
+    _mm256_storeu_pd(sums, sumLow);
+    _mm256_storeu_pd(sums + 4, sumHigh);
+    _mm256_storeu_ps(mins, minV);
+    _mm256_storeu_ps(maxs, maxV);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(laneCounts), countV);
+    for (size_t l = 0; l < UHDF_REDUCE_LANES; l++)
+        counts[l] += laneCounts[l];
+    return i;
+}
+
+// difference from the mean, with NaN masked to 0
+static inline __m128d UHDF_simdDeviationSSE2( const __m128d v, const __m128d mean)
+{
+    return _mm_and_pd(_mm_sub_pd(v, mean), _mm_cmpord_pd(v, v));
+}
+
+static inline size_t UHDF_simdSquaresSSE2( const double *values, const size_t n, const double mean, double *squares)
+{
+    const __m128d meanV = _mm_set1_pd(mean);
+    __m128d squareV[4];
+    for (size_t k = 0; k < 4; k++)
+        squareV[k] = _mm_loadu_pd(squares + 2 * k);
+
+    size_t i = 0;
+    for (; i + UHDF_REDUCE_LANES <= n; i += UHDF_REDUCE_LANES)
+    {
+        for (size_t k = 0; k < 4; k++)
+        {
+            const __m128d d = UHDF_simdDeviationSSE2(_mm_loadu_pd(values + i + 2 * k), meanV);
+            squareV[k] = _mm_add_pd(squareV[k], _mm_mul_pd(d, d));
+        }
+    }
+
+    for (size_t k = 0; k < 4; k++)
+        _mm_storeu_pd(squares + 2 * k, squareV[k]);
+    return i;
+}
+
+static inline size_t UHDF_simdSquaresSSE2( const float *values, const size_t n, const double mean, double *squares)
+{
+    const __m128d meanV = _mm_set1_pd(mean);
+    __m128d squareV[4];
+    for (size_t k = 0; k < 4; k++)
+        squareV[k] = _mm_loadu_pd(squares + 2 * k);
+
+    size_t i = 0;
+    for (; i + UHDF_REDUCE_LANES <= n; i += UHDF_REDUCE_LANES)
+    {
+        for (size_t k = 0; k < 2; k++)
+        {
+            const __m128 v = _mm_loadu_ps(values + i + 4 * k);
+            const __m128d low = UHDF_simdDeviationSSE2(_mm_cvtps_pd(v), meanV);
+            const __m128d high = UHDF_simdDeviationSSE2(_mm_cvtps_pd(_mm_movehl_ps(v, v)), meanV);
+            squareV[2 * k] = _mm_add_pd(squareV[2 * k], _mm_mul_pd(low, low));
+            squareV[2 * k + 1] = _mm_add_pd(squareV[2 * k + 1], _mm_mul_pd(high, high));
+        }
+    }
+
+    for (size_t k = 0; k < 4; k++)
+        _mm_storeu_pd(squares + 2 * k, squareV[k]);
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256d UHDF_simdDeviationAVX2( const __m256d v, const __m256d mean)
+{
+    return _mm256_and_pd(_mm256_sub_pd(v, mean), _mm256_cmp_pd(v, v, _CMP_ORD_Q));
+}
+
+__attribute__((target("avx2")))
+static inline size_t UHDF_simdSquaresAVX2( const double *values, const size_t n, const double mean, double *squares)
+{
+    const __m256d meanV = _mm256_set1_pd(mean);
+    __m256d squareLow = _mm256_loadu_pd(squares);
+    __m256d squareHigh = _mm256_loadu_pd(squares + 4);
+
+    size_t i = 0;
+    for (; i + UHDF_REDUCE_LANES <= n; i += UHDF_REDUCE_LANES)
+    {
+        const __m256d low = UHDF_simdDeviationAVX2(_mm256_loadu_pd(values + i), meanV);
+        const __m256d high = UHDF_simdDeviationAVX2(_mm256_loadu_pd(values + i + 4), meanV);
+        squareLow = _mm256_add_pd(squareLow, _mm256_mul_pd(low, low));
+        squareHigh = _mm256_add_pd(squareHigh, _mm256_mul_pd(high, high));
+    }
+
+    _mm256_storeu_pd(squares, squareLow);
+    _mm256_storeu_pd(squares + 4, squareHigh);
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline size_t UHDF_simdSquaresAVX2( const float *values, const size_t n, const double mean, double *squares)
+{
+    const __m256d meanV = _mm256_set1_pd(mean);
+    __m256d squareLow = _mm256_loadu_pd(squares);
+    __m256d squareHigh = _mm256_loadu_pd(squares + 4);
+
+    size_t i = 0;
+    for (; i + UHDF_REDUCE_LANES <= n; i += UHDF_REDUCE_LANES)
+    {
+        const __m256 v = _mm256_loadu_ps(values + i);
+        const __m256d low = UHDF_simdDeviationAVX2(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), meanV);
+        const __m256d high = UHDF_simdDeviationAVX2(_mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), meanV);
+        squareLow = _mm256_add_pd(squareLow, _mm256_mul_pd(low, low));
+        squareHigh = _mm256_add_pd(squareHigh, _mm256_mul_pd(high, high));
+    }
+
+    _mm256_storeu_pd(squares, squareLow);
+    _mm256_storeu_pd(squares + 4, squareHigh);
+    return i;
+}
+
+// the SSE2 passes alone, for CPUs without AVX2
+template<typename T>
+struct UHDF_SimdReduceSSE2
+{
+    static inline size_t summarize( const T *values, const size_t n, double *sums, uint32_t *counts, T *mins, T *maxs)
+    {
+        return UHDF_simdSummarizeSSE2(values, n, sums, counts, mins, maxs);
+    }
+
+    static inline size_t squares( const T *values, const size_t n, const double mean, double *squares)
+    {
+        return UHDF_simdSquaresSSE2(values, n, mean, squares);
+    }
+};
+
+template<typename T>
+struct UHDF_SimdReduceFloat
+{
+    static inline size_t summarize( const T *values, const size_t n, double *sums, uint32_t *counts, T *mins, T *maxs)
+    {
+        if (UHDF_cpuHasAVX2())
+            return UHDF_simdSummarizeAVX2(values, n, sums, counts, mins, maxs);
+        return UHDF_simdSummarizeSSE2(values, n, sums, counts, mins, maxs);
+    }
+
+    static inline size_t squares( const T *values, const size_t n, const double mean, double *squares)
+    {
+        if (UHDF_cpuHasAVX2())
+            return UHDF_simdSquaresAVX2(values, n, mean, squares);
+        return UHDF_simdSquaresSSE2(values, n, mean, squares);
+    }
+};
+
+template<> struct UHDF_SimdReduce<float> : UHDF_SimdReduceFloat<float> {};
+template<> struct UHDF_SimdReduce<double> : UHDF_SimdReduceFloat<double> {};
+
+#endif // UHDF_HAVE_X86_SIMD
+
+// count, sum, extremes, mean and variance of every value that isn't NaN
+class UHDF_Statistics
+{
+public:
+    UHDF_Statistics() :
+        count (0),
+        sum (0),
+        minimum (std::numeric_limits<double>::infinity()),
+        maximum (-std::numeric_limits<double>::infinity()),
+        mean (0),
+        m2 (0)
+    {}
+
+    // float and double use the SSE2/AVX2 passes above; VECTOR can name another set of
+    // passes, eg UHDF_ScalarReduce<T> for the scalar loops alone
+    template<typename T, typename VECTOR = UHDF_SimdReduce<T> >
+    void add( const T *values, const size_t n)
+    {
+        for (size_t b = 0; b < n; b += UHDF_REDUCE_BLOCK)
+            addBlock<T, VECTOR>(values + b, std::min(UHDF_REDUCE_BLOCK, n - b));
+    }
+
+    // Chan et al.'s pairwise update, so partial results combine without losing precision
+    void merge( const UHDF_Statistics &other)
+    {
+        if (other.count == 0)
+            return;
+
+        const double total = static_cast<double>(count) + other.count;
+        const double delta = other.mean - mean;
+
+        mean += delta * other.count / total;
+        m2 += other.m2 + delta * delta * (static_cast<double>(count) * other.count / total);
+        count += other.count;
+        sum += other.sum;
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+    }
+
+    uint64_t getCount() const
+    {
+        return count;
+    }
+
+    double getSum() const
+    {
+        return sum;
+    }
+
+    // NaN when no values were counted, as are the mean and variance
+    double getMin() const
+    {
+        return count ? minimum : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    double getMax() const
+    {
+        return count ? maximum : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    double getMean() const
+    {
+        return count ? mean : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // population variance
+    double getVariance() const
+    {
+        return count ? m2 / count : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    double getStandardDeviation() const
+    {
+        return std::sqrt(getVariance());
+    }
+
+private:
+    uint64_t count;
+    double sum;
+    double minimum;
+    double maximum;
+    double mean;
+    double m2;  // sum of squared differences from the mean
+
+    template<typename T, typename VECTOR>
+    void addBlock( const T *values, const size_t n)
+    {
+        typedef typename UHDF_SumType<T>::type Sum;
+        const size_t L = UHDF_REDUCE_LANES;
+
+        const T highest = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+        const T lowest = std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+
+        Sum sums[L];
+        uint32_t counts[L];
+        T mins[L];
+        T maxs[L];
+        for (size_t l = 0; l < L; l++)
+        {
+            sums[l] = 0;
+            counts[l] = 0;
+            mins[l] = highest;
+            maxs[l] = lowest;
+        }
+
+        // first pass: sum, count and extremes in the values' own type; NaN fails every comparison
+        size_t i = VECTOR::summarize(values, n, sums, counts, mins, maxs);
+        for (; i + L <= n; i += L)
+        {
+            for (size_t l = 0; l < L; l++)
+            {
+                const T v = values[i + l];
+                const bool valid = UHDF_isNumber(v);
+                sums[l] += valid ? v : 0;
+                counts[l] += valid;
+                mins[l] = (v < mins[l]) ? v : mins[l];
+                maxs[l] = (v > maxs[l]) ? v : maxs[l];
+            }
+        }
+        for (; i < n; i++)
+        {
+            const T v = values[i];
+            const bool valid = UHDF_isNumber(v);
+            sums[0] += valid ? v : 0;
+            counts[0] += valid;
+            mins[0] = (v < mins[0]) ? v : mins[0];
+            maxs[0] = (v > maxs[0]) ? v : maxs[0];
+        }
+
+        Sum blockSum = 0;
+        uint64_t blockCount = 0;
+        T blockMin = highest;
+        T blockMax = lowest;
+        for (size_t l = 0; l < L; l++)
+        {
+            blockSum += sums[l];
+            blockCount += counts[l];
+            blockMin = std::min(blockMin, mins[l]);
+            blockMax = std::max(blockMax, maxs[l]);
+        }
+
+        if (blockCount == 0)
+            return;
+
+        // second pass, while the block is still in cache: squared differences from its mean
+        const double blockMean = static_cast<double>(blockSum) / blockCount;
+
+        double squares[L];
+        for (size_t l = 0; l < L; l++)
+            squares[l] = 0;
+
+        for (i = VECTOR::squares(values, n, blockMean, squares); i + L <= n; i += L)
+        {
+            for (size_t l = 0; l < L; l++)
+            {
+                const T v = values[i + l];
+                const double d = UHDF_isNumber(v) ? static_cast<double>(v) - blockMean : 0;
+                squares[l] += d * d;
+            }
+        }
+        for (; i < n; i++)
+        {
+            const T v = values[i];
+            const double d = UHDF_isNumber(v) ? static_cast<double>(v) - blockMean : 0;
+            squares[0] += d * d;
+        }
+
+        UHDF_Statistics block;
+        block.count = blockCount;
+        block.sum = static_cast<double>(blockSum);
+        block.minimum = static_cast<double>(blockMin);
+        block.maximum = static_cast<double>(blockMax);
+        block.mean = blockMean;
+        for (size_t l = 0; l < L; l++)
+            block.m2 += squares[l];
+
+        merge(block);
+    }
+};
+
+// counts of values in numBins equal-width bins over [low, high]; values equal to high go
+// in the last bin, values outside the range are counted separately, and NaN is skipped
+class UHDF_Histogram
+{
+public:
+    UHDF_Histogram( const double low, const double high, const size_t numBins) :
+        lowEdge (low),
+        highEdge (high),
+        bins (numBins, 0),
+        below (0),
+        above (0)
+    {
+        if (numBins == 0)
+            throw UHDF_Exception("Histogram needs at least one bin");
+        if (!(high > low))
+            throw UHDF_Exception("Histogram range is empty");
+    }
+
+    template<typename T>
+    void add( const T *values, const size_t n)
+    {
+        const double scale = bins.size() / (highEdge - lowEdge);
+        const size_t lastBin = bins.size() - 1;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            const double x = static_cast<double>(values[i]);
+
+            if (x >= lowEdge && x <= highEdge)
+                bins[std::min(static_cast<size_t>((x - lowEdge) * scale), lastBin)]++;
+            else if (x < lowEdge)
+                below++;
+            else if (x > highEdge)
+                above++;
+        }
+    }
+
+    void merge( const UHDF_Histogram &other)
+    {
+        if (other.bins.size() != bins.size() || other.lowEdge != lowEdge || other.highEdge != highEdge)
+            throw UHDF_Exception("Can't merge histograms with different bins");
+
+        for (size_t i = 0; i < bins.size(); i++)
+            bins[i] += other.bins[i];
+        below += other.below;
+        above += other.above;
+    }
+
+    const std::vector<uint64_t> &getBins() const
+    {
+        return bins;
+    }
+
+    size_t getNumBins() const
+    {
+        return bins.size();
+    }
+
+    // lower edge of bin i; getBinEdge(getNumBins()) is the upper edge of the last bin
+    double getBinEdge( const size_t i) const
+    {
+        return lowEdge + (highEdge - lowEdge) * i / bins.size();
+    }
+
+    uint64_t getNumBelow() const
+    {
+        return below;
+    }
+
+    uint64_t getNumAbove() const
+    {
+        return above;
+    }
+
+private:
+    double lowEdge;
+    double highEdge;
+    std::vector<uint64_t> bins;
+    uint64_t below;
+    uint64_t above;
+};
+
+#endif // UHDF_REDUCE_H
@@ -0,0 +1,177 @@
+#ifndef UHDF_SELECTION_H
+#define UHDF_SELECTION_H
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include "UHDF_Types.h"
+
+// Helpers for reading many small boxes (or single points, which are boxes with a count of
+// 1 in every dimension) in one call.  Boxes are given as rank starts and rank counts each,
+// one box after another; a NULL counts array means every box is a single point.
+
+// requests are read together when that reads at most this much data nobody asked for
+static const size_t UHDF_COALESCE_GAP_BYTES = 4096;
+
+static inline int32 UHDF_boxCount( const int32 *const counts, const int rank, const size_t box, const int dim)
+{
+    return (counts == NULL) ? 1 : counts[box * rank + dim];
+}
+
+static inline size_t UHDF_boxSize( const int32 *const counts, const int rank, const size_t box)
+{
+    size_t elems = 1;
+    for (int i = 0; i < rank; i++)
+        elems *= UHDF_boxCount(counts, rank, box, i);
+    return elems;
+}
+
+// calls fn(linearIndex) for every element of a box in row-major order, where linearIndex is
+// the element's position in the whole dataset
+template<typename FUNC>
+static void UHDF_forEachBoxElement( const int rank,
+                                    const int32 *const start,
+                                    const int32 *const count,
+                                    const std::vector<size_t> &dimensions,
+                                    FUNC fn)
+{
+    std::vector<int32> index(rank, 0);
+
+    while (true)
+    {
+        uint64_t linear = 0;
+        for (int i = 0; i < rank; i++)
+            linear = linear * dimensions[i] + start[i] + index[i];
+
+        fn(linear);
+
+        int dim = rank - 1;
+        while (dim >= 0 && ++index[dim] >= count[dim])
+            index[dim--] = 0;
+        if (dim < 0)
+            break;
+    }
+}
+
+// One read covering several requested boxes: the bounding box of all of them.
+struct UHDF_CoalescedRead
+{
+    std::vector<int32> start;
+    std::vector<int32> count;
+    std::vector<size_t> boxes;
+};
+
+// reads a box tries to join, most recent first, before it starts a read of its own
+static const size_t UHDF_COALESCE_WINDOW = 8;
+
+// Groups boxes into as few reads as it can.  Each box joins a read when growing the read to
+// cover it adds no more than gapElements elements nobody asked for, in any dimension; each
+// join saves one library call, and gapElements is what that call is worth.
+static inline std::vector<UHDF_CoalescedRead> UHDF_coalesceBoxes( const int rank,
+                                                                   const int32 *const starts,
+                                                                   const int32 *const counts,
+                                                                   const size_t numBoxes,
+                                                                   const size_t gapElements)
+{
+    // in row-major order of their starts, so neighbours in the file are met one after another
+    std::vector<size_t> order(numBoxes);
+    for (size_t i = 0; i < numBoxes; i++)
+        order[i] = i;
+
+    std::sort(order.begin(), order.end(),
+        [&](const size_t a, const size_t b)
+        {
+            return std::lexicographical_compare(starts + a * rank, starts + (a + 1) * rank,
+                                                starts + b * rank, starts + (b + 1) * rank);
+        });
+
+    std::vector<UHDF_CoalescedRead> reads;
+    std::vector<uint64_t> readElements;
+    std::vector<int32> grownStart(rank);
+    std::vector<int32> grownCount(rank);
+
+    for (auto box : order)
+    {
+        const int32 *const boxStart = starts + box * rank;
+        const uint64_t boxElements = UHDF_boxSize(counts, rank, box);
+
+        bool joined = false;
+        const size_t firstCandidate = (reads.size() > UHDF_COALESCE_WINDOW) ? reads.size() - UHDF_COALESCE_WINDOW : 0;
+        for (size_t r = reads.size(); r > firstCandidate && !joined; r--)
+        {
+            UHDF_CoalescedRead &read = reads[r - 1];
+
+            uint64_t grownElements = 1;
+            for (int i = 0; i < rank; i++)
+            {
+                const int32 first = std::min(read.start[i], boxStart[i]);
+                const int32 end = std::max(read.start[i] + read.count[i], boxStart[i] + UHDF_boxCount(counts, rank, box, i));
+                grownStart[i] = first;
+                grownCount[i] = end - first;
+                grownElements *= grownCount[i];
+            }
+
+            // the box may overlap the read, so this can be negative
+            const int64_t added = static_cast<int64_t>(grownElements) - static_cast<int64_t>(readElements[r - 1]) -
+                                  static_cast<int64_t>(boxElements);
+            if (added <= static_cast<int64_t>(gapElements))
+            {
+                read.start = grownStart;
+                read.count = grownCount;
+                read.boxes.push_back(box);
+                readElements[r - 1] = grownElements;
+                joined = true;
+            }
+        }
+
+        if (!joined)
+        {
+            UHDF_CoalescedRead read;
+            read.start.assign(boxStart, boxStart + rank);
+            read.count.resize(rank);
+            for (int i = 0; i < rank; i++)
+                read.count[i] = UHDF_boxCount(counts, rank, box, i);
+            read.boxes.push_back(box);
+            reads.push_back(read);
+            readElements.push_back(boxElements);
+        }
+    }
+
+    return reads;
+}
+
+// copies one box out of the packed data of the coalesced read that covers it
+static inline void UHDF_copyBoxFromRead( const UHDF_CoalescedRead &read,
+                                         const int rank,
+                                         const int32 *const boxStart,
+                                         const int32 *const boxCounts,
+                                         const size_t elementSize,
+                                         const char *readData,
+                                         char *boxData)
+{
+    const int last = rank - 1;
+    const size_t boxWidth = UHDF_boxCount(boxCounts, rank, 0, last);
+    const size_t rowBytes = boxWidth * elementSize;
+
+    // one run of boxWidth elements per row of the box, at the same row of the read
+    std::vector<int32> index(rank, 0);
+
+    while (true)
+    {
+        size_t offset = 0;
+        for (int i = 0; i < rank; i++)
+            offset = offset * read.count[i] + (boxStart[i] + index[i] - read.start[i]);
+
+        memcpy(boxData, readData + offset * elementSize, rowBytes);
+        boxData += rowBytes;
+
+        int dim = last - 1;
+        while (dim >= 0 && ++index[dim] >= UHDF_boxCount(boxCounts, rank, 0, dim))
+            index[dim--] = 0;
+        if (dim < 0)
+            break;
+    }
+}
+
+#endif // UHDF_SELECTION_H
@@ -0,0 +1,74 @@
+#ifndef UHDF_SHARED_H
+#define UHDF_SHARED_H
+
+#include <utility>
+
+#include "UHDF_Dataset.h"
+#include "UHDF_Group.h"
+
+// Copyable form of a UHDF_Dataset or UHDF_Group, for the places a move-only handle can't
+// go: std::function tasks, containers that copy, and caches handing out copies.  Each
+// copy is another handle made by share(), so the library's reference count on the id
+// keeps the object open until the last copy closes, and no copy has to look it up again.
+// Copies on different threads share one library object; HDF4 isn't thread-safe, so a
+// copy used from a worker still needs UHDF_libraryMutex held around it.
+template<typename HANDLE>
+class UHDF_Shared
+{
+public:
+    UHDF_Shared( HANDLE &&sharedHandle) :
+        handle (std::move(sharedHandle))
+    {}
+
+    UHDF_Shared( const UHDF_Shared &other) :
+        handle (other.handle.share())
+    {}
+
+    UHDF_Shared &operator=( const UHDF_Shared &other)
+    {
+        if (this != &other)
+            handle = other.handle.share();
+        return *this;
+    }
+
+    UHDF_Shared( UHDF_Shared &&) = default;
+    UHDF_Shared &operator=( UHDF_Shared &&) = default;
+
+    HANDLE &get()
+    {
+        return handle;
+    }
+
+    const HANDLE &get() const
+    {
+        return handle;
+    }
+
+    HANDLE *operator->()
+    {
+        return &handle;
+    }
+
+    const HANDLE *operator->() const
+    {
+        return &handle;
+    }
+
+    HANDLE &operator*()
+    {
+        return handle;
+    }
+
+    const HANDLE &operator*() const
+    {
+        return handle;
+    }
+
+private:
+    HANDLE handle;
+};
+
+typedef UHDF_Shared<UHDF_Dataset> UHDF_SharedDataset;
+typedef UHDF_Shared<UHDF_Group> UHDF_SharedGroup;
+
+#endif // UHDF_SHARED_H
@@ -0,0 +1,156 @@
+#ifndef UHDF_STREAM_H
+#define UHDF_STREAM_H
+
+#include <vector>
+#include <future>
+#include <algorithm>
+
+#include "UHDF_Types.h"
+#include "UHDF_View.h"
+#include "UHDF_Dataset.h"
+
+// bytes each streamed block aims for, rounded to whole rows of chunks
+static const size_t UHDF_DEFAULT_STREAM_BLOCK_BYTES = 4 * 1024 * 1024;
+
+// Walks a dataset along its slowest dimension in blocks of rows, reading each block on the
+// I/O thread while the caller processes the one before it.  Two buffers are used in turn,
+// so a block returned by next() stays valid until the following call to next().
+//
+//     UHDF_StreamReader<float> stream(dataset);
+//     UHDF_View<float> block;
+//     while (stream.next(block))
+//         process(block);
+//
+// The dataset must outlive the reader, and while it's streaming the caller must hold
+// UHDF_libraryMutex() for any other library calls it makes.
+template<typename T>
+class UHDF_StreamReader
+{
+public:
+    // rowsPerBlock = 0 picks whole rows of chunks adding up to about UHDF_DEFAULT_STREAM_BLOCK_BYTES
+    UHDF_StreamReader( const UHDF_Dataset &streamDataset, size_t rowsPerBlock = 0) :
+        dataset (streamDataset),
+        dimensions (streamDataset.getDimensions()),
+        numRows (dimensions.empty() ? 1 : dimensions[0]),
+        nextRow (0),
+        blockStart (0),
+        filling (0)
+    {
+        if (rowsPerBlock == 0)
+            rowsPerBlock = defaultRowsPerBlock();
+        blockRows = std::max<size_t>(1, std::min(rowsPerBlock, numRows));
+
+        requestNext();
+    }
+
+    // waits for any read still in flight, since it writes into this reader's buffers
+    ~UHDF_StreamReader()
+    {
+        if (pending.valid())
+            pending.wait();
+    }
+
+    UHDF_StreamReader( const UHDF_StreamReader &) = delete;
+    UHDF_StreamReader &operator=( const UHDF_StreamReader &) = delete;
+
+    // the next block, shaped like the dataset but with fewer rows; false once every row has
+    // been returned
+    bool next( UHDF_View<T> &block)
+    {
+        if (!pending.valid())
+            return false;
+
+        pending.get();
+
+        const int ready = filling;
+        const std::vector<size_t> shape(readShape);
+        blockStart = readStart;
+
+        // the other buffer is free again, since the caller is done with the block it held
+        filling = 1 - filling;
+        requestNext();
+
+        block = buffers[ready].view(shape);
+        return true;
+    }
+
+    // first row of the block last returned by next()
+    size_t getBlockStart() const
+    {
+        return blockStart;
+    }
+
+    size_t getRowsPerBlock() const
+    {
+        return blockRows;
+    }
+
+    size_t getNumBlocks() const
+    {
+        return (numRows + blockRows - 1) / blockRows;
+    }
+
+private:
+    const UHDF_Dataset &dataset;
+    std::vector<size_t> dimensions;
+    size_t numRows;
+    size_t blockRows;
+    size_t nextRow;
+
+    // the block being read
+    size_t readStart;
+    std::vector<size_t> readShape;
+    std::vector<int32> start;
+    std::vector<int32> stride;
+    std::vector<int32> count;
+
+    size_t blockStart;
+    UHDF_Buffer<T> buffers[2];
+    int filling;
+    std::future<void> pending;
+
+    size_t defaultRowsPerBlock() const
+    {
+        if (dimensions.empty())
+            return 1;
+
+        size_t rowBytes = sizeof(T);
+        for (size_t i = 1; i < dimensions.size(); i++)
+            rowBytes *= dimensions[i];
+
+        const size_t tileRows = std::max<size_t>(1, dataset.getTileDimensions()[0]);
+        const size_t tileBytes = std::max<size_t>(1, tileRows * rowBytes);
+
+        return tileRows * std::max<size_t>(1, UHDF_DEFAULT_STREAM_BLOCK_BYTES / tileBytes);
+    }
+
+    void requestNext()
+    {
+        if (nextRow >= numRows)
+            return;
+
+        const size_t rows = std::min(blockRows, numRows - nextRow);
+
+        readStart = nextRow;
+        readShape = dimensions;
+        start.assign(dimensions.size(), 0);
+        stride.assign(dimensions.size(), 1);
+        count.assign(dimensions.begin(), dimensions.end());
+        if (!dimensions.empty())
+        {
+            readShape[0] = rows;
+            start[0] = nextRow;
+            count[0] = rows;
+        }
+
+        size_t blockElems = 1;
+        for (auto n : readShape)
+            blockElems *= n;
+
+        buffers[filling].resize(blockElems);
+        pending = dataset.readAsync(start.data(), stride.data(), count.data(), buffers[filling].data());
+        nextRow += rows;
+    }
+};
+
+#endif // UHDF_STREAM_H
@@ -0,0 +1,215 @@
+#ifndef UHDF_THREADPOOL_H
+#define UHDF_THREADPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "UHDF_Types.h"
+
+// HDF4 isn't thread-safe at all, and the thread-safe HDF5 build serializes every call
+// internally, so any library calls made from worker threads are made while holding this
+// lock.  It only guards calls made by the library's own workers; callers that use UHDF
+// objects from several threads of their own must still serialize those uses themselves.
+inline std::recursive_mutex &UHDF_libraryMutex()
+{
+    static std::recursive_mutex mutex;
+    return mutex;
+}
+
+// A value fetched with library calls the first time it's asked for, then kept.  The first
+// fetch holds UHDF_libraryMutex(), and the value is complete before the flag says so, so
+// threads asking at once get one fetch between them.  Copies take the value if it's there.
+template<typename T>
+class UHDF_LoadOnce
+{
+public:
+    UHDF_LoadOnce() :
+        loaded (false)
+    {}
+
+    UHDF_LoadOnce( const UHDF_LoadOnce &other) :
+        loaded (false)
+    {
+        if (other.loaded.load(std::memory_order_acquire))
+        {
+            value = other.value;
+            loaded.store(true, std::memory_order_release);
+        }
+    }
+
+    UHDF_LoadOnce &operator=( const UHDF_LoadOnce &other)
+    {
+        if (this != &other)
+        {
+            const bool otherLoaded = other.loaded.load(std::memory_order_acquire);
+            value = otherLoaded ? other.value : T();
+            loaded.store(otherLoaded, std::memory_order_release);
+        }
+        return *this;
+    }
+
+    template<typename LOAD>
+    const T &get( LOAD load) const
+    {
+        if (!loaded.load(std::memory_order_acquire))
+        {
+            std::lock_guard<std::recursive_mutex> lock(UHDF_libraryMutex());
+            if (!loaded.load(std::memory_order_relaxed))
+            {
+                value = load();
+                loaded.store(true, std::memory_order_release);
+            }
+        }
+        return value;
+    }
+
+    // for updating the value, which callers serialize with any other use
+    template<typename LOAD>
+    T &get( LOAD load)
+    {
+        static_cast<const UHDF_LoadOnce&>(*this).get(load);
+        return value;
+    }
+
+private:
+    mutable T value;
+    mutable std::atomic<bool> loaded;
+};
+
+static inline unsigned UHDF_defaultThreadCount()
+{
+    const unsigned n = std::thread::hardware_concurrency();
+    return (n == 0) ? 1 : n;
+}
+
+// fixed-size pool of worker threads running queued tasks in FIFO order
+class UHDF_ThreadPool
+{
+public:
+    UHDF_ThreadPool( unsigned numThreads = 0) :
+        stopping (false)
+    {
+        if (numThreads == 0)
+            numThreads = UHDF_defaultThreadCount();
+
+        for (unsigned i = 0; i < numThreads; i++)
+            workers.push_back(std::thread(&UHDF_ThreadPool::workerLoop, this));
+    }
+
+    // finishes all queued tasks before returning
+    ~UHDF_ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueReady.notify_all();
+
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    UHDF_ThreadPool( const UHDF_ThreadPool &) = delete;
+    UHDF_ThreadPool &operator=( const UHDF_ThreadPool &) = delete;
+
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+    // any exception thrown by the task is rethrown from the returned future's get()
+    template<typename FUNC>
+    std::future<typename std::result_of<FUNC()>::type> submit( FUNC task)
+    {
+        typedef typename std::result_of<FUNC()>::type Result;
+
+        std::shared_ptr<std::packaged_task<Result()>> packaged(new std::packaged_task<Result()>(task));
+        std::future<Result> result = packaged->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (stopping)
+                throw UHDF_Exception("Can't submit work to a thread pool that is shutting down");
+
+            tasks.push([packaged]() { (*packaged)(); });
+        }
+        queueReady.notify_one();
+
+        return result;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    bool stopping;
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueReady.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+                if (tasks.empty())
+                    return;
+
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+
+            task();
+        }
+    }
+};
+
+// single worker shared by every asynchronous read, so queued reads reach the library one at
+// a time and in the order they were requested
+inline UHDF_ThreadPool &UHDF_ioThread()
+{
+    static UHDF_ThreadPool pool(1);
+    return pool;
+}
+
+// retakes a lock on scope exit, so objects declared before it are destroyed with the lock
+// held even when the scope is left by an exception
+class UHDF_RelockOnExit
+{
+public:
+    UHDF_RelockOnExit( std::unique_lock<std::recursive_mutex> &heldLock) :
+        lock (heldLock)
+    {}
+
+    ~UHDF_RelockOnExit()
+    {
+        if (!lock.owns_lock())
+            lock.lock();
+    }
+
+private:
+    std::unique_lock<std::recursive_mutex> &lock;
+};
+
+// waits for every future, then rethrows the first failure, so no task is still running
+// (and using the caller's buffers) when an exception leaves the caller
+template<typename FUTURES>
+static void UHDF_waitAll( FUTURES &futures)
+{
+    for (auto &f : futures)
+        f.wait();
+
+    for (auto &f : futures)
+        f.get();
+}
+
+#endif // UHDF_THREADPOOL_H
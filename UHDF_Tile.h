@@ -0,0 +1,296 @@
+#ifndef UHDF_TILE_H
+#define UHDF_TILE_H
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstddef>
+
+#include "UHDF_Types.h"
+
+// target size of a tile when the dataset isn't chunked and there's no chunk grid to follow
+static const size_t UHDF_DEFAULT_TILE_BYTES = 1 << 20;
+
+// a single block of a dataset, in the same start/count form that UHDF_Dataset::read takes
+class UHDF_Tile
+{
+public:
+    UHDF_Tile() :
+        index (0)
+    {}
+
+    UHDF_Tile( const size_t tileIndex, const std::vector<int32> &tileStart, const std::vector<int32> &tileCount) :
+        index (tileIndex),
+        start (tileStart),
+        count (tileCount)
+    {}
+
+    // position of this tile in the iteration order
+    size_t getIndex() const
+    {
+        return index;
+    }
+
+    size_t getRank() const
+    {
+        return start.size();
+    }
+
+    const std::vector<int32> &getStart() const
+    {
+        return start;
+    }
+
+    const std::vector<int32> &getCount() const
+    {
+        return count;
+    }
+
+    size_t getNumElements() const
+    {
+        size_t elems = 1;
+        for (auto n : count)
+        {
+            elems *= n;
+        }
+        return elems;
+    }
+
+private:
+    size_t index;
+    std::vector<int32> start;
+    std::vector<int32> count;
+};
+
+// the grid of tiles covering a region of a dataset; tile boundaries fall on multiples
+// of the tile dimensions (ie, chunk boundaries), so the first and last tile along each
+// dimension may be smaller than a full tile when the region isn't chunk-aligned
+class UHDF_TileGrid
+{
+public:
+    UHDF_TileGrid( const std::vector<size_t> &tileDims,
+                   const std::vector<int32> &regionStart,
+                   const std::vector<int32> &regionCount) :
+        tileDimensions (tileDims),
+        start (regionStart),
+        count (regionCount),
+        numTiles (1)
+    {
+        if (tileDimensions.size() != start.size() || start.size() != count.size())
+            throw UHDF_Exception("Tile dimensions don't match the rank of the region being tiled");
+
+        for (size_t i = 0; i < tileDimensions.size(); i++)
+        {
+            if (tileDimensions[i] == 0)
+                throw UHDF_Exception("Zero tile dimension given");
+            if (start[i] < 0 || count[i] < 0)
+                throw UHDF_Exception("Negative start or count given for tiled region");
+
+            const size_t first = start[i] / tileDimensions[i];
+            const size_t last = (count[i] == 0) ? first : (start[i] + count[i] - 1) / tileDimensions[i] + 1;
+
+            firstTile.push_back(first);
+            tilesPerDim.push_back(last - first);
+            numTiles *= (last - first);
+        }
+    }
+
+    size_t getNumTiles() const
+    {
+        return numTiles;
+    }
+
+    const std::vector<size_t> &getTileDimensions() const
+    {
+        return tileDimensions;
+    }
+
+    const std::vector<size_t> &getTilesPerDimension() const
+    {
+        return tilesPerDim;
+    }
+
+    // tiles are numbered in row-major order (last dimension fastest), matching storage order
+    UHDF_Tile getTile( const size_t tileIndex) const
+    {
+        if (tileIndex >= numTiles)
+            throw UHDF_Exception("Tile index out of range");
+
+        const size_t rank = tileDimensions.size();
+        std::vector<int32> tileStart(rank);
+        std::vector<int32> tileCount(rank);
+
+        size_t remainder = tileIndex;
+        for (size_t i = rank; i-- > 0; )
+        {
+            const size_t gridPos = firstTile[i] + remainder % tilesPerDim[i];
+            remainder /= tilesPerDim[i];
+
+            const int64_t regionEnd = static_cast<int64_t>(start[i]) + count[i];
+            const int64_t lo = std::max<int64_t>(gridPos * tileDimensions[i], start[i]);
+            const int64_t hi = std::min<int64_t>((gridPos + 1) * tileDimensions[i], regionEnd);
+
+            tileStart[i] = static_cast<int32>(lo);
+            tileCount[i] = static_cast<int32>(hi - lo);
+        }
+
+        return UHDF_Tile(tileIndex, tileStart, tileCount);
+    }
+
+private:
+    std::vector<size_t> tileDimensions;
+    std::vector<int32> start;
+    std::vector<int32> count;
+    std::vector<size_t> firstTile;
+    std::vector<size_t> tilesPerDim;
+    size_t numTiles;
+};
+
+class UHDF_TileIterator
+{
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef UHDF_Tile value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const UHDF_Tile *pointer;
+    typedef const UHDF_Tile &reference;
+
+    UHDF_TileIterator( const UHDF_TileGrid *tileGrid, const size_t tileIndex) :
+        grid (tileGrid),
+        index (tileIndex)
+    {
+        load();
+    }
+
+    const UHDF_Tile &operator*() const
+    {
+        return tile;
+    }
+
+    const UHDF_Tile *operator->() const
+    {
+        return &tile;
+    }
+
+    UHDF_TileIterator &operator++()
+    {
+        index++;
+        load();
+        return *this;
+    }
+
+    UHDF_TileIterator operator++(int)
+    {
+        UHDF_TileIterator prev(*this);
+        ++(*this);
+        return prev;
+    }
+
+    bool operator==( const UHDF_TileIterator &other) const
+    {
+        return grid == other.grid && index == other.index;
+    }
+
+    bool operator!=( const UHDF_TileIterator &other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    const UHDF_TileGrid *grid;
+    size_t index;
+    UHDF_Tile tile;
+
+    void load()
+    {
+        if (index < grid->getNumTiles())
+            tile = grid->getTile(index);
+    }
+};
+
+// iterable set of tiles, for use in range-based for loops
+class UHDF_TileRange
+{
+public:
+    UHDF_TileRange( const UHDF_TileGrid &tileGrid) :
+        grid (tileGrid)
+    {}
+
+    UHDF_TileIterator begin() const
+    {
+        return UHDF_TileIterator(&grid, 0);
+    }
+
+    UHDF_TileIterator end() const
+    {
+        return UHDF_TileIterator(&grid, grid.getNumTiles());
+    }
+
+    size_t size() const
+    {
+        return grid.getNumTiles();
+    }
+
+    const UHDF_TileGrid &getGrid() const
+    {
+        return grid;
+    }
+
+private:
+    UHDF_TileGrid grid;
+};
+
+// A run of consecutive elements of a selection along its slowest dimension.
+struct UHDF_RowRange
+{
+    int32 first;  // index into the selection, not a file coordinate
+    int32 count;
+};
+
+// Splits the slowest dimension of a selection (start, stride, count) into at most maxPieces
+// runs of consecutive selected rows without splitting any tile (chunk) row between two runs,
+// so each piece is a contiguous part of the packed output and no chunk is decoded by more
+// than one piece.  Fewer pieces are returned when there are fewer tile rows than maxPieces.
+static inline std::vector<UHDF_RowRange> UHDF_splitRows( const int32 start,
+                                                         const int32 stride,
+                                                         const int32 count,
+                                                         const size_t tileRows,
+                                                         const size_t maxPieces)
+{
+    if (tileRows == 0 || stride <= 0)
+        throw UHDF_Exception("Invalid tile size or stride when splitting rows");
+
+    // boundaries between groups of selected rows that fall in the same tile row
+    std::vector<int32> groupStarts;
+    int32 k = 0;
+    while (k < count)
+    {
+        groupStarts.push_back(k);
+
+        const int64_t tileRow = (static_cast<int64_t>(start) + static_cast<int64_t>(k) * stride) / tileRows;
+        const int64_t nextTileStart = (tileRow + 1) * tileRows;
+        const int64_t nextK = (nextTileStart - start + stride - 1) / stride;
+        k = static_cast<int32>(std::min<int64_t>(nextK, count));
+    }
+
+    const size_t numGroups = groupStarts.size();
+    const size_t pieces = std::max<size_t>(1, std::min(numGroups, maxPieces));
+
+    std::vector<UHDF_RowRange> ranges;
+    for (size_t p = 0; p < pieces; p++)
+    {
+        const size_t firstGroup = p * numGroups / pieces;
+        const size_t endGroup = (p + 1) * numGroups / pieces;
+        const int32 first = (numGroups == 0) ? 0 : groupStarts[firstGroup];
+        const int32 end = (endGroup >= numGroups) ? count : groupStarts[endGroup];
+
+        UHDF_RowRange range;
+        range.first = first;
+        range.count = end - first;
+        ranges.push_back(range);
+    }
+
+    return ranges;
+}
+
+#endif // UHDF_TILE_H
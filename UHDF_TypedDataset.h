@@ -0,0 +1,235 @@
+#ifndef UHDF_TYPEDDATASET_H
+#define UHDF_TYPEDDATASET_H
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+
+#include <boost/lexical_cast.hpp>
+
+#include "UHDF_Types.h"
+#include "UHDF_H5Holder.h"
+#include "UHDF_Convert.h"
+#include "UHDF_Dataset.h"
+
+// A dataset read as values of T with exactly RANK dimensions, both checked once when it's
+// opened.  Positions and shapes are std::arrays.  Which conversion reads need is settled
+// at open: each read goes straight to the instantiation for the dataset's own type, with
+// the conversion kernel fixed at compile time.  HDF5 reads reuse one file dataspace, and
+// reuse the memory dataspace while the shape stays the same.  Windows small enough to
+// convert in cache are read into a buffer the handle keeps.  So repeated small reads make
+// no allocations of their own.
+//
+// Like UHDF_ReadPlan, but the window can change shape from read to read.  A typed dataset
+// shouldn't be used from more than one thread at a time.
+template<typename T, size_t RANK>
+class UHDF_TypedDataset
+{
+    static_assert(RANK >= 1 && RANK <= static_cast<size_t>(UHDF_MAX_RANK), "Typed datasets need between 1 and UHDF_MAX_RANK dimensions");
+
+public:
+    typedef std::array<int32, RANK> Index;
+    typedef std::array<size_t, RANK> Shape;
+
+    // opens datasetName from owner, a UHDF_File or UHDF_Group
+    template<typename OWNER>
+    UHDF_TypedDataset( const OWNER &owner, const std::string &datasetName) :
+        dataset (owner.openDataset(datasetName))
+    {
+        init();
+    }
+
+    UHDF_TypedDataset( const UHDF_TypedDataset &) = delete;
+    UHDF_TypedDataset &operator=( const UHDF_TypedDataset &) = delete;
+
+    const UHDF_Dataset &getDataset() const
+    {
+        return dataset;
+    }
+
+    const Shape &getDimensions() const
+    {
+        return dimensions;
+    }
+
+    size_t getNumElements() const
+    {
+        return dataset.getNumElements();
+    }
+
+    void read( const Index &start, const Index &stride, const Index &count, T* buffer)
+    {
+        (this->*readFunction)(start.data(), stride.data(), count.data(), buffer);
+    }
+
+    void read( const Index &start, const Index &count, T* buffer)
+    {
+        (this->*readFunction)(start.data(), unitStride.data(), count.data(), buffer);
+    }
+
+    std::vector<T> readAll()
+    {
+        Index start;
+        Index count;
+        start.fill(0);
+        std::copy(dimensions.begin(), dimensions.end(), count.begin());
+
+        std::vector<T> buffer(getNumElements());
+        read(start, count, buffer.data());
+        return buffer;
+    }
+
+private:
+    typedef void (UHDF_TypedDataset::*ReadFunction)( const int32 *, const int32 *, const int32 *, T*);
+
+    UHDF_Dataset dataset;
+    Shape dimensions;
+    Index unitStride;
+    ReadFunction readFunction;
+
+    // HDF5 only
+    hid_t fileMemType;
+    std::unique_ptr<UHDF_SpaceHolder> fileSpace;
+    std::unique_ptr<UHDF_SpaceHolder> memSpace;
+    Index memSpaceCount;
+
+    // windows in the dataset's own type, before conversion
+    std::vector<uint64_t> scratch;
+
+    void init()
+    {
+        if (dataset.getRank() != RANK)
+            throw UHDF_Exception("Dataset '" + dataset.getName() + "' has " + boost::lexical_cast<std::string>(dataset.getRank()) +
+                                 " dimensions, not " + boost::lexical_cast<std::string>(RANK));
+
+        std::copy(dataset.getDimensions().begin(), dataset.getDimensions().end(), dimensions.begin());
+        unitStride.fill(1);
+        memSpaceCount.fill(0);
+
+        switch(dataset.getType())
+        {
+        case UHDF_UINT8:
+            readFunction = &UHDF_TypedDataset::readAs<uint8_t>;
+            break;
+        case UHDF_INT8:
+            readFunction = &UHDF_TypedDataset::readAs<int8_t>;
+            break;
+        case UHDF_UINT16:
+            readFunction = &UHDF_TypedDataset::readAs<uint16_t>;
+            break;
+        case UHDF_INT16:
+            readFunction = &UHDF_TypedDataset::readAs<int16_t>;
+            break;
+        case UHDF_UINT32:
+            readFunction = &UHDF_TypedDataset::readAs<uint32_t>;
+            break;
+        case UHDF_INT32:
+            readFunction = &UHDF_TypedDataset::readAs<int32_t>;
+            break;
+        case UHDF_UINT64:
+            readFunction = &UHDF_TypedDataset::readAs<uint64_t>;
+            break;
+        case UHDF_INT64:
+            readFunction = &UHDF_TypedDataset::readAs<int64_t>;
+            break;
+        case UHDF_FLOAT32:
+            readFunction = &UHDF_TypedDataset::readAs<float>;
+            break;
+        case UHDF_FLOAT64:
+            readFunction = &UHDF_TypedDataset::readAs<double>;
+            break;
+        default:
+            throw UHDF_Exception("Can't read dataset '" + dataset.getName() + "' of type " + UHDFTypeName(dataset.getType()) +
+                                 " as " + UHDFTypeName(UHDF_TypeOf<T>::value));
+        }
+
+        if (dataset.fileType == UHDF_HDF5)
+        {
+            fileMemType = UHDFTypeToH5(dataset.shape().dataType);
+            fileSpace.reset(new UHDF_SpaceHolder(H5Dget_space(dataset.id.h5id)));
+        }
+    }
+
+    template<typename FILE_T>
+    void readAs( const int32 *const start, const int32 *const stride, const int32 *const count, T* buffer)
+    {
+        size_t numElements = 1;
+        for (size_t i = 0; i < RANK; i++)
+        {
+            if (count[i] <= 0)
+                throw UHDF_Exception("Zero or negative count given when reading");
+            numElements *= count[i];
+        }
+
+        if (std::is_same<FILE_T, T>::value)
+        {
+            rawRead(start, stride, count, buffer);
+            return;
+        }
+
+        // large reads are converted a block at a time as they're read, rather than needing
+        // scratch space the size of the whole read
+        if (numElements * sizeof(FILE_T) > UHDF_CONVERT_BLOCK_BYTES)
+        {
+            dataset.read(start, stride, count, buffer);
+            return;
+        }
+
+        scratch.resize((numElements * sizeof(FILE_T) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        FILE_T *unconverted = reinterpret_cast<FILE_T*>(scratch.data());
+        rawRead(start, stride, count, unconverted);
+
+        const UHDF_IOTimer timer(*dataset.ioCounters, UHDF_IOCounters::CONVERSION_NANOSECONDS);
+        UHDF_convert(unconverted, buffer, numElements);
+    }
+
+    // reads in the dataset's own type
+    void rawRead( const int32 *const start, const int32 *const stride, const int32 *const count, void *buffer)
+    {
+        std::unique_lock<std::recursive_mutex> guard;
+        if (dataset.libraryLock != NULL)
+            guard = std::unique_lock<std::recursive_mutex>(*dataset.libraryLock);
+
+        dataset.fitChunkCache(stride, count);
+
+        dataset.countRead(dataset.getSelectionSize(count));
+        const UHDF_IOTimer timer(*dataset.ioCounters, UHDF_IOCounters::LIBRARY_NANOSECONDS);
+
+        switch(dataset.fileType)
+        {
+        case UHDF_HDF4:
+            if (SDreaddata(dataset.id.h4id, const_cast<int32*>(start), const_cast<int32*>(stride), const_cast<int32*>(count), buffer) < 0)
+                throw UHDF_Exception("Error reading HDF4 dataset '" + dataset.datasetname + "'");
+            break;
+        case UHDF_HDF5:
+        {
+            hsize_t hstart[RANK];
+            hsize_t hstride[RANK];
+            hsize_t hcount[RANK];
+            for (size_t i = 0; i < RANK; i++)
+            {
+                hstart[i] = start[i];
+                hstride[i] = stride[i];
+                hcount[i] = count[i];
+            }
+
+            if (H5Sselect_hyperslab(fileSpace->get(), H5S_SELECT_SET, hstart, hstride, hcount, NULL) < 0)
+                throw UHDF_Exception("Error selecting region to read from HDF5 dataset '" + dataset.datasetname + "'");
+
+            if (!memSpace || !std::equal(memSpaceCount.begin(), memSpaceCount.end(), count))
+            {
+                memSpace.reset(new UHDF_SpaceHolder(H5Screate_simple(RANK, hcount, NULL)));
+                std::copy(count, count + RANK, memSpaceCount.begin());
+            }
+
+            if (H5Dread(dataset.id.h5id, fileMemType, memSpace->get(), fileSpace->get(), H5P_DEFAULT, buffer) < 0)
+                throw UHDF_Exception("Error reading HDF5 dataset '" + dataset.datasetname + "'");
+            break;
+        }
+        }
+    }
+};
+
+#endif // UHDF_TYPEDDATASET_H
@@ -3,7 +3,8 @@
 
 #include <stdexcept>
 #include <stdint.h>
-#include <map>
+#include <string>
+#include <type_traits>
 
 // HDF4
 #include "hdf/mfhdf.h"
@@ -20,7 +21,9 @@ public:
 
 typedef enum
 {
-    UHDF_READONLY  // read-only is the only mode supported in this version
+    UHDF_READONLY,
+    UHDF_READWRITE,  // existing file, opened for writing
+    UHDF_CREATE      // new file, replacing any file already there
 } UHDF_FileAccess;
 
 typedef enum
@@ -29,6 +32,9 @@ typedef enum
     UHDF_HDF5
 } UHDF_FileType;
 
+// most dimensions a dataset can have in either format (H5S_MAX_RANK, and HDF4's MAX_VAR_DIMS)
+static const int UHDF_MAX_RANK = 32;
+
 typedef union
 {
     hid_t h5id;
@@ -52,99 +58,174 @@ typedef enum
     UHDF_UNKNOWN
 } UHDF_DataType;
 
-static const std::map<UHDF_DataType, std::string> UHDFNameMap = {
-    {UHDF_UINT8,     "UINT8"},
-    {UHDF_INT8,      "INT8"},
-    {UHDF_UINT16,    "UINT16"},
-    {UHDF_INT16,     "INT16"},
-    {UHDF_UINT32,    "UINT32"},
-    {UHDF_INT32,     "INT32"},
-    {UHDF_UINT64,    "UINT64"},
-    {UHDF_INT64,     "INT64"},
-    {UHDF_FLOAT32,   "FLOAT32"},
-    {UHDF_FLOAT64,   "FLOAT64"},
-    {UHDF_STRING,    "STRING"},
-    {UHDF_REFERENCE, "REFERENCE"},
-    {UHDF_UNKNOWN,   "UNKNOWN"}
+typedef enum
+{
+    UHDF_CONTIGUOUS,
+    UHDF_CHUNKED,
+    UHDF_COMPACT  // HDF5 only
+} UHDF_StorageLayout;
+
+// Type tables are indexed by UHDF_DataType, so every lookup is an array access; they must
+// list the types in the order of the enum.
+static const std::string UHDFTypeNames[] = {
+    "UINT8",
+    "INT8",
+    "UINT16",
+    "INT16",
+    "UINT32",
+    "INT32",
+    "UINT64",
+    "INT64",
+    "FLOAT32",
+    "FLOAT64",
+    "STRING",
+    "REFERENCE",
+    "UNKNOWN"
 };
 
 static inline const std::string& UHDFTypeName( const UHDF_DataType &t)
 {
-    const auto &iter = UHDFNameMap.find(t);
-    if (iter == UHDFNameMap.end())
+    if (t < UHDF_UINT8 || t > UHDF_UNKNOWN)
         throw UHDF_Exception("Couldn't get UHDF type name");
-    return iter->second;
-}
-
-static const std::map<UHDF_DataType, int> UHDFToHDF4Map = {
-    {UHDF_UINT8,    DFNT_UINT8},
-    {UHDF_INT8,     DFNT_INT8},
-    {UHDF_UINT16,   DFNT_UINT16},
-    {UHDF_INT16,    DFNT_INT16},
-    {UHDF_UINT32,   DFNT_UINT32},
-    {UHDF_INT32,    DFNT_INT32},
-    {UHDF_UINT64,   DFNT_UINT64},
-    {UHDF_INT64,    DFNT_INT64},
-    {UHDF_FLOAT32,  DFNT_FLOAT32},
-    {UHDF_FLOAT64,  DFNT_FLOAT64},
-    {UHDF_STRING,   DFNT_CHAR}
-};
+    return UHDFTypeNames[t];
+}
 
-static const std::map<int, UHDF_DataType> HDF4ToUHDFMap = {
-    {DFNT_CHAR,    UHDF_STRING},
-    {DFNT_UCHAR,   UHDF_UINT8},
-    {DFNT_UINT8,   UHDF_UINT8},
-    {DFNT_INT8,    UHDF_INT8},
-    {DFNT_UINT16,  UHDF_UINT16},
-    {DFNT_INT16,   UHDF_INT16},
-    {DFNT_UINT32,  UHDF_UINT32},
-    {DFNT_INT32,   UHDF_INT32},
-    {DFNT_UINT64,  UHDF_UINT64},
-    {DFNT_INT64,   UHDF_INT64},
-    {DFNT_FLOAT32, UHDF_FLOAT32},
-    {DFNT_FLOAT64, UHDF_FLOAT64}
-};
+static inline size_t UHDFTypeSize( const UHDF_DataType &t)
+{
+    switch(t)
+    {
+    case UHDF_UINT8:
+    case UHDF_INT8:
+    case UHDF_STRING:
+        return 1;
+    case UHDF_UINT16:
+    case UHDF_INT16:
+        return 2;
+    case UHDF_UINT32:
+    case UHDF_INT32:
+    case UHDF_FLOAT32:
+        return 4;
+    case UHDF_UINT64:
+    case UHDF_INT64:
+    case UHDF_FLOAT64:
+        return 8;
+    default:
+        throw UHDF_Exception("Couldn't get size of UHDF type " + UHDFTypeName(t));
+    }
+}
 
-static const std::map<UHDF_DataType, hid_t> UHDFToHDF5Map = {
-    {UHDF_UINT8,    H5T_NATIVE_UINT8},
-    {UHDF_INT8,     H5T_NATIVE_INT8},
-    {UHDF_UINT16,   H5T_NATIVE_UINT16},
-    {UHDF_INT16,    H5T_NATIVE_INT16},
-    {UHDF_UINT32,   H5T_NATIVE_UINT32},
-    {UHDF_INT32,    H5T_NATIVE_INT32},
-    {UHDF_UINT64,   H5T_NATIVE_UINT64},
-    {UHDF_INT64,    H5T_NATIVE_INT64},
-    {UHDF_FLOAT32,  H5T_NATIVE_FLOAT},
-    {UHDF_FLOAT64,  H5T_NATIVE_DOUBLE},
-    {UHDF_STRING,   H5T_C_S1}
+// HDF4 number type of each UHDF type up to UHDF_STRING, the last one HDF4 has
+static constexpr int32 UHDFToHDF4Table[] = {
+    DFNT_UINT8,
+    DFNT_INT8,
+    DFNT_UINT16,
+    DFNT_INT16,
+    DFNT_UINT32,
+    DFNT_INT32,
+    DFNT_UINT64,
+    DFNT_INT64,
+    DFNT_FLOAT32,
+    DFNT_FLOAT64,
+    DFNT_CHAR
 };
 
-static inline int UHDFTypeToH4( const UHDF_DataType &t)
+static constexpr int32 UHDFTypeToH4( const UHDF_DataType t)
 {
-    const auto &iter = UHDFToHDF4Map.find(t);
-    if (iter == UHDFToHDF4Map.end())
-        throw UHDF_Exception("Couldn't convert UHDF type to HDF4");
-    return iter->second;
+    return (t >= UHDF_UINT8 && t <= UHDF_STRING) ? UHDFToHDF4Table[t] :
+           throw UHDF_Exception("Couldn't convert UHDF type to HDF4");
+}
+
+// UHDF_UNKNOWN for HDF4 number types with no UHDF equivalent
+static inline UHDF_DataType UHDF_lookupH4Type( const int32 t)
+{
+    switch(t)
+    {
+    case DFNT_CHAR:
+        return UHDF_STRING;
+    case DFNT_UCHAR:
+    case DFNT_UINT8:
+        return UHDF_UINT8;
+    case DFNT_INT8:
+        return UHDF_INT8;
+    case DFNT_UINT16:
+        return UHDF_UINT16;
+    case DFNT_INT16:
+        return UHDF_INT16;
+    case DFNT_UINT32:
+        return UHDF_UINT32;
+    case DFNT_INT32:
+        return UHDF_INT32;
+    case DFNT_UINT64:
+        return UHDF_UINT64;
+    case DFNT_INT64:
+        return UHDF_INT64;
+    case DFNT_FLOAT32:
+        return UHDF_FLOAT32;
+    case DFNT_FLOAT64:
+        return UHDF_FLOAT64;
+    default:
+        return UHDF_UNKNOWN;
+    }
 }
 
 static inline UHDF_DataType H4TypeToUHDF( const int &t)
 {
-    const auto &iter = HDF4ToUHDFMap.find(t);
-    if (iter == HDF4ToUHDFMap.end())
+    const UHDF_DataType type = UHDF_lookupH4Type(t);
+    if (type == UHDF_UNKNOWN)
         throw UHDF_Exception("Couldn't convert HDF4 type to UHDF");
-    return iter->second;
+    return type;
 }
 
+// the H5T_NATIVE types are library handles set up when HDF5 starts, so they can't be in a
+// constant table
 static inline hid_t UHDFTypeToH5( const UHDF_DataType &t)
 {
-    const auto &iter = UHDFToHDF5Map.find(t);
-    if (iter == UHDFToHDF5Map.end())
-        throw UHDF_Exception("Couldn't convert UHDF type to HDF4");
-    return iter->second;
+    switch(t)
+    {
+    case UHDF_UINT8:
+        return H5T_NATIVE_UINT8;
+    case UHDF_INT8:
+        return H5T_NATIVE_INT8;
+    case UHDF_UINT16:
+        return H5T_NATIVE_UINT16;
+    case UHDF_INT16:
+        return H5T_NATIVE_INT16;
+    case UHDF_UINT32:
+        return H5T_NATIVE_UINT32;
+    case UHDF_INT32:
+        return H5T_NATIVE_INT32;
+    case UHDF_UINT64:
+        return H5T_NATIVE_UINT64;
+    case UHDF_INT64:
+        return H5T_NATIVE_INT64;
+    case UHDF_FLOAT32:
+        return H5T_NATIVE_FLOAT;
+    case UHDF_FLOAT64:
+        return H5T_NATIVE_DOUBLE;
+    case UHDF_STRING:
+        return H5T_C_S1;
+    default:
+        throw UHDF_Exception("Couldn't convert UHDF type to HDF5");
+    }
 }
 
 //--------------------------------
 
+// UHDF_TypeOf<T>::value is the UHDF type of T at compile time; only numeric types have one
+template<typename T>
+struct UHDF_TypeOf;
+
+template<> struct UHDF_TypeOf<uint8_t> : std::integral_constant<UHDF_DataType, UHDF_UINT8> {};
+template<> struct UHDF_TypeOf<int8_t> : std::integral_constant<UHDF_DataType, UHDF_INT8> {};
+template<> struct UHDF_TypeOf<uint16_t> : std::integral_constant<UHDF_DataType, UHDF_UINT16> {};
+template<> struct UHDF_TypeOf<int16_t> : std::integral_constant<UHDF_DataType, UHDF_INT16> {};
+template<> struct UHDF_TypeOf<uint32_t> : std::integral_constant<UHDF_DataType, UHDF_UINT32> {};
+template<> struct UHDF_TypeOf<int32_t> : std::integral_constant<UHDF_DataType, UHDF_INT32> {};
+template<> struct UHDF_TypeOf<uint64_t> : std::integral_constant<UHDF_DataType, UHDF_UINT64> {};
+template<> struct UHDF_TypeOf<int64_t> : std::integral_constant<UHDF_DataType, UHDF_INT64> {};
+template<> struct UHDF_TypeOf<float> : std::integral_constant<UHDF_DataType, UHDF_FLOAT32> {};
+template<> struct UHDF_TypeOf<double> : std::integral_constant<UHDF_DataType, UHDF_FLOAT64> {};
+
 template<typename T>
 static inline UHDF_DataType getUHDFType()
 {
@@ -388,27 +469,27 @@ static inline UHDF_DataType H5TypeToUHDF( const hid_t &t)
         {
         case 1:
             if (sign == H5T_SGN_NONE)
-                return UHDF_INT8;
-            else
                 return UHDF_UINT8;
+            else
+                return UHDF_INT8;
             break;
         case 2:
             if (sign == H5T_SGN_NONE)
-                return UHDF_INT16;
-            else
                 return UHDF_UINT16;
+            else
+                return UHDF_INT16;
             break;
         case 4:
             if (sign == H5T_SGN_NONE)
-                return UHDF_INT32;
-            else
                 return UHDF_UINT32;
+            else
+                return UHDF_INT32;
             break;
         case 8:
             if (sign == H5T_SGN_NONE)
-                return UHDF_INT64;
-            else
                 return UHDF_UINT64;
+            else
+                return UHDF_INT64;
             break;
         default:
             throw UHDF_Exception("Couldn't convert HDF5 type to UHDF");
@@ -0,0 +1,257 @@
+#ifndef UHDF_VIEW_H
+#define UHDF_VIEW_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include "UHDF_Types.h"
+
+// Non-owning view of a multi-dimensional array with a rank chosen at runtime.  Strides are
+// in elements and may be negative; by default the view is packed in row-major order, the
+// way reads fill a buffer.
+template<typename T>
+class UHDF_View
+{
+public:
+    UHDF_View() :
+        ptr (NULL)
+    {}
+
+    UHDF_View( T *data, const std::vector<size_t> &viewShape) :
+        ptr (data),
+        shape (viewShape),
+        strides (viewShape.size())
+    {
+        ptrdiff_t stride = 1;
+        for (size_t i = shape.size(); i-- > 0; )
+        {
+            strides[i] = stride;
+            stride *= shape[i];
+        }
+    }
+
+    UHDF_View( T *data, const std::vector<size_t> &viewShape, const std::vector<ptrdiff_t> &viewStrides) :
+        ptr (data),
+        shape (viewShape),
+        strides (viewStrides)
+    {
+        if (shape.size() != strides.size())
+            throw UHDF_Exception("View shape and strides have different ranks");
+    }
+
+    T *data() const
+    {
+        return ptr;
+    }
+
+    size_t getRank() const
+    {
+        return shape.size();
+    }
+
+    const std::vector<size_t> &getShape() const
+    {
+        return shape;
+    }
+
+    const std::vector<ptrdiff_t> &getStrides() const
+    {
+        return strides;
+    }
+
+    size_t getNumElements() const
+    {
+        size_t elems = 1;
+        for (auto n : shape)
+        {
+            elems *= n;
+        }
+        return elems;
+    }
+
+    // true if the elements are packed in row-major order, so data() can be used as a flat array
+    bool isContiguous() const
+    {
+        ptrdiff_t stride = 1;
+        for (size_t i = shape.size(); i-- > 0; )
+        {
+            if (shape[i] != 1 && strides[i] != stride)
+                return false;
+            stride *= shape[i];
+        }
+        return true;
+    }
+
+    // unchecked element access, one index per dimension
+    template<typename... INDICES>
+    T &operator()( INDICES... indices) const
+    {
+        // leading 0 keeps the array non-empty for rank-0 views
+        const ptrdiff_t index[] = {0, static_cast<ptrdiff_t>(indices)...};
+
+        ptrdiff_t offset = 0;
+        for (size_t i = 0; i < sizeof...(INDICES); i++)
+            offset += index[i + 1] * strides[i];
+
+        return ptr[offset];
+    }
+
+    // bounds-checked element access
+    T &at( const std::vector<size_t> &index) const
+    {
+        if (index.size() != shape.size())
+            throw UHDF_Exception("Wrong number of indices given for view");
+
+        ptrdiff_t offset = 0;
+        for (size_t i = 0; i < index.size(); i++)
+        {
+            if (index[i] >= shape[i])
+                throw UHDF_Exception("View index out of range");
+            offset += index[i] * strides[i];
+        }
+
+        return ptr[offset];
+    }
+
+    // view with one fewer dimension, fixing dimension dim at index
+    UHDF_View slice( const size_t dim, const size_t index) const
+    {
+        if (dim >= shape.size() || index >= shape[dim])
+            throw UHDF_Exception("View slice out of range");
+
+        std::vector<size_t> sliceShape(shape);
+        std::vector<ptrdiff_t> sliceStrides(strides);
+        sliceShape.erase(sliceShape.begin() + dim);
+        sliceStrides.erase(sliceStrides.begin() + dim);
+
+        return UHDF_View(ptr + index * strides[dim], sliceShape, sliceStrides);
+    }
+
+    // view of every step'th element in [begin, end) along dimension dim
+    UHDF_View subview( const size_t dim, const size_t begin, const size_t end, const size_t step = 1) const
+    {
+        if (dim >= shape.size() || begin > end || end > shape[dim] || step == 0)
+            throw UHDF_Exception("View range out of range");
+
+        std::vector<size_t> subShape(shape);
+        std::vector<ptrdiff_t> subStrides(strides);
+        subShape[dim] = (end - begin + step - 1) / step;
+        subStrides[dim] *= step;
+
+        return UHDF_View(ptr + begin * strides[dim], subShape, subStrides);
+    }
+
+private:
+    T *ptr;
+    std::vector<size_t> shape;
+    std::vector<ptrdiff_t> strides;
+};
+
+// Reusable output buffer for reads.  Storage is only reallocated when a read needs more
+// room than the buffer has, and is never zero-filled, so reading a series of granules into
+// the same buffer costs no allocation or initialization after the first.
+template<typename T>
+class UHDF_Buffer
+{
+public:
+    UHDF_Buffer() :
+        capacity (0),
+        length (0)
+    {}
+
+    explicit UHDF_Buffer( const size_t numElements) :
+        capacity (0),
+        length (0)
+    {
+        resize(numElements);
+    }
+
+    UHDF_Buffer( const UHDF_Buffer &) = delete;
+    UHDF_Buffer &operator=( const UHDF_Buffer &) = delete;
+
+    // contents are unspecified after growing
+    void resize( const size_t numElements)
+    {
+        if (numElements > capacity)
+        {
+            storage.reset(new T[numElements]);  // default-initialized: no zero-fill
+            capacity = numElements;
+        }
+        length = numElements;
+    }
+
+    void reserve( const size_t numElements)
+    {
+        if (numElements > capacity)
+        {
+            storage.reset(new T[numElements]);
+            capacity = numElements;
+        }
+    }
+
+    T *data()
+    {
+        return storage.get();
+    }
+
+    const T *data() const
+    {
+        return storage.get();
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    size_t getCapacity() const
+    {
+        return capacity;
+    }
+
+    T &operator[]( const size_t i)
+    {
+        return storage[i];
+    }
+
+    const T &operator[]( const size_t i) const
+    {
+        return storage[i];
+    }
+
+    T *begin()
+    {
+        return storage.get();
+    }
+
+    T *end()
+    {
+        return storage.get() + length;
+    }
+
+    const T *begin() const
+    {
+        return storage.get();
+    }
+
+    const T *end() const
+    {
+        return storage.get() + length;
+    }
+
+    UHDF_View<T> view( const std::vector<size_t> &shape)
+    {
+        UHDF_View<T> v(storage.get(), shape);
+        if (v.getNumElements() > length)
+            throw UHDF_Exception("View shape is larger than the buffer");
+        return v;
+    }
+
+private:
+    std::unique_ptr<T[]> storage;
+    size_t capacity;
+    size_t length;
+};
+
+#endif // UHDF_VIEW_H
@@ -0,0 +1,231 @@
+#ifndef UHDF_VISIT_H
+#define UHDF_VISIT_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <exception>
+
+#include "UHDF_Types.h"
+
+#include <boost/lexical_cast.hpp>
+
+typedef enum
+{
+    UHDF_OBJ_GROUP,
+    UHDF_OBJ_DATASET,
+    UHDF_OBJ_DATATYPE,  // named datatype, HDF5 only
+    UHDF_OBJ_LINK,      // external or dangling link that wasn't followed, HDF5 only
+    UHDF_OBJ_OTHER
+} UHDF_ObjectType;
+
+struct UHDF_ObjectInfo
+{
+    std::string name;  // name within the parent group
+    std::string path;  // full path within the file
+    UHDF_ObjectType type;
+    size_t numAttributes;
+};
+
+// return false to stop the traversal
+typedef std::function<bool(const UHDF_ObjectInfo &)> UHDF_Visitor;
+
+//--------------------------------
+// HDF5
+
+#if H5_VERSION_GE(1,12,0)
+typedef H5O_info2_t UHDF_H5ObjectInfo;
+#else
+typedef H5O_info_t UHDF_H5ObjectInfo;
+#endif
+
+static inline herr_t UHDF_getH5ObjectInfo( const hid_t locId, const char *name, UHDF_H5ObjectInfo *info)
+{
+#if H5_VERSION_GE(1,12,0)
+    return H5Oget_info_by_name3(locId, name, info, H5O_INFO_BASIC | H5O_INFO_NUM_ATTRS, H5P_DEFAULT);
+#elif H5_VERSION_GE(1,10,3)
+    return H5Oget_info_by_name2(locId, name, info, H5O_INFO_BASIC | H5O_INFO_NUM_ATTRS, H5P_DEFAULT);
+#else
+    return H5Oget_info_by_name(locId, name, info, H5P_DEFAULT);
+#endif
+}
+
+static inline UHDF_ObjectType UHDF_fromH5ObjectType( const H5O_type_t type)
+{
+    switch(type)
+    {
+    case H5O_TYPE_GROUP:
+        return UHDF_OBJ_GROUP;
+    case H5O_TYPE_DATASET:
+        return UHDF_OBJ_DATASET;
+    case H5O_TYPE_NAMED_DATATYPE:
+        return UHDF_OBJ_DATATYPE;
+    default:
+        return UHDF_OBJ_OTHER;
+    }
+}
+
+static inline std::string UHDF_joinPath( const std::string &parentPath, const std::string &name)
+{
+    return parentPath.empty() ? name : parentPath + "/" + name;
+}
+
+struct UHDF_H5ListContext
+{
+    std::string parentPath;
+    std::vector<UHDF_ObjectInfo> children;
+};
+
+static inline herr_t UHDF_h5ListCallback( hid_t groupId, const char *name, const H5L_info_t *linkInfo, void *opData)
+{
+    UHDF_H5ListContext *context = static_cast<UHDF_H5ListContext*>(opData);
+
+    UHDF_ObjectInfo child;
+    child.name = name;
+    child.path = UHDF_joinPath(context->parentPath, child.name);
+    child.type = UHDF_OBJ_LINK;
+    child.numAttributes = 0;
+
+    // external links would open other files, so they're reported without being followed
+    if (linkInfo->type != H5L_TYPE_EXTERNAL)
+    {
+        UHDF_H5ObjectInfo objInfo;
+        herr_t status;
+
+        H5E_BEGIN_TRY
+        {
+            status = UHDF_getH5ObjectInfo(groupId, name, &objInfo);
+        }
+        H5E_END_TRY;
+
+        if (status >= 0)
+        {
+            child.type = UHDF_fromH5ObjectType(objInfo.type);
+            child.numAttributes = objInfo.num_attrs;
+        }
+    }
+
+    context->children.push_back(child);
+    return 0;
+}
+
+// lists the members of a group in one pass over its links, in name order
+static inline std::vector<UHDF_ObjectInfo> UHDF_listH5Group( const hid_t groupId, const std::string &groupPath)
+{
+    UHDF_H5ListContext context;
+    context.parentPath = groupPath;
+
+    hsize_t position = 0;
+    if (H5Literate(groupId, H5_INDEX_NAME, H5_ITER_INC, &position, UHDF_h5ListCallback, &context) < 0)
+        throw UHDF_Exception("Error listing members of group '" + groupPath + "'");
+
+    return context.children;
+}
+
+struct UHDF_H5VisitContext
+{
+    std::string rootPath;
+    const UHDF_Visitor *visitor;
+    std::exception_ptr error;
+};
+
+static inline herr_t UHDF_h5VisitCallback( hid_t, const char *name, const UHDF_H5ObjectInfo *objInfo, void *opData)
+{
+    UHDF_H5VisitContext *context = static_cast<UHDF_H5VisitContext*>(opData);
+
+    // the starting group itself is visited as "."
+    if (name[0] == '.' && name[1] == 0)
+        return 0;
+
+    UHDF_ObjectInfo info;
+    info.path = UHDF_joinPath(context->rootPath, name);
+    info.name = info.path.substr(info.path.rfind('/') + 1);
+    info.type = UHDF_fromH5ObjectType(objInfo->type);
+    info.numAttributes = objInfo->num_attrs;
+
+    // exceptions can't pass through the library's C stack frames
+    try
+    {
+        return (*context->visitor)(info) ? 0 : 1;
+    }
+    catch (...)
+    {
+        context->error = std::current_exception();
+        return -1;
+    }
+}
+
+// visits every object below a group once, parents before children, in name order; objects
+// reachable by several paths are only visited by the first, and links that don't lead to an
+// object in the file are skipped
+static inline void UHDF_visitH5Group( const hid_t groupId, const std::string &groupPath, const UHDF_Visitor &visitor)
+{
+    UHDF_H5VisitContext context;
+    context.rootPath = groupPath;
+    context.visitor = &visitor;
+
+    herr_t status;
+
+    // an exception from the visitor makes the iteration fail; it's rethrown instead of printed
+    H5E_BEGIN_TRY
+    {
+#if H5_VERSION_GE(1,12,0)
+        status = H5Ovisit3(groupId, H5_INDEX_NAME, H5_ITER_INC, UHDF_h5VisitCallback, &context, H5O_INFO_BASIC | H5O_INFO_NUM_ATTRS);
+#elif H5_VERSION_GE(1,10,3)
+        status = H5Ovisit2(groupId, H5_INDEX_NAME, H5_ITER_INC, UHDF_h5VisitCallback, &context, H5O_INFO_BASIC | H5O_INFO_NUM_ATTRS);
+#else
+        status = H5Ovisit(groupId, H5_INDEX_NAME, H5_ITER_INC, UHDF_h5VisitCallback, &context);
+#endif
+    }
+    H5E_END_TRY;
+
+    if (context.error)
+        std::rethrow_exception(context.error);
+    if (status < 0)
+        throw UHDF_Exception("Error visiting members of group '" + groupPath + "'");
+}
+
+//--------------------------------
+// HDF4: the file is a flat list of scientific datasets
+
+static inline std::vector<UHDF_ObjectInfo> UHDF_listH4Datasets( const int32 fileId, const std::string &fileName)
+{
+    int32 numDatasets;
+    int32 numAttributes;
+
+    if (SDfileinfo( fileId, &numDatasets, &numAttributes) < 0)
+        throw UHDF_Exception("Error getting file info from " + fileName);
+
+    std::vector<UHDF_ObjectInfo> datasets;
+    datasets.reserve(numDatasets);
+
+    for (int32 i = 0; i < numDatasets; i++)
+    {
+        const int32 sdsid = SDselect( fileId, i);
+        if (sdsid < 0)
+            throw UHDF_Exception("Error opening dataset #" + boost::lexical_cast<std::string>(i) + " from file " + fileName);
+
+        char sdsName[MAX_NC_NAME + 1];
+        int32 sdsRank;
+        int32 sdsDimSizes[MAX_VAR_DIMS];
+        int32 sdsType;
+        int32 sdsNumAttrs;
+
+        const intn status = SDgetinfo( sdsid, sdsName, &sdsRank, sdsDimSizes, &sdsType, &sdsNumAttrs);
+        SDendaccess(sdsid);
+
+        if (status < 0)
+            throw UHDF_Exception("Error getting dataset info from dataset #" + boost::lexical_cast<std::string>(i) + " from file " + fileName);
+
+        UHDF_ObjectInfo info;
+        info.name = sdsName;
+        info.path = info.name;
+        info.type = UHDF_OBJ_DATASET;
+        info.numAttributes = sdsNumAttrs;
+        datasets.push_back(info);
+    }
+
+    return datasets;
+}
+
+#endif // UHDF_VISIT_H
@@ -0,0 +1,491 @@
+#include "UHDF.h"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstdlib>
+using namespace std;
+
+// Benchmarks of the main read paths over synthetic HDF4 and HDF5 files, covering a matrix
+// of types, ranks, chunk shapes and compression settings.  Results go to stdout as CSV,
+// one line per benchmark, so runs before and after a change can be diffed or plotted:
+//
+//     format,file_or_dataset,type,rank,layout,benchmark,calls,bytes,median_s,min_s,latency_us,mb_per_s
+//
+// Times are the median and minimum over the repeats, of all the calls a benchmark makes;
+// latency is the median time per call.  Files are read once before timing, so the
+// numbers are for warm caches.
+//
+// usage: UnifiedHDFBench.exe [-d directory] [-n elements] [-r repeats] [-f h4|h5|both] [-k]
+//     -d  where the files are written (default bench_data, which must exist)
+//     -n  elements per dataset (default 1048576)
+//     -r  times each benchmark is repeated (default 5)
+//     -f  which formats to run
+//     -k  keep files from an earlier run with the same settings instead of writing them again
+
+struct BenchSettings
+{
+    BenchSettings() :
+        directory ("bench_data"),
+        numElements (1024 * 1024),
+        repeats (5),
+        hdf4 (true),
+        hdf5 (true),
+        keepFiles (false)
+    {}
+
+    string directory;
+    size_t numElements;
+    int repeats;
+    bool hdf4;
+    bool hdf5;
+    bool keepFiles;
+};
+
+struct BenchDataset
+{
+    string name;
+    UHDF_DataType type;
+    vector<size_t> dims;
+    string layout;
+    UHDF_DatasetOptions options;
+};
+
+static const UHDF_DataType benchTypes[] = {UHDF_UINT8, UHDF_INT16, UHDF_FLOAT32, UHDF_FLOAT64};
+static const char *const benchLayouts[] = {"contiguous", "chunked", "deflate", "shuffle"};
+static const size_t numFileAttributes = 32;
+
+vector<size_t> benchShape(const size_t numElements, const int rank)
+{
+    switch (rank)
+    {
+    case 1:
+        return {numElements};
+    case 2:
+    {
+        const size_t rows = max<size_t>(1, sqrt(static_cast<double>(numElements)));
+        return {rows, max<size_t>(1, numElements / rows)};
+    }
+    default:
+    {
+        const size_t planes = 16;
+        const size_t rows = max<size_t>(1, sqrt(static_cast<double>(numElements / planes)));
+        return {planes, rows, max<size_t>(1, numElements / planes / rows)};
+    }
+    }
+}
+
+vector<size_t> benchChunkShape(const vector<size_t> &dims)
+{
+    switch (dims.size())
+    {
+    case 1:
+        return {min<size_t>(dims[0], 65536)};
+    case 2:
+        return {min<size_t>(dims[0], 256), min<size_t>(dims[1], 256)};
+    default:
+        return {1, min<size_t>(dims[1], 128), min<size_t>(dims[2], 128)};
+    }
+}
+
+// every combination of type, rank and layout the format supports
+vector<BenchDataset> benchMatrix(const UHDF_FileType format, const size_t numElements)
+{
+    vector<BenchDataset> datasets;
+
+    for (const UHDF_DataType type : benchTypes)
+    {
+        for (int rank = 1; rank <= 3; rank++)
+        {
+            for (const string layout : benchLayouts)
+            {
+                // HDF4 has no shuffle filter
+                if (format == UHDF_HDF4 && layout == "shuffle")
+                    continue;
+
+                BenchDataset dataset;
+                dataset.type = type;
+                dataset.dims = benchShape(numElements, rank);
+                dataset.layout = layout;
+                dataset.name = UHDFTypeName(type) + "_r" + to_string(rank) + "_" + layout;
+
+                if (layout != "contiguous")
+                    dataset.options.chunkDimensions = benchChunkShape(dataset.dims);
+                if (layout == "deflate" || layout == "shuffle")
+                    dataset.options.deflateLevel = 4;
+                dataset.options.shuffle = (layout == "shuffle");
+
+                datasets.push_back(dataset);
+            }
+        }
+    }
+
+    return datasets;
+}
+
+// smooth with a little noise, like most geophysical fields, so compression does about
+// as well as it would on real data
+vector<double> benchValues(const size_t numElements)
+{
+    vector<double> values(numElements);
+    uint32_t noise = 12345;
+
+    for (size_t i = 0; i < numElements; i++)
+    {
+        noise = noise * 1103515245 + 12345;
+        values[i] = 100.0 + 90.0 * sin(i * 0.0005) + (noise >> 28);
+    }
+
+    return values;
+}
+
+string benchFileName(const BenchSettings &settings, const UHDF_FileType format)
+{
+    return settings.directory + "/bench_" + to_string(settings.numElements) + ((format == UHDF_HDF4) ? ".hdf" : ".h5");
+}
+
+void writeBenchFile(const string &fileName, const UHDF_FileType format, const vector<BenchDataset> &datasets, const vector<double> &values)
+{
+    UHDF_File file(fileName, UHDF_CREATE, format);
+
+    vector<double> attributeValues(16);
+    for (size_t i = 0; i < attributeValues.size(); i++)
+        attributeValues[i] = i * 0.5;
+
+    for (size_t a = 0; a < numFileAttributes; a++)
+        file.createAttribute("attribute_" + to_string(a), attributeValues.data(), attributeValues.size());
+    file.createAttribute("title", string("UnifiedHDF benchmark data"));
+
+    const double validRange[2] = {0, 255};
+    const double scaleFactor = 1.0;
+
+    for (const auto &bench : datasets)
+    {
+        UHDF_Dataset dataset = file.createDataset(bench.name, bench.type, bench.dims, bench.options);
+        dataset.writeAll(values.data());
+
+        dataset.createAttribute("units", string("K"));
+        dataset.createAttribute("valid_range", validRange, 2);
+        dataset.createAttribute("scale_factor", &scaleFactor, 1);
+    }
+}
+
+struct BenchTiming
+{
+    double median;
+    double minimum;
+};
+
+// runs fn once untimed, then repeats times; setup runs, untimed, before every run of fn
+template <typename SETUP, typename FUNC>
+BenchTiming timeRepeated(const int repeats, SETUP setup, FUNC fn)
+{
+    setup();
+    fn();
+
+    vector<double> seconds;
+    for (int r = 0; r < repeats; r++)
+    {
+        setup();
+        const auto begin = chrono::steady_clock::now();
+        fn();
+        seconds.push_back(chrono::duration<double>(chrono::steady_clock::now() - begin).count());
+    }
+
+    sort(seconds.begin(), seconds.end());
+
+    BenchTiming timing;
+    timing.median = seconds[seconds.size() / 2];
+    timing.minimum = seconds.front();
+    return timing;
+}
+
+template <typename FUNC>
+BenchTiming timeRepeated(const int repeats, FUNC fn)
+{
+    return timeRepeated(repeats, []() {}, fn);
+}
+
+void printHeader()
+{
+    cout << "format,file_or_dataset,type,rank,layout,benchmark,calls,bytes,median_s,min_s,latency_us,mb_per_s" << endl;
+}
+
+void printResult(const UHDF_FileType format, const string &name, const string &type, const int rank, const string &layout,
+                 const string &benchmark, const size_t calls, const size_t bytes, const BenchTiming &timing)
+{
+    cout << ((format == UHDF_HDF4) ? "hdf4" : "hdf5") << "," << name << "," << type << "," << rank << "," << layout << ","
+         << benchmark << "," << calls << "," << bytes << "," << timing.median << "," << timing.minimum << ","
+         << timing.median / max<size_t>(calls, 1) * 1e6 << "," << ((timing.median > 0) ? bytes / timing.median / 1e6 : 0) << endl;
+}
+
+// deterministic positions, so every run reads the same places
+size_t benchPosition(uint32_t &state, const size_t range)
+{
+    state = state * 1664525 + 1013904223;
+    return (range == 0) ? 0 : (state >> 8) % range;
+}
+
+// reads of one dataset, in its own type T
+template <typename T>
+void benchDataset(const UHDF_FileType format, const UHDF_File &file, const BenchDataset &bench, const int repeats)
+{
+    // Every run gets a newly opened dataset.  Otherwise chunks decoded by one run would
+    // still be in the chunk cache for the next, and compressed datasets small enough to fit
+    // would time cache hits instead of decompression.  The old handle is closed first, since
+    // HDF5 keeps the cache as long as any handle on the dataset is open.
+    unique_ptr<UHDF_Dataset> dataset;
+    auto reopen = [&]()
+    {
+        dataset.reset();
+        dataset.reset(new UHDF_Dataset(file.openDataset(bench.name, UHDF_ChunkCache())));
+    };
+    reopen();
+
+    const int rank = bench.dims.size();
+    const size_t totalBytes = dataset->getNumElements() * sizeof(T);
+    const string type = UHDFTypeName(bench.type);
+
+    auto report = [&](const string &benchmark, const size_t calls, const size_t bytes, const BenchTiming &timing)
+    {
+        printResult(format, bench.name, type, rank, bench.layout, benchmark, calls, bytes, timing);
+    };
+
+    report("read_all", 1, totalBytes, timeRepeated(repeats, reopen, [&]()
+    {
+        vector<T> values = dataset->readAll<T>();
+    }));
+
+    report("read_converted", 1, totalBytes, timeRepeated(repeats, reopen, [&]()
+    {
+        vector<double> values = dataset->readAll<double>();
+    }));
+
+    report("read_parallel", 1, totalBytes, timeRepeated(repeats, reopen, [&]()
+    {
+        vector<T> values = dataset->readAllParallel<T>();
+    }));
+
+    // every fourth element along every dimension
+    {
+        vector<int32> start(rank, 0);
+        vector<int32> stride(rank, 4);
+        vector<int32> count(rank);
+        size_t elems = 1;
+        for (int i = 0; i < rank; i++)
+        {
+            count[i] = (bench.dims[i] + 3) / 4;
+            elems *= count[i];
+        }
+
+        vector<T> buffer(elems);
+        report("strided", 1, elems * sizeof(T), timeRepeated(repeats, reopen, [&]()
+        {
+            dataset->read(start.data(), stride.data(), count.data(), buffer.data());
+        }));
+    }
+
+    // slabs of 1/64 of the slowest dimension, at scattered positions
+    {
+        const size_t numReads = 16;
+        vector<int32> start(rank, 0);
+        vector<int32> count(bench.dims.begin(), bench.dims.end());
+        count[0] = max<size_t>(1, bench.dims[0] / 64);
+
+        size_t elems = 1;
+        for (int i = 0; i < rank; i++)
+            elems *= count[i];
+
+        vector<T> buffer(elems);
+        report("hyperslab", numReads, numReads * elems * sizeof(T), timeRepeated(repeats, reopen, [&]()
+        {
+            uint32_t state = 1;
+            for (size_t r = 0; r < numReads; r++)
+            {
+                start[0] = benchPosition(state, bench.dims[0] - count[0] + 1);
+                dataset->read(start.data(), count.data(), buffer.data());
+            }
+        }));
+    }
+
+    // small windows, 16 along each of the two fastest dimensions, for per-call latency
+    {
+        const size_t numReads = 256;
+        vector<int32> start(rank, 0);
+        vector<int32> count(rank, 1);
+        for (int i = max(0, rank - 2); i < rank; i++)
+            count[i] = min<size_t>(16, bench.dims[i]);
+
+        size_t elems = 1;
+        for (int i = 0; i < rank; i++)
+            elems *= count[i];
+
+        vector<T> buffer(elems);
+        report("window", numReads, numReads * elems * sizeof(T), timeRepeated(repeats, reopen, [&]()
+        {
+            uint32_t state = 7;
+            for (size_t r = 0; r < numReads; r++)
+            {
+                for (int i = 0; i < rank; i++)
+                    start[i] = benchPosition(state, bench.dims[i] - count[i] + 1);
+                dataset->read(start.data(), count.data(), buffer.data());
+            }
+        }));
+    }
+}
+
+void benchDataset(const UHDF_FileType format, const UHDF_File &file, const BenchDataset &bench, const int repeats)
+{
+    switch (bench.type)
+    {
+    case UHDF_UINT8:
+        benchDataset<uint8_t>(format, file, bench, repeats);
+        break;
+    case UHDF_INT16:
+        benchDataset<int16_t>(format, file, bench, repeats);
+        break;
+    case UHDF_FLOAT32:
+        benchDataset<float>(format, file, bench, repeats);
+        break;
+    case UHDF_FLOAT64:
+        benchDataset<double>(format, file, bench, repeats);
+        break;
+    default:
+        throw UHDF_Exception("No benchmark for type " + UHDFTypeName(bench.type));
+    }
+}
+
+// opening, listing and attribute reads, each on a freshly opened file so nothing is cached
+void benchMetadata(const UHDF_FileType format, const string &fileName, const vector<BenchDataset> &datasets, const int repeats)
+{
+    auto report = [&](const string &benchmark, const size_t calls, const BenchTiming &timing)
+    {
+        printResult(format, fileName, "", 0, "", benchmark, calls, 0, timing);
+    };
+
+    report("open_file", 1, timeRepeated(repeats, [&]()
+    {
+        UHDF_File file(fileName);
+    }));
+
+    report("list_objects", 1, timeRepeated(repeats, [&]()
+    {
+        UHDF_File file(fileName);
+        size_t numObjects = 0;
+        file.visit([&numObjects](const UHDF_ObjectInfo &)
+        {
+            numObjects++;
+            return true;
+        });
+    }));
+
+    report("open_datasets", datasets.size(), timeRepeated(repeats, [&]()
+    {
+        UHDF_File file(fileName);
+        for (const auto &bench : datasets)
+            file.openDataset(bench.name);
+    }));
+
+    report("file_attributes", 1, timeRepeated(repeats, [&]()
+    {
+        UHDF_File file(fileName);
+        file.readAllAttributes();
+    }));
+
+    report("dataset_attributes", datasets.size(), timeRepeated(repeats, [&]()
+    {
+        UHDF_File file(fileName);
+        for (const auto &bench : datasets)
+            file.openDataset(bench.name).readAllAttributes();
+    }));
+}
+
+void runFormat(const UHDF_FileType format, const BenchSettings &settings)
+{
+    const vector<BenchDataset> datasets = benchMatrix(format, settings.numElements);
+    const string fileName = benchFileName(settings, format);
+
+    if (!settings.keepFiles || !ifstream(fileName).good())
+    {
+        cerr << "writing " << fileName << endl;
+        writeBenchFile(fileName, format, datasets, benchValues(settings.numElements));
+    }
+
+    benchMetadata(format, fileName, datasets, settings.repeats);
+
+    UHDF_File file(fileName);
+    for (const auto &bench : datasets)
+    {
+        cerr << "reading " << bench.name << endl;
+        benchDataset(format, file, bench, settings.repeats);
+    }
+}
+
+bool parseArguments(int argc, char *argv[], BenchSettings &settings)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        const bool hasValue = (i + 1 < argc);
+
+        if (arg == "-k")
+        {
+            settings.keepFiles = true;
+        }
+        else if (arg == "-d" && hasValue)
+        {
+            settings.directory = argv[++i];
+        }
+        else if (arg == "-n" && hasValue)
+        {
+            settings.numElements = strtoul(argv[++i], NULL, 10);
+        }
+        else if (arg == "-r" && hasValue)
+        {
+            settings.repeats = atoi(argv[++i]);
+        }
+        else if (arg == "-f" && hasValue)
+        {
+            const string formats = argv[++i];
+            settings.hdf4 = (formats == "h4" || formats == "both");
+            settings.hdf5 = (formats == "h5" || formats == "both");
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return settings.numElements > 0 && settings.repeats > 0 && (settings.hdf4 || settings.hdf5);
+}
+
+int main (int argc, char *argv[])
+{
+    BenchSettings settings;
+    if (!parseArguments(argc, argv, settings))
+    {
+        cerr << "usage: " << argv[0] << " [-d directory] [-n elements] [-r repeats] [-f h4|h5|both] [-k]" << endl;
+        return 1;
+    }
+
+    try
+    {
+        printHeader();
+
+        if (settings.hdf4)
+            runFormat(UHDF_HDF4, settings);
+        if (settings.hdf5)
+            runFormat(UHDF_HDF5, settings);
+    }
+    catch (UHDF_Exception &e)
+    {
+        cerr << "ERROR (" << e.what() << ")" << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,338 @@
+#include "UHDF.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <limits>
+#include <cmath>
+#include <fcntl.h>
+#include <sys/stat.h>
+using namespace std;
+
+// Self-checks, run by "make check".  Each prints whether it passed, and the exit status is
+// the number that failed.  Files are written to the current directory.
+
+static int failures = 0;
+
+static void check( const string &name, const bool passed)
+{
+    cout << (passed ? "ok      " : "FAILED  ") << name << endl;
+    if (!passed)
+        failures++;
+}
+
+// a float64 dataset compressed in chunks, with value i at element i
+static UHDF_Dataset createDeflated( UHDF_File &file, const string &name, const vector<size_t> &dims, const vector<size_t> &chunks)
+{
+    UHDF_DatasetOptions options;
+    options.chunkDimensions = chunks;
+    options.deflateLevel = 1;
+    UHDF_Dataset dataset = file.createDataset(name, UHDF_FLOAT64, dims, options);
+
+    vector<double> values(dataset.getNumElements());
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = i;
+    dataset.writeAll(values.data());
+    return dataset;
+}
+
+// a read that converts to a narrower type reads each chunk once, not once per block
+static void checkConvertedReadFollowsChunks()
+{
+    UHDF_File file("check_convert.h5", UHDF_CREATE);
+    const UHDF_Dataset dataset = createDeflated(file, "data", {400, 400}, {200, 200});
+
+    dataset.resetIOStatistics();
+    const vector<float> all = dataset.readAll<float>();
+    bool equal = true;
+    for (size_t i = 0; i < all.size(); i++)
+        equal = equal && all[i] == static_cast<float>(i);
+    check("converted read of a chunked dataset is correct", equal);
+    check("converted read of a chunked dataset reads no more than once per chunk", dataset.getIOStatistics().readCalls <= 4);
+
+    // strided, and not lined up with the chunks
+    const int32 start[2] = {3, 5};
+    const int32 stride[2] = {3, 2};
+    const int32 count[2] = {130, 190};
+    vector<float> strided(130 * 190);
+    dataset.read(start, stride, count, strided.data());
+    equal = true;
+    for (int32 r = 0; r < count[0]; r++)
+    {
+        for (int32 c = 0; c < count[1]; c++)
+            equal = equal && strided[r * count[1] + c] == static_cast<float>((start[0] + r * stride[0]) * 400 + start[1] + c * stride[1]);
+    }
+    check("strided converted read of a chunked dataset is correct", equal);
+}
+
+// a write that converts types writes, and compresses, each chunk once
+static void checkConvertedWriteFollowsChunks()
+{
+    UHDF_File file("check_convert_write.h5", UHDF_CREATE);
+    const UHDF_Dataset dataset = createDeflated(file, "data", {400, 400}, {200, 200});
+
+    vector<float> values(dataset.getNumElements());
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = 2.0f * i;
+
+    dataset.resetIOStatistics();
+    dataset.writeAll(values.data());
+    check("converted write of a chunked dataset writes no more than once per chunk", dataset.getIOStatistics().writeCalls <= 4);
+
+    const vector<double> back = dataset.readAll<double>();
+    bool equal = true;
+    for (size_t i = 0; i < back.size(); i++)
+        equal = equal && back[i] == values[i];
+    check("converted write of a chunked dataset is correct", equal);
+}
+
+// a partly written chunk is flushed in as few writes as cover what was given
+static void checkPartialChunkFlush()
+{
+    UHDF_File file("check_chunk_writer.h5", UHDF_CREATE);
+    UHDF_DatasetOptions options;
+    options.chunkDimensions = {1000, 1000};
+    options.deflateLevel = 1;
+    const UHDF_Dataset dataset = file.createDataset("data", UHDF_FLOAT64, {1200, 1000}, options);
+
+    vector<double> expected(dataset.getNumElements(), 0);
+    {
+        UHDF_ChunkWriter<double> writer(dataset);
+
+        // 600 whole rows, one at a time
+        vector<double> row(1000);
+        for (int32 r = 0; r < 600; r++)
+        {
+            for (size_t c = 0; c < row.size(); c++)
+                row[c] = expected[r * 1000 + c] = r * 1000 + c + 1;
+
+            const int32 start[2] = {r, 0};
+            const int32 count[2] = {1, 1000};
+            writer.write(start, count, row.data());
+        }
+
+        dataset.resetIOStatistics();
+        writer.flush();
+        check("flushing whole rows of a partly written chunk takes one write", dataset.getIOStatistics().writeCalls == 1);
+
+        // a ragged piece: 10 rows of 30, then 5 rows of 20 starting further left
+        vector<double> piece(300);
+        for (size_t i = 0; i < piece.size(); i++)
+            piece[i] = -1.0 - i;
+        const int32 start1[2] = {700, 100};
+        const int32 count1[2] = {10, 30};
+        writer.write(start1, count1, piece.data());
+        const int32 start2[2] = {710, 90};
+        const int32 count2[2] = {5, 20};
+        writer.write(start2, count2, piece.data());
+
+        for (int32 r = 0; r < 10; r++)
+        {
+            for (int32 c = 0; c < 30; c++)
+                expected[(700 + r) * 1000 + 100 + c] = piece[r * 30 + c];
+        }
+        for (int32 r = 0; r < 5; r++)
+        {
+            for (int32 c = 0; c < 20; c++)
+                expected[(710 + r) * 1000 + 90 + c] = piece[r * 20 + c];
+        }
+
+        dataset.resetIOStatistics();
+        writer.flush();
+        check("flushing a ragged piece of a chunk writes one box per shape", dataset.getIOStatistics().writeCalls == 2);
+    }
+
+    check("partly written chunks read back as written", dataset.readAll<double>() == expected);
+}
+
+// the fill value asked for is what unwritten parts of a chunked HDF4 dataset read as
+static void checkChunkedH4FillValue()
+{
+    {
+        UHDF_File file("check_fill.hdf", UHDF_CREATE, UHDF_HDF4);
+        UHDF_DatasetOptions options;
+        options.chunkDimensions = {5, 5};
+        options.hasFillValue = true;
+        options.fillValue = -7;
+        const UHDF_Dataset dataset = file.createDataset("data", UHDF_INT16, {10, 10}, options);
+
+        // one corner only, so one chunk is partly written and three aren't at all
+        const vector<int16_t> corner(3 * 3, 1);
+        const int32 start[2] = {0, 0};
+        const int32 count[2] = {3, 3};
+        dataset.write(start, count, corner.data());
+    }
+
+    const UHDF_File file("check_fill.hdf");
+    const vector<int16_t> values = file.openDataset("data").readAll<int16_t>();
+    bool filled = true;
+    for (size_t r = 0; r < 10; r++)
+    {
+        for (size_t c = 0; c < 10; c++)
+            filled = filled && values[r * 10 + c] == ((r < 3 && c < 3) ? 1 : -7);
+    }
+    check("unwritten parts of a chunked HDF4 dataset read as its fill value", filled);
+}
+
+// parallel reads of compressed HDF5 chunks decode them outside the library
+static void checkParallelReadDecodesOutsideLibrary()
+{
+    UHDF_File file("check_parallel.h5", UHDF_CREATE);
+    const UHDF_Dataset dataset = createDeflated(file, "data", {300, 500}, {64, 128});
+
+    dataset.resetIOStatistics();
+    const vector<float> all = dataset.readAllParallel<float>(4);
+    bool equal = true;
+    for (size_t i = 0; i < all.size(); i++)
+        equal = equal && all[i] == static_cast<float>(i);
+    check("parallel read of a compressed dataset is correct", equal);
+    check("parallel read of a compressed dataset fetches chunks still compressed", dataset.getIOStatistics().bytesFetched > 0);
+
+    const int32 start[2] = {250, 0};
+    const int32 stride[2] = {1, 1};
+    const int32 count[2] = {100, 10};
+    vector<float> outside(100 * 10);
+    bool threw = false;
+    try
+    {
+        dataset.readParallel(start, stride, count, outside.data(), 4);
+    }
+    catch (const UHDF_Exception &)
+    {
+        threw = true;
+    }
+    check("parallel read past the end of a compressed dataset fails", threw);
+}
+
+// the vector passes keep the scalar loop's lanes, so only the variance may differ, and
+// then only by rounding
+static bool sameStatistics( const UHDF_Statistics &a, const UHDF_Statistics &b)
+{
+    return a.getCount() == b.getCount() && a.getSum() == b.getSum() &&
+           a.getMin() == b.getMin() && a.getMax() == b.getMax() && a.getMean() == b.getMean() &&
+           fabs(a.getVariance() - b.getVariance()) <= 1e-12 * fabs(b.getVariance());
+}
+
+template<typename T>
+static void checkStatisticsMatchScalar( const string &type)
+{
+    // NaN first and scattered, over two blocks and a tail that isn't a whole number of lanes
+    vector<T> values(2 * UHDF_REDUCE_BLOCK + UHDF_REDUCE_LANES + 3);
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = (i % 7 == 0) ? numeric_limits<T>::quiet_NaN() : static_cast<T>((i * 7919 % 1000) / 10.0 - 50);
+    values.back() = numeric_limits<T>::quiet_NaN();
+
+    UHDF_Statistics scalar;
+    scalar.add<T, UHDF_ScalarReduce<T> >(values.data(), values.size());
+
+    UHDF_Statistics simd;
+    simd.add(values.data(), values.size());
+    check(type + " statistics match the scalar loop", sameStatistics(simd, scalar));
+
+#ifdef UHDF_HAVE_X86_SIMD
+    UHDF_Statistics sse2;
+    sse2.add<T, UHDF_SimdReduceSSE2<T> >(values.data(), values.size());
+    check(type + " statistics from SSE2 match the scalar loop", sameStatistics(sse2, scalar));
+#endif
+
+    // fewer values than lanes go through the scalar loop alone
+    UHDF_Statistics shortScalar, shortSimd;
+    shortScalar.add<T, UHDF_ScalarReduce<T> >(values.data() + 1, UHDF_REDUCE_LANES - 1);
+    shortSimd.add(values.data() + 1, UHDF_REDUCE_LANES - 1);
+    check(type + " statistics of a short run match the scalar loop", sameStatistics(shortSimd, shortScalar));
+}
+
+static void checkReduceMatchesScalar()
+{
+    checkStatisticsMatchScalar<float>("float");
+    checkStatisticsMatchScalar<double>("double");
+}
+
+// a file rewritten at the same size within a second isn't answered for from the catalog
+static void checkCatalogSeesSubsecondChanges()
+{
+    {
+        UHDF_File file("check_catalog.h5", UHDF_CREATE);
+        createDeflated(file, "data", {10, 10}, {5, 5});
+    }
+
+    UHDF_CatalogBuilder builder;
+    builder.addFile("check_catalog.h5");
+    builder.write("check_catalog.cat");
+    const UHDF_Catalog catalog("check_catalog.cat");
+    check("a cataloged file is current", catalog.isCurrent("check_catalog.h5"));
+
+    // same second, other nanoseconds
+    struct stat fileInfo;
+    stat("check_catalog.h5", &fileInfo);
+    struct timespec times[2] = {fileInfo.st_atim, fileInfo.st_mtim};
+    times[1].tv_nsec = (times[1].tv_nsec == 500000000) ? 1 : 500000000;
+    utimensat(AT_FDCWD, "check_catalog.h5", times, 0);
+    check("a file modified within the same second isn't current", !catalog.isCurrent("check_catalog.h5"));
+}
+
+// attributes can't be added to datasets or groups of a file open read-only, with the same
+// message as the file gives
+static void checkReadOnlyAttributes()
+{
+    {
+        UHDF_File file("check_readonly.h5", UHDF_CREATE);
+        file.createGroup("group");
+        file.createDataset("group/data", UHDF_FLOAT64, {10});
+        const double value = 1;
+        file.openDataset("group/data").createAttribute("scale", &value, 1);
+        file.openGroup("group").createAttribute("title", string("writable"));
+    }
+
+    UHDF_File file("check_readonly.h5");
+    UHDF_Dataset dataset = file.openDataset("group/data");
+    UHDF_Group group = file.openGroup("group");
+    const string expected = "File check_readonly.h5 is open read-only";
+
+    string datasetMessage, groupMessage;
+    try
+    {
+        dataset.createAttribute("title", string("read-only"));
+    }
+    catch (const UHDF_Exception &e)
+    {
+        datasetMessage = e.what();
+    }
+    try
+    {
+        group.createAttribute("subtitle", string("read-only"));
+    }
+    catch (const UHDF_Exception &e)
+    {
+        groupMessage = e.what();
+    }
+    check("attributes of a writable file's datasets and groups are created", dataset.getAttributeNames().size() == 1 && group.getAttributeNames().size() == 1);
+    check("a dataset in a read-only file refuses a new attribute", datasetMessage == expected);
+    check("a group in a read-only file refuses a new attribute", groupMessage == expected);
+}
+
+static void run( void (*checks)())
+{
+    try
+    {
+        checks();
+    }
+    catch (const UHDF_Exception &e)
+    {
+        cout << "FAILED  " << e.what() << endl;
+        failures++;
+    }
+}
+
+int main()
+{
+    run(checkConvertedReadFollowsChunks);
+    run(checkConvertedWriteFollowsChunks);
+    run(checkPartialChunkFlush);
+    run(checkChunkedH4FillValue);
+    run(checkParallelReadDecodesOutsideLibrary);
+    run(checkReduceMatchesScalar);
+    run(checkCatalogSeesSubsecondChanges);
+    run(checkReadOnlyAttributes);
+
+    return failures;
+}
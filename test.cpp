@@ -1,105 +1,75 @@
 #include "UHDF.h"
 #include <iostream>
+#include <algorithm>
 using namespace std;
 
 template <typename T>
 void listAttributes(const T &attOwner, int depth)
 {
-    for (const auto &name : attOwner.getAttributeNames())
+    try
     {
-        for (int i = 0; i < depth; i++)
-            cout << "\t";
+        for (const auto &att : attOwner.readAllAttributes())
+        {
+            for (int i = 0; i < depth; i++)
+                cout << "\t";
 
-        cout << name << ": ";
+            cout << att.first << ": ";
 
-        try
-        {
-            const UHDF_Attribute att = attOwner.openAttribute(name);
-            if (att.isString())
+            if (att.second.isString())
             {
-                cout << "string, '" << att.readAsString() << "'" << endl;
+                cout << "string, '" << att.second.asString() << "'" << endl;
             }
             else
             {
-                cout << UHDFTypeName(att.getType()) << ", " << att.getNumElements() << " elements" << endl;
+                cout << UHDFTypeName(att.second.getType()) << ", " << att.second.getNumElements() << " elements" << endl;
             }
         }
-        catch (UHDF_Exception &e)
-        {
-            cerr << "ERROR OPENING (" << e.what() << ")" << endl;
-        }
     }
-}
-
-void listGroup(const UHDF_Group &g, int depth)
-{
-    for (const auto &name : g.getGroupNames())
+    catch (UHDF_Exception &e)
     {
-        for (int i = 0; i < depth; i++)
-            cout << "\t";
-
-        cout << "GROUP '" << name << "'" << endl;
-
-        try
-        {
-            const UHDF_Group g = g.openGroup(name);
-            listAttributes(g, depth + 1);
-            listGroup (g, depth + 1);
-        }
-        catch (UHDF_Exception &e)
-        {
-            cerr << "ERROR OPENING (" << e.what() << ")";
-        }
-    }
-    for (const auto &name : g.getDatasetNames())
-    {
-        for (int i = 0; i < depth; i++)
-            cout << "\t";
-        cout << "FIELD '" << name << "'" << endl;
-
-        try
-        {
-            const UHDF_Dataset d = g.openDataset(name);
-            listAttributes(d, depth + 1);
-        }
-        catch (UHDF_Exception &e)
-        {
-            cerr << "ERROR OPENING (" << e.what() << ")" << endl;
-        }
+        cerr << "ERROR READING ATTRIBUTES (" << e.what() << ")" << endl;
     }
 }
 
 void listContents(const UHDF_File &f)
 {
     cout << f.getFileName() << ":" << endl;
-    for (const auto &name : f.getGroupNames())
-    {
-        cout << "\tGROUP '" << name << "'" << endl;
+    listAttributes(f, 1);
 
-        try
-        {
-            const UHDF_Group g = f.openGroup(name);
-            listGroup (g, 2);
-        }
-        catch (UHDF_Exception &e)
-        {
-            cerr << "ERROR OPENING (" << e.what() << ")";
-        }
-    }
-    for (const auto &name : f.getDatasetNames())
+    // one traversal of the whole file; objects are only opened to read their attributes
+    f.visit([&f](const UHDF_ObjectInfo &info)
     {
-        cout << "\tFIELD '" << name << "'" << endl;
+        const int depth = 1 + count(info.path.begin(), info.path.end(), '/');
+
+        for (int i = 0; i < depth; i++)
+            cout << "\t";
 
         try
         {
-            const UHDF_Dataset d = f.openDataset(name);
-            listAttributes(d, 2);
+            switch (info.type)
+            {
+            case UHDF_OBJ_GROUP:
+                cout << "GROUP '" << info.name << "'" << endl;
+                if (info.numAttributes > 0)
+                    listAttributes(f.openGroup(info.path), depth + 1);
+                break;
+            case UHDF_OBJ_DATASET:
+                cout << "FIELD '" << info.name << "'" << endl;
+                if (info.numAttributes > 0)
+                    listAttributes(f.openDataset(info.path), depth + 1);
+                break;
+            default:
+                cout << "OTHER '" << info.name << "'" << endl;
+                break;
+            }
         }
         catch (UHDF_Exception &e)
         {
             cerr << "ERROR OPENING (" << e.what() << ")" << endl;
         }
-    }
+
+        return true;
+    });
 }
 
 template <typename T>
@@ -107,18 +77,10 @@ void average(const T &dsOwner, const string &field)
 {
     const UHDF_Dataset d = dsOwner.openDataset(field);
 
-    const auto &dims = d.getDimensions();
-
-    const vector<double> data = d.readAll<double>();
-    double avg = 0;
-
-    for (auto d : data)
-    {
-        avg += d;
-    }
-    avg /= data.size();
+    // streamed a tile at a time in the field's own type, rather than read whole as doubles
+    const UHDF_Statistics stats = d.computeStatistics();
 
-    cout << "Average value = " << avg << endl;
+    cout << "Average value = " << stats.getMean() << endl;
 }
 
 int main (int argc, char *argv[])